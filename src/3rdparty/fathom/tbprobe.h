@@ -229,6 +229,7 @@ namespace Tablebase {
                                            bool     _turn,
                                            unsigned *_results);
         
+    public:
         /*
          * Probe the Win-Draw-Loss (WDL) table.
          *
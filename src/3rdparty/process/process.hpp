@@ -18,13 +18,20 @@ struct Config {
   std::size_t buffer_size = 131072;
   /// Set to true to inherit file descriptors from parent process. Default is false. Only supported on Unix-like systems.
   bool inherit_file_descriptors = false;
+  /// Called once both stdout and stderr reached end of file. Default is nullptr.
+  /// Only supported on systems with the shared reader (epoll or kqueue), called from the reader thread.
+  std::function<void()> on_close = nullptr;
 };
 
+class Reactor;
+
 /// Platform independent class for creating processes.
 /// Note on Windows: it seems not possible to specify which pipes to redirect.
 /// Thus, at the moment, if read_stdout==nullptr, read_stderr==nullptr and open_stdin==false,
 /// the stdout, stderr and stdin are sent to the parent process instead.
 class Process {
+  friend class Reactor;
+
 public:
 #ifdef _WIN32
   typedef unsigned long id_type; // Process id type
@@ -1,4 +1,8 @@
+#if defined(__APPLE__)
+#define _DARWIN_C_SOURCE // kqueue types are hidden by _POSIX_C_SOURCE
+#endif
 #include "process.hpp"
+#include <algorithm>
 #include <bitset>
 #include <cstdlib>
 #include <fcntl.h>
@@ -8,8 +12,157 @@
 #include <stdexcept>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define TINY_PROCESS_REACTOR
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#include <sys/event.h>
+#include <sys/types.h>
+#define TINY_PROCESS_REACTOR
+#endif
+
 namespace TinyProcessLib {
 
+#ifdef TINY_PROCESS_REACTOR
+/// One thread multiplexing stdout and stderr of all processes (epoll on Linux, kqueue on BSD/macOS),
+/// so the number of threads does not grow with the number of processes.
+/// Callbacks are called from that thread, with the reactor mutex locked.
+class Reactor {
+public:
+  static Reactor &get() {
+    // never destroyed: the thread keeps running until the application exits
+    static Reactor *reactor = new Reactor();
+    return *reactor;
+  }
+
+  /// Starts watching the pipes of a process, -1 for a pipe that is not used.
+  void add(Process *process, int stdout_fd, int stderr_fd) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    for(auto fd : {stdout_fd, stderr_fd}) {
+      if(fd < 0)
+        continue;
+      entries[fd] = Entry{process, fd == stdout_fd};
+      open_counts[process]++;
+      watch(fd);
+    }
+  }
+
+  /// Stops watching a pipe. Returns true if it was the last watched pipe of its process.
+  bool remove(int fd) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    auto it = entries.find(fd);
+    if(it == entries.end())
+      return false;
+    auto process = it->second.process;
+    unwatch(fd);
+    entries.erase(it);
+    if(--open_counts[process] > 0)
+      return false;
+    open_counts.erase(process);
+    return true;
+  }
+
+private:
+  struct Entry {
+    Process *process;
+    bool is_stdout;
+  };
+
+  Reactor() {
+#if defined(__linux__)
+    queue_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    queue_fd = kqueue();
+#endif
+    thread = std::thread([this] { run(); });
+    thread.detach();
+  }
+
+  void watch(int fd) {
+#if defined(__linux__)
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(queue_fd, EPOLL_CTL_ADD, fd, &event);
+#else
+    struct kevent event;
+    EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    kevent(queue_fd, &event, 1, nullptr, 0, nullptr);
+#endif
+  }
+
+  void unwatch(int fd) {
+#if defined(__linux__)
+    epoll_event event{};
+    epoll_ctl(queue_fd, EPOLL_CTL_DEL, fd, &event);
+#else
+    struct kevent event;
+    EV_SET(&event, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    kevent(queue_fd, &event, 1, nullptr, 0, nullptr);
+#endif
+  }
+
+  void run() {
+    const int max_events = 64;
+    const std::size_t buffer_size = 131072;
+    auto buffer = std::unique_ptr<char[]>(new char[buffer_size]);
+#if defined(__linux__)
+    epoll_event events[max_events];
+#else
+    struct kevent events[max_events];
+#endif
+
+    while(true) {
+#if defined(__linux__)
+      const int n = epoll_wait(queue_fd, events, max_events, -1);
+#else
+      const int n = kevent(queue_fd, nullptr, 0, events, max_events, nullptr);
+#endif
+      if(n < 0) {
+        if(errno == EINTR)
+          continue;
+        return;
+      }
+
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      for(int i = 0; i < n; ++i) {
+#if defined(__linux__)
+        const int fd = events[i].data.fd;
+#else
+        const int fd = static_cast<int>(events[i].ident);
+#endif
+        // the pipe may have been removed by a previous callback
+        auto it = entries.find(fd);
+        if(it == entries.end())
+          continue;
+        auto entry = it->second;
+
+        const ssize_t r = read(fd, buffer.get(), std::min(buffer_size, entry.process->config.buffer_size));
+        if(r > 0) {
+          if(entry.is_stdout)
+            entry.process->read_stdout(buffer.get(), static_cast<size_t>(r));
+          else
+            entry.process->read_stderr(buffer.get(), static_cast<size_t>(r));
+          continue;
+        }
+        if(r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+          continue;
+
+        // end of file or error
+        if(remove(fd) && entry.process->config.on_close)
+          entry.process->config.on_close();
+      }
+    }
+  }
+
+  int queue_fd;
+  std::thread thread;
+  std::recursive_mutex mutex;
+  std::unordered_map<int, Entry> entries;
+  std::unordered_map<Process *, int> open_counts;
+};
+#endif
+
 Process::Data::Data() noexcept : id(-1) {}
 
 Process::Process(const std::function<void()> &function,
@@ -188,6 +341,14 @@ void Process::async_read() noexcept {
   if(data.id <= 0 || (!stdout_fd && !stderr_fd))
     return;
 
+#ifdef TINY_PROCESS_REACTOR
+  int fds[2] = {-1, -1};
+  if(stdout_fd && fcntl(*stdout_fd, F_SETFL, fcntl(*stdout_fd, F_GETFL) | O_NONBLOCK) == 0)
+    fds[0] = *stdout_fd;
+  if(stderr_fd && fcntl(*stderr_fd, F_SETFL, fcntl(*stderr_fd, F_GETFL) | O_NONBLOCK) == 0)
+    fds[1] = *stderr_fd;
+  Reactor::get().add(this, fds[0], fds[1]);
+#else
   stdout_stderr_thread = std::thread([this] {
     std::vector<pollfd> pollfds;
     std::bitset<2> fd_is_stdout;
@@ -230,6 +391,7 @@ void Process::async_read() noexcept {
       }
     }
   });
+#endif
 }
 
 int Process::get_exit_status() noexcept {
@@ -295,8 +457,16 @@ bool Process::try_get_exit_status(int &exit_status) noexcept {
 }
 
 void Process::close_fds() noexcept {
+#ifdef TINY_PROCESS_REACTOR
+  // after removing, no callback for these pipes is running or will run
+  if(stdout_fd && data.id > 0)
+    Reactor::get().remove(*stdout_fd);
+  if(stderr_fd && data.id > 0)
+    Reactor::get().remove(*stderr_fd);
+#else
   if(stdout_stderr_thread.joinable())
     stdout_stderr_thread.join();
+#endif
 
   if(stdin_fd)
     close_stdin();
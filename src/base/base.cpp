@@ -22,6 +22,8 @@
  SOFTWARE.
  */
 
+#include <unordered_set>
+
 #include "base.h"
 
 using namespace banksia;
@@ -29,9 +31,6 @@ using namespace banksia;
 Move Move::illegalMove(-1, -1);
 MoveFull MoveFull::illegalMove(-1, -1);
 
-u64 BoardCore::hashForSide;
-std::vector<u64> BoardCore::hashTable;
-
 BoardCore::BoardCore() {
 }
 
@@ -45,13 +44,13 @@ std::string BoardCore::getStartingFen() const
     return startFen;
 }
 
-MoveFull BoardCore::createFullMove(int from, int dest, PieceType promotion) const
+const char* MoveNote::intern(const std::string& str)
 {
-    MoveFull move(from, dest, promotion);
-    if (isPositionValid(from)) {
-        move.piece = getPiece(from);
-    }
-    return move;
+    static std::mutex internMutex;
+    static std::unordered_set<std::string> internSet;
+    
+    std::lock_guard<std::mutex> dolock(internMutex);
+    return internSet.insert(str).first->c_str();
 }
 
 PieceType BoardCore::charactorToPieceType(char ch)
@@ -96,34 +95,6 @@ void BoardCore::newGame(std::string fen)
     setFen(fen);
 }
 
-u64 BoardCore::initHashKey() const
-{
-    u64 key = 0;
-    for(size_t i = 0; i < pieces.size(); i++) {
-        if (!pieces[i].isEmpty()) {
-            key ^= xorHashKey(int(i));
-        }
-    }
-    
-    if (side == Side::black) {
-        key ^= hashForSide;
-    }
-    return key;
-}
-
-u64 BoardCore::xorHashKey(int pos) const
-{
-    assert(isPositionValid(pos ));
-    
-    assert(!pieces[size_t(pos)].isEmpty());
-    int sd = static_cast<int>(pieces[size_t(pos)].side);
-    int p = static_cast<int>(pieces[size_t(pos)].type);
-    
-    auto sz = pieces.size(); assert(sz == 64);
-    auto h = sd * 7 * sz + p * sz + size_t(pos); assert(h < hashTable.size());
-    return hashTable[h];
-}
-
 bool BoardCore::istHashKeyValid() const
 {
     return hashKey == initHashKey();
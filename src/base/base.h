@@ -128,7 +128,7 @@ namespace banksia {
     public:
         Move() {}
         Move(int from, int dest, PieceType promotion = PieceType::empty)
-        : from(from), dest(dest), promotion(promotion)
+        : from(i8(from)), dest(i8(dest)), promotion(promotion)
         {}
         
         static Move illegalMove;
@@ -157,35 +157,44 @@ namespace banksia {
         }
         
     public:
-        int from, dest;
+        i8 from, dest;
         PieceType promotion;
     };
     
+    // A move with its moving piece, packed into 32 bits to keep move lists and histories small
     class MoveFull : public Move {
     public:
-        Piece piece;
         static MoveFull illegalMove;
         
     public:
         MoveFull() {}
         MoveFull(Piece piece, int from, int dest, PieceType promotion = PieceType::empty)
-        : Move(from, dest, promotion), piece(piece)
-        {}
+        : Move(from, dest, promotion)
+        {
+            setPiece(piece);
+        }
         MoveFull(int from, int dest, PieceType promotion = PieceType::empty)
         : Move(from, dest, promotion)
-        {}
+        {
+            setPiece(Piece(PieceType::empty, Side::none));
+        }
+        
+        Piece piece() const {
+            return Piece(static_cast<PieceType>(movingPiece & 7), static_cast<Side>(movingPiece >> 3));
+        }
         
+        void setPiece(Piece piece) {
+            movingPiece = u8(static_cast<int>(piece.type) | static_cast<int>(piece.side) << 3);
+        }
         
         void set(Piece _piece, int _from, int _dest, PieceType _promote = PieceType::empty) {
-            piece = _piece;
-            from = _from;
-            dest = _dest;
-            promotion = _promote;
+            setPiece(_piece);
+            set(_from, _dest, _promote);
         }
         
         void set(int _from, int _dest, PieceType _promote) {
-            from = _from;
-            dest = _dest;
+            from = i8(_from);
+            dest = i8(_dest);
             promotion = _promote;
         }
         
@@ -195,22 +204,102 @@ namespace banksia {
         bool operator == (const Move& other) const {
             return from == other.from && dest == other.dest && promotion == other.promotion;
         }
+        
+    private:
+        u8 movingPiece;
     };
     
-    class Hist {
+    static_assert(sizeof(MoveFull) == 4, "MoveFull should be packed into 32 bits");
+    
+    // A fixed capacity list on the stack, move generators fill it without touching the heap
+    template <int Capacity>
+    class MoveList {
     public:
-        MoveFull move;
-        Piece cap; 
-        int enpassant, status;
-        int8_t castleRights[2];
-        u64 hashKey;
-        int quietCnt;
-        std::string moveString, comment;
-
+        MoveList() : count(0) {}
+        
+        void push_back(const MoveFull& move) {
+            assert(count < Capacity);
+            moves[count++] = move;
+        }
+        
+        void clear() { count = 0; }
+        bool empty() const { return count == 0; }
+        size_t size() const { return size_t(count); }
+        
+        MoveFull& operator [] (size_t i) { return moves[i]; }
+        const MoveFull& operator [] (size_t i) const { return moves[i]; }
+        
+        MoveFull* begin() { return moves; }
+        MoveFull* end() { return moves + count; }
+        const MoveFull* begin() const { return moves; }
+        const MoveFull* end() const { return moves + count; }
+        
+    private:
+        MoveFull moves[Capacity];
+        int count;
+    };
+    
+    // The search information of an engine, the last one is kept for each move.
+    // Fixed size, the PV is stored as packed moves
+    class InfoRecord {
+    public:
+        static const int maxPvLength = 24;
+        static const int mateScore = 30000;
+        
+        i64 nodes = 0, nps = 0, tbhits = 0;
+        int depth = 0, seldepth = 0, multipv = 0, hashfull = 0, time = 0; // time in ms
+        int score = 0, mate = 0; // mate in moves, zero when the score is in centipawns
+        int pvLength = 0;
+        u16 pv[maxPvLength] = {};
+        
+        void reset() {
+            nodes = nps = tbhits = 0;
+            depth = seldepth = multipv = hashfull = time = 0;
+            score = mate = pvLength = 0;
+        }
+        
+        static u16 packMove(int from, int dest, PieceType promotion) {
+            return static_cast<u16>(from | dest << 6 | static_cast<int>(promotion) << 12);
+        }
+        
+        static Move unpackMove(u16 m) {
+            return Move(m & 0x3f, m >> 6 & 0x3f, static_cast<PieceType>(m >> 12));
+        }
+        
+        std::string pvString() const {
+            std::string str;
+            for(int i = 0; i < pvLength; i++) {
+                if (i) str += " ";
+                str += unpackMove(pv[i]).toCoordinateString();
+            }
+            return str;
+        }
+    };
+    
+    // Annotations of a move, kept apart from Hist since only played moves have them
+    class MoveNote {
+    public:
+        const char* san = ""; // interned, see intern
+        std::string comment;
+        
         // for statistic
-        i64 nodes = 0;
-        int score = 0, depth = 0;
+        InfoRecord info;
         double elapsed = 0;
+        double overhead = 0; // the manager's part of the move time, not in elapsed
+        
+        // SAN strings repeat a lot between games, store each of them once
+        static const char* intern(const std::string& str);
+    };
+    
+    // The undo record of a move, plain data for make/takeBack
+    class Hist {
+    public:
+        u64 hashKey;
+        MoveFull move;
+        int status, quietCnt;
+        Piece cap;
+        i8 enpassant;
+        i8 castleRights[2];
         
         void set(const MoveFull& _move) {
             move = _move;
@@ -221,13 +310,13 @@ namespace banksia {
         }
     };
     
+    // The interface of boards, an adapter for variants. Square accesses are virtual here, a final
+    // board type (ChessBoard) implements them inline thus its own calls are direct
     class BoardCore : public Obj {
-    protected:
-        std::vector<Piece> pieces;
-        
     public:
         Side side;
         std::vector<Hist> histList;
+        std::vector<MoveNote> noteList; // for histList, may be shorter since it grows on demand
         
         int status;
         Result result;
@@ -235,48 +324,34 @@ namespace banksia {
     public:
         virtual ~BoardCore() {}
 
-        void reset() {
-            for (auto && p : pieces) {
-                p.setEmpty();
-            }
-        }
+        virtual void reset() = 0;
+        virtual int size() const = 0;
         
         virtual bool isPositionValid(int pos) const {
-            return pos >= 0 && pos < int(pieces.size());
+            return pos >= 0 && pos < size();
         }
         
         virtual int columnCount() const = 0;
         virtual int getColumn(int pos) const = 0;
         virtual int getRow(int pos) const = 0;
         
-        int size() const {
-            return int(pieces.size());
-        }
-
-        void setPiece(int pos, Piece piece) {
-            assert(isPositionValid(pos));
-            pieces[size_t(pos)] = piece;
-        }
-        
-        Piece getPiece(int pos) const {
-            assert(isPositionValid(pos));
-            return pieces.at(size_t(pos));
-        }
+        virtual void setPiece(int pos, Piece piece) = 0;
+        virtual Piece getPiece(int pos) const = 0;
+        virtual bool isEmpty(int pos) const = 0;
+        virtual bool isPiece(int pos, PieceType type, Side side) const = 0;
+        virtual void setEmpty(int pos) = 0;
         
-        bool isEmpty(int pos) const {
-            assert(isPositionValid(pos));
-            return pieces[size_t(pos)].type == PieceType::empty;
-        }
-        
-        bool isPiece(int pos, PieceType type, Side side) const {
-            assert(isPositionValid(pos));
-            auto p = pieces[size_t(pos)];
-            return p.type == type && p.side == side;
+        // the annotation of the move at ply, created if needed
+        MoveNote& getNote(size_t ply) {
+            if (ply >= noteList.size()) {
+                noteList.resize(ply + 1);
+            }
+            return noteList[ply];
         }
         
-        void setEmpty(int pos) {
-            assert(isPositionValid(pos));
-            pieces[size_t(pos)].setEmpty();
+        const MoveNote& findNote(size_t ply) const {
+            static const MoveNote emptyNote;
+            return ply < noteList.size() ? noteList[ply] : emptyNote;
         }
         
         static Side getXSide(Side side) {
@@ -290,10 +365,10 @@ namespace banksia {
         virtual std::string getFen(int halfCount = 0, int fullMoveCount = 1) const = 0;
         
         
-        virtual u64 key() const {
+        u64 key() const {
             return hashKey;
         }
-        virtual u64 initHashKey() const;
+        virtual u64 initHashKey() const = 0;
         
     public:
         bool fromOriginPosition() const;
@@ -301,7 +376,6 @@ namespace banksia {
         
         void newGame(std::string fen = "");
         
-        MoveFull createFullMove(int from, int dest, PieceType promote) const;
         static PieceType charactorToPieceType(char ch);
         static Move moveFromCoordiateString(const std::string& moveString);
         
@@ -310,15 +384,12 @@ namespace banksia {
         virtual Result rule() = 0;
         
     protected:
-        virtual bool istHashKeyValid() const;
-        virtual u64 xorHashKey(int pos) const;
+        bool istHashKeyValid() const;
+        virtual u64 xorHashKey(int pos) const = 0;
         
         int quietCnt;
         u64 hashKey;
         
-        static u64 hashForSide;
-        static std::vector<u64> hashTable;
-        
         std::string startFen;
     };
     
@@ -56,6 +56,10 @@
 #include <sys/sysctl.h>
 #endif
 
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
 #endif
 
 
@@ -66,6 +70,7 @@ namespace banksia {
     const char* BANKSIA_VERSION = "3.1.5";
     bool banksiaVerbose = true;
     bool profileMode = false;
+    int profileInterval = 500; // ms
 
     extern const char* pieceTypeName;
     extern const char* reasonStrings[12];
@@ -378,6 +383,14 @@ namespace banksia {
         return fileStat.st_size;
     }
     
+    i64 getFileTime(const std::string& path)
+    {
+        struct __stat64 fileStat;
+        int err = _stat64(path.c_str(), &fileStat );
+        if (0 != err) return 0;
+        return fileStat.st_mtime;
+    }
+    
     bool isExecutable(const std::string& path)
     {
         return path.find(".exe") != std::string::npos || path.find(".bat") != std::string::npos;
@@ -451,6 +464,15 @@ namespace banksia {
         }
         return st.st_size;
     }
+    
+    i64 getFileTime(const std::string& fileName)
+    {
+        struct stat st;
+        if(stat(fileName.c_str(), &st) != 0) {
+            return 0;
+        }
+        return st.st_mtime;
+    }
 
     bool isExecutable(const std::string& path)
     {
@@ -471,19 +493,19 @@ namespace banksia {
 		GetSystemInfo(&sysinfo);
 		return sysinfo.dwNumberOfProcessors;
 #elif MACOS
-        int nm[2];
-        size_t len = 4;
-        uint32_t count;
-     
-        nm[0] = CTL_HW; nm[1] = HW_AVAILCPU;
-        sysctl(nm, 2, &count, &len, NULL, 0);
-     
-        if(count < 1) {
-            nm[1] = HW_NCPU;
-            sysctl(nm, 2, &count, &len, NULL, 0);
-            if(count < 1) { count = 1; }
-            }
-        return count;
+        int nm[2];
+        size_t len = 4;
+        uint32_t count;
+     
+        nm[0] = CTL_HW; nm[1] = HW_AVAILCPU;
+        sysctl(nm, 2, &count, &len, NULL, 0);
+     
+        if(count < 1) {
+            nm[1] = HW_NCPU;
+            sysctl(nm, 2, &count, &len, NULL, 0);
+            if(count < 1) { count = 1; }
+            }
+        return count;
 #else
         return int(sysconf(_SC_NPROCESSORS_ONLN));
 #endif
@@ -562,6 +584,48 @@ namespace banksia {
         
 #else
         return 0L;            /* Unknown OS. */
+#endif
+    }
+    
+    bool getSystemCpuTimes(u64& busyTime, u64& totalTime)
+    {
+#ifdef _WIN32
+        FILETIME ftIdle, ftKernel, ftUser;
+        if (!GetSystemTimes(&ftIdle, &ftKernel, &ftUser)) {
+            return false;
+        }
+        auto toU64 = [](const FILETIME& ft) { return (u64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+        // kernel time includes idle time
+        totalTime = toU64(ftKernel) + toU64(ftUser);
+        busyTime = totalTime - toU64(ftIdle);
+        return true;
+        
+#elif defined(__APPLE__)
+        host_cpu_load_info_data_t info;
+        mach_msg_type_number_t cnt = HOST_CPU_LOAD_INFO_COUNT;
+        if (host_statistics(mach_host_self(), HOST_CPU_LOAD_INFO, (host_info_t)&info, &cnt) != KERN_SUCCESS) {
+            return false;
+        }
+        busyTime = u64(info.cpu_ticks[CPU_STATE_USER]) + info.cpu_ticks[CPU_STATE_SYSTEM] + info.cpu_ticks[CPU_STATE_NICE];
+        totalTime = busyTime + info.cpu_ticks[CPU_STATE_IDLE];
+        return true;
+        
+#else
+        // the first line sums all cores: user, nice, system, idle, iowait, irq, softirq, steal
+        std::ifstream ifs("/proc/stat");
+        std::string name;
+        if (!(ifs >> name) || name != "cpu") {
+            return false;
+        }
+        busyTime = totalTime = 0;
+        u64 t;
+        for (int i = 0; i < 8 && ifs >> t; i++) {
+            totalTime += t;
+            if (i != 3 && i != 4) {
+                busyTime += t;
+            }
+        }
+        return totalTime > 0;
 #endif
     }
 }
@@ -49,6 +49,7 @@ namespace banksia {
 #endif
 
 
+#define i8  int8_t
 #define i16 int16_t
 #define u16 uint16_t
 #define i32 int32_t
@@ -118,11 +119,11 @@ namespace banksia {
     const int B = 0;
     const int W = 1;
     
-    enum class Side {
+    enum class Side : u8 {
         black = 0, white = 1, none = 2
     };
     
-    enum class PieceType {
+    enum class PieceType : u8 {
         empty, king, queen, rook, bishop, knight, pawn
     };
     
@@ -163,6 +164,7 @@ namespace banksia {
     // Some useful / library functions
     extern bool banksiaVerbose;
     extern bool profileMode;
+    extern int profileInterval;
     extern const char* pieceTypeName;
     extern const char* reasonStrings[12];
     
@@ -189,10 +191,13 @@ namespace banksia {
     std::string getFullPath(const char* path);
     std::vector<std::string> listdir(std::string dirname);
     i64 getFileSize(const std::string& path);
+    i64 getFileTime(const std::string& path); // last modification, in seconds
     bool isExecutable(const std::string& path);
     bool isRunning(int pid);
     int getNumberOfCores();
     size_t getMemorySize();
+    // busy (not idle) and total times of all cores since the boot, in the system's own units
+    bool getSystemCpuTimes(u64& busyTime, u64& totalTime);
     
     std::vector<std::string> splitString(const std::string& string, const std::string& regexString);
     std::vector<std::string> splitString(const std::string &s, char delim);
@@ -0,0 +1,328 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <map>
+#include <set>
+#include <fstream>
+#include <climits>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <dirent.h>
+#include <stdlib.h>
+#endif
+
+#include "coreallocator.h"
+
+using namespace banksia;
+
+#ifdef __linux__
+
+static int readIntFile(const std::string& path, int defaultValue)
+{
+    std::ifstream ifs(path);
+    int value;
+    return ifs >> value ? value : defaultValue;
+}
+
+// CPU lists of sysfs, such as "0-15,32-47"
+static std::vector<int> parseCpuList(const std::string& str)
+{
+    std::vector<int> vec;
+    for(auto && item : splitString(str, ',')) {
+        auto k = item.find('-');
+        auto from = std::atoi(item.c_str());
+        auto to = k == std::string::npos ? from : std::atoi(item.c_str() + k + 1);
+        for(auto i = from; i <= to; i++) {
+            vec.push_back(i);
+        }
+    }
+    return vec;
+}
+
+bool CoreAllocator::init()
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    cpuList.clear();
+    
+    // CPUs this app may use, a container or taskset may limit them
+    cpu_set_t allowedSet;
+    CPU_ZERO(&allowedSet);
+    if (sched_getaffinity(0, sizeof(allowedSet), &allowedSet) != 0) {
+        return false;
+    }
+    
+    std::map<int, int> nodeMap; // cpu -> node number
+    if (auto dir = opendir("/sys/devices/system/node")) {
+        while (auto entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() < 5 || !isdigit(name[4])) {
+                continue;
+            }
+            std::ifstream ifs("/sys/devices/system/node/" + name + "/cpulist");
+            std::string line;
+            if (std::getline(ifs, line)) {
+                auto node = std::atoi(name.c_str() + 4);
+                for(auto cpu : parseCpuList(line)) {
+                    nodeMap[cpu] = node;
+                }
+            }
+        }
+        closedir(dir);
+    }
+    
+    std::map<std::pair<int, int>, int> coreMap; // (package, core id) -> core index
+    std::map<int, int> nodeIdxMap;
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowedSet)) {
+            continue;
+        }
+        auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        auto package = readIntFile(path + "physical_package_id", 0);
+        auto coreId = readIntFile(path + "core_id", cpu);
+        
+        Cpu c;
+        c.id = cpu;
+        c.core = coreMap.emplace(std::make_pair(package, coreId), int(coreMap.size())).first->second;
+        auto it = nodeMap.find(cpu);
+        c.node = nodeIdxMap.emplace(it != nodeMap.end() ? it->second : 0, int(nodeIdxMap.size())).first->second;
+        cpuList.push_back(c);
+    }
+    
+    coreCnt = int(coreMap.size());
+    nodeCnt = int(nodeIdxMap.size());
+    return !cpuList.empty();
+}
+
+bool CoreAllocator::apply(i64 processId, const std::vector<int>& cpus)
+{
+    if (processId <= 0 || cpus.empty()) {
+        return false;
+    }
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    
+    // threads started by the engine before this call don't inherit it, set them all
+    auto ok = false;
+    auto path = "/proc/" + std::to_string(processId) + "/task";
+    if (auto dir = opendir(path.c_str())) {
+        while (auto entry = readdir(dir)) {
+            auto tid = std::atoi(entry->d_name);
+            if (tid > 0 && sched_setaffinity(tid, sizeof(set), &set) == 0) {
+                ok = true;
+            }
+        }
+        closedir(dir);
+    }
+    return ok || sched_setaffinity(pid_t(processId), sizeof(set), &set) == 0;
+}
+
+#elif defined(_WIN32)
+
+// the first processor group only (up to 64 logical CPUs)
+bool CoreAllocator::init()
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    cpuList.clear();
+    
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        return false;
+    }
+    
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infoVec(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+    if (!length || !GetLogicalProcessorInformation(infoVec.data(), &length)) {
+        return false;
+    }
+    infoVec.resize(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    
+    int cpuNode[64] = {}, cpuCore[64];
+    for(int i = 0; i < 64; i++) cpuCore[i] = -1;
+    
+    std::map<int, int> nodeIdxMap;
+    coreCnt = 0;
+    for(auto && info : infoVec) {
+        if (info.Relationship == RelationProcessorCore) {
+            for(int i = 0; i < 64; i++) {
+                if (info.ProcessorMask & (DWORD_PTR(1) << i)) cpuCore[i] = coreCnt;
+            }
+            coreCnt++;
+        } else if (info.Relationship == RelationNumaNode) {
+            auto node = nodeIdxMap.emplace(int(info.NumaNode.NodeNumber), int(nodeIdxMap.size())).first->second;
+            for(int i = 0; i < 64; i++) {
+                if (info.ProcessorMask & (DWORD_PTR(1) << i)) cpuNode[i] = node;
+            }
+        }
+    }
+    
+    for(int i = 0; i < 64 && i < int(sizeof(DWORD_PTR) * 8); i++) {
+        if ((processMask & (DWORD_PTR(1) << i)) && cpuCore[i] >= 0) {
+            Cpu c;
+            c.id = i;
+            c.core = cpuCore[i];
+            c.node = cpuNode[i];
+            cpuList.push_back(c);
+        }
+    }
+    nodeCnt = std::max(1, int(nodeIdxMap.size()));
+    return !cpuList.empty();
+}
+
+bool CoreAllocator::apply(i64 processId, const std::vector<int>& cpus)
+{
+    if (processId <= 0 || cpus.empty()) {
+        return false;
+    }
+    
+    DWORD_PTR mask = 0;
+    for(auto cpu : cpus) {
+        mask |= DWORD_PTR(1) << cpu;
+    }
+    
+    auto handle = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION, FALSE, DWORD(processId));
+    if (!handle) {
+        return false;
+    }
+    auto ok = SetProcessAffinityMask(handle, mask) != 0;
+    CloseHandle(handle);
+    return ok;
+}
+
+#else
+
+// no way to pin processes (macOS)
+bool CoreAllocator::init()
+{
+    return false;
+}
+
+bool CoreAllocator::apply(i64, const std::vector<int>&)
+{
+    return false;
+}
+
+#endif
+
+bool CoreAllocator::isCoreFree(int core) const
+{
+    for(auto && c : cpuList) {
+        if (c.core == core && c.used) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// takes up to cpuCnt free CPUs of a node (any if node < 0), marks them used
+int CoreAllocator::pick(std::vector<int>& result, int cpuCnt, int node, bool wholeCoresOnly)
+{
+    auto cnt = 0;
+    for(auto && c : cpuList) {
+        if (cnt >= cpuCnt) {
+            break;
+        }
+        if (c.used || (node >= 0 && c.node != node) || (wholeCoresOnly && !isCoreFree(c.core))) {
+            continue;
+        }
+        c.used = true;
+        result.push_back(c.id);
+        cnt++;
+    }
+    return cnt;
+}
+
+std::vector<int> CoreAllocator::allocate(int cpuCnt)
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    
+    std::vector<int> result;
+    if (cpuCnt <= 0 || cpuList.empty()) {
+        return result;
+    }
+    
+    // free cores and free CPUs of each node
+    std::vector<int> freeCores(size_t(nodeCnt), 0), freeCpus(size_t(nodeCnt), 0);
+    std::set<int> countedCores;
+    auto totalFree = 0;
+    for(auto && c : cpuList) {
+        if (c.used) {
+            continue;
+        }
+        totalFree++;
+        freeCpus[size_t(c.node)]++;
+        if (isCoreFree(c.core) && countedCores.insert(c.core).second) {
+            freeCores[size_t(c.node)]++;
+        }
+    }
+    
+    if (totalFree < cpuCnt) {
+        return result;
+    }
+    
+    // the tightest node which fits, whole cores first then SMT siblings
+    for(int pass = 0; pass < 2; pass++) {
+        auto& freeVec = pass == 0 ? freeCores : freeCpus;
+        auto bestNode = -1, bestFree = INT_MAX;
+        for(int node = 0; node < nodeCnt; node++) {
+            if (freeVec[size_t(node)] >= cpuCnt && freeVec[size_t(node)] < bestFree) {
+                bestNode = node;
+                bestFree = freeVec[size_t(node)];
+            }
+        }
+        if (bestNode >= 0) {
+            auto cnt = pick(result, cpuCnt, bestNode, true);
+            pick(result, cpuCnt - cnt, bestNode, false);
+            return result;
+        }
+    }
+    
+    // too big for any node
+    auto cnt = pick(result, cpuCnt, -1, true);
+    pick(result, cpuCnt - cnt, -1, false);
+    return result;
+}
+
+void CoreAllocator::release(const std::vector<int>& cpus)
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    for(auto && c : cpuList) {
+        if (std::find(cpus.begin(), cpus.end(), c.id) != cpus.end()) {
+            c.used = false;
+        }
+    }
+}
+
+std::string CoreAllocator::toString() const
+{
+    return std::to_string(cpuList.size()) + " logical CPUs, " + std::to_string(coreCnt) + " cores, "
+    + std::to_string(nodeCnt) + " NUMA nodes";
+}
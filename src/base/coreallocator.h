@@ -0,0 +1,69 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef coreallocator_h
+#define coreallocator_h
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // Hands out disjoint sets of logical CPUs to engine processes so they neither
+    // share cores nor move between sockets. A set is taken from one NUMA node when
+    // possible and uses one logical CPU per physical core while there are free cores
+    class CoreAllocator
+    {
+    public:
+        // reads the topology, false if it is unknown or pinning is unsupported
+        bool init();
+        bool isReady() const { return !cpuList.empty(); }
+        
+        // empty if there are not enough free CPUs
+        std::vector<int> allocate(int cpuCnt);
+        void release(const std::vector<int>& cpus);
+        
+        // pins all threads of a running process
+        static bool apply(i64 processId, const std::vector<int>& cpus);
+        
+        std::string toString() const;
+        
+    private:
+        class Cpu
+        {
+        public:
+            int id, core, node;
+            bool used = false;
+        };
+        
+        bool isCoreFree(int core) const;
+        int pick(std::vector<int>& result, int cpuCnt, int node, bool wholeCoresOnly);
+        
+        std::mutex mutex;
+        std::vector<Cpu> cpuList;
+        int coreCnt = 0, nodeCnt = 0;
+    };
+    
+} // namespace banksia
+
+#endif /* coreallocator_h */
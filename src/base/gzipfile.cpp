@@ -0,0 +1,126 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#ifdef BANKSIA_ZLIB
+#include <zlib.h>
+#endif
+
+#include "gzipfile.h"
+
+using namespace banksia;
+
+GzipFile::~GzipFile()
+{
+    close();
+}
+
+bool GzipFile::isSupported()
+{
+#ifdef BANKSIA_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool GzipFile::isGzipPath(const std::string& path)
+{
+    return path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+}
+
+bool GzipFile::open(const std::string& path, size_t _frameSize)
+{
+    close();
+    if (!isSupported()) {
+        return false;
+    }
+    
+    frameSize = std::max<size_t>(1024, _frameSize);
+    buffer.reserve(frameSize + 4 * 1024);
+    file = fopen(path.c_str(), "ab");
+    return file != nullptr;
+}
+
+void GzipFile::close()
+{
+    if (file) {
+        writeFrame();
+        fclose(file);
+        file = nullptr;
+    }
+    buffer.clear();
+}
+
+bool GzipFile::write(const char* data, size_t len)
+{
+    if (!file) {
+        return false;
+    }
+    
+    buffer.append(data, len);
+    return buffer.size() < frameSize || writeFrame();
+}
+
+bool GzipFile::writeFrame()
+{
+    if (buffer.empty()) {
+        return true;
+    }
+    
+#ifdef BANKSIA_ZLIB
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    
+    // 15 + 16: the largest window with a gzip header and trailer
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    
+    std::vector<unsigned char> out(deflateBound(&stream, uLong(buffer.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(&buffer[0]);
+    stream.avail_in = uInt(buffer.size());
+    stream.next_out = out.data();
+    stream.avail_out = uInt(out.size());
+    
+    auto r = deflate(&stream, Z_FINISH);
+    auto sz = out.size() - stream.avail_out;
+    deflateEnd(&stream);
+    buffer.clear();
+    
+    if (r != Z_STREAM_END) {
+        return false;
+    }
+    
+    // the frame goes to the system at once, as a whole
+    return fwrite(out.data(), 1, sz, file) == sz && fflush(file) == 0;
+#else
+    buffer.clear();
+    return false;
+#endif
+}
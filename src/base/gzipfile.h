@@ -0,0 +1,65 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef gzipfile_h
+#define gzipfile_h
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // An append-only gzip file written in frames: the text is kept in memory until a frame is
+    // full, then compressed and appended as one complete gzip member. Members are concatenated
+    // thus gunzip/zcat read the file as a whole, and a crash loses at most the last frame.
+    // Needs zlib (BANKSIA_ZLIB), otherwise it can't be opened
+    class GzipFile
+    {
+    public:
+        GzipFile() {}
+        ~GzipFile();
+        
+        static bool isSupported();
+        static bool isGzipPath(const std::string& path);
+        
+        bool open(const std::string& path, size_t frameSize);
+        // writes the last frame, even if not full
+        void close();
+        bool isOpen() const { return file != nullptr; }
+        
+        bool write(const char* data, size_t len);
+        
+    private:
+        GzipFile(const GzipFile&) = delete;
+        GzipFile& operator = (const GzipFile&) = delete;
+        
+        bool writeFrame();
+        
+        FILE* file = nullptr;
+        size_t frameSize = 0;
+        std::string buffer;
+    };
+    
+} // namespace banksia
+
+#endif /* gzipfile_h */
@@ -0,0 +1,96 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "journalfile.h"
+
+using namespace banksia;
+
+JournalFile::~JournalFile()
+{
+    close();
+}
+
+bool JournalFile::open(const std::string& path)
+{
+    close();
+    file = fopen(path.c_str(), "a");
+    if (!file) {
+        std::cerr << "Error: can't open journal file " << path << std::endl;
+        return false;
+    }
+    entryCnt = 0;
+    unsyncedCnt = 0;
+    syncTime = std::chrono::steady_clock::now();
+    return true;
+}
+
+void JournalFile::close()
+{
+    if (file) {
+        sync();
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool JournalFile::append(const std::string& line)
+{
+    if (!file
+        || fwrite(line.c_str(), 1, line.size(), file) != line.size()
+        || fputc('\n', file) == EOF
+        || fflush(file) != 0) {
+        return false;
+    }
+    
+    entryCnt++;
+    unsyncedCnt++;
+    if (unsyncedCnt >= sync_entries
+        || std::chrono::steady_clock::now() - syncTime >= std::chrono::seconds(sync_seconds)) {
+        sync();
+    }
+    return true;
+}
+
+void JournalFile::sync()
+{
+    if (!file || !unsyncedCnt) {
+        return;
+    }
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+    unsyncedCnt = 0;
+    syncTime = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,67 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef journalfile_h
+#define journalfile_h
+
+#include <chrono>
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // An append-only text file, one entry per line. Every entry is handed to the system
+    // at once (survives a crash of the app) but synced to the disk only in batches
+    class JournalFile
+    {
+    public:
+        JournalFile() {}
+        ~JournalFile();
+        
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const { return file != nullptr; }
+        
+        bool append(const std::string& line);
+        void sync();
+        
+        // entries appended since opened
+        size_t getEntryCnt() const { return entryCnt; }
+        
+    private:
+        JournalFile(const JournalFile&) = delete;
+        JournalFile& operator = (const JournalFile&) = delete;
+        
+        const int sync_entries = 32;
+        const int sync_seconds = 5;
+        
+        FILE* file = nullptr;
+        size_t entryCnt = 0;
+        int unsyncedCnt = 0;
+        std::chrono::steady_clock::time_point syncTime;
+    };
+    
+} // namespace banksia
+
+#endif /* journalfile_h */
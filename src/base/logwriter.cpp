@@ -0,0 +1,235 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+
+#include "logwriter.h"
+#include "metrics.h"
+
+using namespace banksia;
+
+LogWriter::~LogWriter()
+{
+    shutdown();
+}
+
+void LogWriter::start(int _flushIntervalMs)
+{
+    if (running) {
+        return;
+    }
+    flushIntervalMs = std::max(1, _flushIntervalMs);
+    running = true;
+    pThread = new std::thread([=]() { run(); });
+}
+
+void LogWriter::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> dolock(waitMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    waitCondition.notify_one();
+    
+    if (pThread) {
+        if (pThread->joinable()) {
+            pThread->join();
+        }
+        delete pThread;
+        pThread = nullptr;
+    }
+    
+    // a writer may have seen running before it was cleared
+    while (producerCnt.load() > 0) {
+        std::this_thread::yield();
+    }
+    
+    // lines pushed while stopping
+    writeItems();
+    closeFiles();
+}
+
+void LogWriter::write(const std::string& path, const std::string& line)
+{
+    producerCnt++;
+    if (!running) {
+        producerCnt--;
+        if (GzipFile::isGzipPath(path)) {
+            // a frame of its own
+            GzipFile file;
+            auto str = line + "\n";
+            if (!file.open(path, frameSize) || !file.write(str.c_str(), str.size())) {
+                std::cerr << "Error: can't write log file " << path << std::endl;
+            }
+            return;
+        }
+        std::ofstream ofs(path, std::ios_base::out | std::ios_base::app);
+        ofs << line << std::endl;
+        return;
+    }
+    
+    Metrics::gauge(MetricGauge::logQueue, 1);
+    auto item = new Item { path, line, head.load(std::memory_order_relaxed) };
+    while (!head.compare_exchange_weak(item->next, item, std::memory_order_release, std::memory_order_relaxed)) {}
+    producerCnt--;
+}
+
+void LogWriter::run()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(waitMutex);
+            waitCondition.wait_for(lock, std::chrono::milliseconds(flushIntervalMs), [&]() {
+                return !running;
+            });
+        }
+        
+        writeItems();
+        
+        if (!running) {
+            break;
+        }
+    }
+}
+
+void LogWriter::writeItems()
+{
+    // the list is taken as a whole, newest first
+    auto item = head.exchange(nullptr, std::memory_order_acquire);
+    if (!item) {
+        return;
+    }
+    
+    Item* list = nullptr;
+    i64 cnt = 0;
+    while (item) {
+        auto next = item->next;
+        item->next = list;
+        list = item;
+        item = next;
+        cnt++;
+    }
+    Metrics::gauge(MetricGauge::logQueue, -cnt);
+    
+    for(item = list; item; ) {
+        if (GzipFile::isGzipPath(item->path)) {
+            writeGzip(item->path, item->line);
+            auto next = item->next;
+            delete item;
+            item = next;
+            continue;
+        }
+        
+        auto it = fileMap.find(item->path);
+        if (it == fileMap.end()) {
+            if (fileMap.size() + gzipFileMap.size() >= max_open_files) {
+                closeFiles();
+            }
+            FILE* file = nullptr;
+            if (canOpen(item->path)) {
+                file = fopen(item->path.c_str(), "a");
+                if (file) {
+                    it = fileMap.insert(std::make_pair(item->path, file)).first;
+                } else {
+                    openFailed(item->path);
+                }
+            }
+        }
+        
+        if (it != fileMap.end()) {
+            fwrite(item->line.c_str(), 1, item->line.size(), it->second);
+            fputc('\n', it->second);
+        }
+        
+        auto next = item->next;
+        delete item;
+        item = next;
+    }
+    
+    for(auto && p : fileMap) {
+        fflush(p.second);
+    }
+}
+
+// frames are written when full only, not at every flush
+void LogWriter::writeGzip(const std::string& path, const std::string& line)
+{
+    auto it = gzipFileMap.find(path);
+    if (it == gzipFileMap.end()) {
+        if (fileMap.size() + gzipFileMap.size() >= max_open_files) {
+            closeFiles();
+        }
+        if (!canOpen(path)) {
+            return;
+        }
+        auto file = new GzipFile;
+        if (!file->open(path, frameSize)) {
+            delete file;
+            openFailed(path);
+            return;
+        }
+        it = gzipFileMap.insert(std::make_pair(path, file)).first;
+    }
+    
+    it->second->write(line.c_str(), line.size());
+    it->second->write("\n", 1);
+}
+
+// lines of a path failed to open are dropped until the retry time
+bool LogWriter::canOpen(const std::string& path)
+{
+    auto it = failedMap.find(path);
+    if (it == failedMap.end()) {
+        return true;
+    }
+    if (std::chrono::steady_clock::now() < it->second) {
+        return false;
+    }
+    failedMap.erase(it);
+    return true;
+}
+
+void LogWriter::openFailed(const std::string& path)
+{
+    std::cerr << "Error: can't open log file " << path << std::endl;
+    failedMap[path] = std::chrono::steady_clock::now() + std::chrono::milliseconds(open_retry_ms);
+}
+
+void LogWriter::closeFiles()
+{
+    for(auto && p : fileMap) {
+        fclose(p.second);
+    }
+    fileMap.clear();
+    
+    for(auto && p : gzipFileMap) {
+        delete p.second;
+    }
+    gzipFileMap.clear();
+}
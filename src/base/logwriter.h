@@ -0,0 +1,98 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef logwriter_h
+#define logwriter_h
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "comm.h"
+#include "gzipfile.h"
+
+namespace banksia {
+    
+    // Appends text lines to files on its own thread. Producers only push the lines
+    // into a lock-free list thus they never wait for the disk nor for each other.
+    // Files are kept open and written in batches, one batch per flush interval.
+    // Paths ending with .gz are compressed, in frames (see GzipFile)
+    class LogWriter
+    {
+    public:
+        LogWriter() {}
+        ~LogWriter();
+        
+        void start(int flushIntervalMs);
+        // bytes of text per frame of compressed files, set before start
+        void setFrameSize(size_t size) { frameSize = size; }
+        // writes all pending lines and closes the files
+        void shutdown();
+        
+        // safe to call from any thread. Lines are written directly when the writer is not running
+        void write(const std::string& path, const std::string& line);
+        
+    private:
+        LogWriter(const LogWriter&) = delete;
+        LogWriter& operator = (const LogWriter&) = delete;
+        
+        struct Item {
+            std::string path, line;
+            Item* next;
+        };
+        
+        void run();
+        void writeItems();
+        void writeGzip(const std::string& path, const std::string& line);
+        void closeFiles();
+        bool canOpen(const std::string& path);
+        void openFailed(const std::string& path);
+        
+        const size_t max_open_files = 64;
+        const int open_retry_ms = 2000;
+        
+        std::atomic<Item*> head { nullptr };
+        std::atomic<bool> running { false };
+        // writers between their check of running and their push
+        std::atomic<int> producerCnt { 0 };
+        int flushIntervalMs = 500;
+        size_t frameSize = 1024 * 1024;
+        
+        std::mutex waitMutex;
+        std::condition_variable waitCondition;
+        std::thread* pThread = nullptr;
+        
+        // used by the writing thread only
+        std::unordered_map<std::string, FILE*> fileMap;
+        std::unordered_map<std::string, GzipFile*> gzipFileMap;
+        // paths failed to open, not tried again until the time
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point> failedMap;
+    };
+    
+} // namespace banksia
+
+#endif /* logwriter_h */
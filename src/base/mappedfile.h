@@ -0,0 +1,62 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef mappedfile_h
+#define mappedfile_h
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // A whole file mapped read-only into memory. The pages come from the system file cache
+    // thus they are loaded on demand and shared between all processes opening the same file
+    class MappedFile
+    {
+    public:
+        MappedFile() {}
+        ~MappedFile();
+        
+        bool open(const std::string& path);
+        void close();
+        
+        bool isOpen() const { return ptr != nullptr; }
+        const char* data() const { return ptr; }
+        i64 size() const { return length; }
+        
+    private:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator = (const MappedFile&) = delete;
+        
+        const char* ptr = nullptr;
+        i64 length = 0;
+        
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mapHandle = nullptr;
+#endif
+    };
+    
+} // namespace banksia
+
+#endif /* mappedfile_h */
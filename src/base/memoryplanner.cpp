@@ -0,0 +1,149 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <fstream>
+#include <cstdlib>
+#include <cctype>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "memoryplanner.h"
+
+using namespace banksia;
+
+i64 MemoryPlanner::hostMemory()
+{
+    auto mb = i64(getMemorySize() / (1024 * 1024));
+    
+#ifdef __linux__
+    // cgroup v2 then v1, "max" or a huge number for no limit
+    for(auto && path : { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" }) {
+        std::ifstream ifs(path);
+        std::string str;
+        if (ifs >> str && !str.empty() && isdigit(str.at(0))) {
+            auto limit = i64(std::strtoll(str.c_str(), nullptr, 10) / (1024 * 1024));
+            if (limit > 0 && limit < mb) {
+                mb = limit;
+            }
+            break;
+        }
+    }
+#endif
+    return mb;
+}
+
+i64 MemoryPlanner::syzygySize(const std::string& syzygyPath)
+{
+#ifdef _WIN32
+    const char sepChar = ';';
+#else
+    const char sepChar = ':';
+#endif
+    
+    i64 sz = 0;
+    for(auto && folder : splitString(syzygyPath, sepChar)) {
+        for(auto && path : listdir(folder)) {
+            auto k = path.find_last_of('.');
+            if (k != std::string::npos && (path.substr(k) == ".rtbw" || path.substr(k) == ".rtbz")) {
+                sz += getFileSize(path);
+            }
+        }
+    }
+    return sz / (1024 * 1024);
+}
+
+int MemoryPlanner::plan(i64 available, int engineCnt, int maxHash)
+{
+    if (engineCnt <= 0 || available < engineCnt) {
+        return 0;
+    }
+    
+    auto each = available / engineCnt;
+    if (maxHash > 0) {
+        each = std::min(each, i64(maxHash));
+    }
+    
+    // engines round hashes down to powers of two anyway
+    auto hash = 1;
+    while (i64(hash) * 2 <= each && hash < (1 << 30)) {
+        hash *= 2;
+    }
+    return hash;
+}
+
+#ifdef __linux__
+
+bool MemoryPlanner::applyLimit(i64 processId, int mb)
+{
+    if (processId <= 0 || mb <= 0) {
+        return false;
+    }
+    
+    // since Linux 4.7 the data limit counts private anonymous mappings where hashes live,
+    // shared file mappings such as tablebases stay out
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max = rlim_t(mb) * 1024 * 1024;
+    return prlimit(pid_t(processId), RLIMIT_DATA, &limit, nullptr) == 0;
+}
+
+#elif defined(_WIN32)
+
+bool MemoryPlanner::applyLimit(i64 processId, int mb)
+{
+    if (processId <= 0 || mb <= 0) {
+        return false;
+    }
+    
+    auto handle = OpenProcess(PROCESS_SET_QUOTA | PROCESS_TERMINATE, FALSE, DWORD(processId));
+    if (!handle) {
+        return false;
+    }
+    
+    // the job lives on with its process after the handle is closed
+    auto ok = false;
+    if (auto job = CreateJobObject(nullptr, nullptr)) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION info = {};
+        info.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+        info.ProcessMemoryLimit = SIZE_T(mb) * 1024 * 1024;
+        ok = SetInformationJobObject(job, JobObjectExtendedLimitInformation, &info, sizeof(info))
+            && AssignProcessToJobObject(job, handle);
+        CloseHandle(job);
+    }
+    CloseHandle(handle);
+    return ok;
+}
+
+#else
+
+// no way to limit other processes (macOS)
+bool MemoryPlanner::applyLimit(i64, int)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef memoryplanner_h
+#define memoryplanner_h
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // Works out the hash of engines from the memory of the host, thus raising the
+    // concurrency shrinks hashes instead of making the host swap. Units are MB
+    class MemoryPlanner
+    {
+    public:
+        // the physical memory, or the limit of the container if it is lower
+        static i64 hostMemory();
+        
+        // tablebase files of a syzygy path list, their page caches are shared by all processes
+        static i64 syzygySize(const std::string& syzygyPath);
+        
+        // hash of each of engineCnt engines as a power of two not over maxHash (zero for
+        // no cap), zero if they don't fit
+        static int plan(i64 available, int engineCnt, int maxHash);
+        
+        // caps the private memory (heap and anonymous mappings) of a running process,
+        // by a resource limit on Linux and a job object on Windows
+        static bool applyLimit(i64 processId, int mb);
+        
+        // an engine's code, stacks and evaluation data besides its hash
+        static const int engine_base_memory = 64;
+    };
+    
+} // namespace banksia
+
+#endif /* memoryplanner_h */
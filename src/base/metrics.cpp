@@ -0,0 +1,198 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#include "metrics.h"
+
+using namespace banksia;
+
+Histogram::Histogram()
+{
+    for(auto && b : buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::add(i64 us)
+{
+    us = std::max<i64>(0, us);
+    
+    // bucket k holds [2^(k-1), 2^k), bucket 0 holds 0
+    auto k = 0;
+    for(auto v = us; v > 0 && k < bucket_cnt - 1; v >>= 1) {
+        k++;
+    }
+    buckets[k].fetch_add(1, std::memory_order_relaxed);
+    cnt.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(us, std::memory_order_relaxed);
+    
+    auto m = maxValue.load(std::memory_order_relaxed);
+    while (us > m && !maxValue.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+}
+
+i64 Histogram::percentile(double p) const
+{
+    auto n = count();
+    if (n == 0) {
+        return 0;
+    }
+    auto target = std::max<i64>(1, i64(p * n + 0.5));
+    i64 sum = 0;
+    for(int k = 0; k < bucket_cnt; k++) {
+        sum += buckets[k].load(std::memory_order_relaxed);
+        if (sum >= target) {
+            return std::min(maxValue.load(std::memory_order_relaxed), k == 0 ? 0 : (i64(1) << k) - 1);
+        }
+    }
+    return maxValue.load(std::memory_order_relaxed);
+}
+
+std::string Histogram::toString() const
+{
+    auto n = count();
+    std::ostringstream stringStream;
+    stringStream << std::fixed << std::setprecision(2)
+    << "n: " << n
+    << ", avg: " << double(total.load(std::memory_order_relaxed)) / std::max<i64>(1, n) / 1000
+    << ", p50: " << double(percentile(0.5)) / 1000
+    << ", p99: " << double(percentile(0.99)) / 1000
+    << ", max: " << double(maxValue.load(std::memory_order_relaxed)) / 1000
+    << " (ms)";
+    return stringStream.str();
+}
+
+Json::Value Histogram::saveToJson() const
+{
+    Json::Value obj;
+    obj["count"] = Json::Int64(count());
+    obj["sum us"] = Json::Int64(total.load(std::memory_order_relaxed));
+    obj["max us"] = Json::Int64(maxValue.load(std::memory_order_relaxed));
+    obj["p50 us"] = Json::Int64(percentile(0.5));
+    obj["p99 us"] = Json::Int64(percentile(0.99));
+    
+    // upper bounds of not empty buckets
+    Json::Value b;
+    for(int k = 0; k < bucket_cnt; k++) {
+        auto c = buckets[k].load(std::memory_order_relaxed);
+        if (c) {
+            b[std::to_string(k == 0 ? 0 : (i64(1) << k) - 1)] = Json::Int64(c);
+        }
+    }
+    obj["buckets"] = b;
+    return obj;
+}
+
+//////////////////////////////////////////
+Histogram Metrics::hists[static_cast<int>(MetricHist::max)];
+std::atomic<i64> Metrics::counts[static_cast<int>(MetricCount::max)];
+std::atomic<i64> Metrics::gauges[static_cast<int>(MetricGauge::max)];
+std::atomic<i64> Metrics::gaugeMaxs[static_cast<int>(MetricGauge::max)];
+const std::chrono::steady_clock::time_point Metrics::startClock = std::chrono::steady_clock::now();
+
+static const char* histNames[] = {
+    "bestmove to go", "parse", "checkmake", "rule", "engine startup", nullptr
+};
+
+static const char* countNames[] = {
+    "parsed lines", "parsed bytes", "games started", nullptr
+};
+
+static const char* gaugeNames[] = {
+    "log queue", nullptr
+};
+
+void Metrics::gauge(MetricGauge name, i64 delta)
+{
+    auto k = static_cast<int>(name);
+    auto v = gauges[k].fetch_add(delta, std::memory_order_relaxed) + delta;
+    auto m = gaugeMaxs[k].load(std::memory_order_relaxed);
+    while (v > m && !gaugeMaxs[k].compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+}
+
+std::string Metrics::toString()
+{
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startClock).count();
+    auto minutes = std::max(1.0 / 60, elapsed / 60);
+    
+    std::ostringstream stringStream;
+    stringStream << std::fixed << std::setprecision(1) << "Metrics (uptime: " << elapsed << "s):\n";
+    
+    for(int i = 0; histNames[i]; i++) {
+        stringStream << "  " << std::left << std::setw(16) << histNames[i] << hists[i].toString() << "\n";
+    }
+    
+    auto lines = counts[static_cast<int>(MetricCount::parsedLines)].load();
+    auto bytes = counts[static_cast<int>(MetricCount::parsedBytes)].load();
+    auto games = counts[static_cast<int>(MetricCount::gamesStarted)].load();
+    stringStream
+    << "  " << std::left << std::setw(16) << "parsed" << lines << " lines, " << bytes / 1024 << " KB, "
+    << double(lines) / std::max(1.0, elapsed) << " lines/s\n"
+    << "  " << std::left << std::setw(16) << "games started" << games << ", " << double(games) / minutes << " per minute\n";
+    
+    for(int i = 0; gaugeNames[i]; i++) {
+        stringStream << "  " << std::left << std::setw(16) << gaugeNames[i]
+        << gauges[i].load() << ", max: " << gaugeMaxs[i].load() << "\n";
+    }
+    return stringStream.str();
+}
+
+Json::Value Metrics::saveToJson()
+{
+    Json::Value obj;
+    obj["uptime ms"] = Json::Int64(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startClock).count());
+    
+    for(int i = 0; histNames[i]; i++) {
+        obj["histograms"][histNames[i]] = hists[i].saveToJson();
+    }
+    for(int i = 0; countNames[i]; i++) {
+        obj["counters"][countNames[i]] = Json::Int64(counts[i].load());
+    }
+    for(int i = 0; gaugeNames[i]; i++) {
+        obj["gauges"][gaugeNames[i]]["value"] = Json::Int64(gauges[i].load());
+        obj["gauges"][gaugeNames[i]]["max"] = Json::Int64(gaugeMaxs[i].load());
+    }
+    return obj;
+}
+
+bool Metrics::saveToJsonFile(const std::string& path)
+{
+    // written aside then renamed, readers never see a half file
+    auto tmpPath = path + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios_base::out | std::ios_base::trunc);
+        if (!ofs) {
+            return false;
+        }
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = " ";
+        ofs << Json::writeString(builder, saveToJson()) << std::endl;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,109 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <atomic>
+#include <chrono>
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // Latencies in microseconds, counted in power-of-two buckets. Lock-free, any thread can add
+    class Histogram
+    {
+    public:
+        Histogram();
+        
+        void add(i64 us);
+        
+        i64 count() const { return cnt.load(std::memory_order_relaxed); }
+        // the upper bound of the bucket holding the percentile p (0..1)
+        i64 percentile(double p) const;
+        
+        std::string toString() const;
+        Json::Value saveToJson() const;
+        
+    private:
+        static const int bucket_cnt = 40;
+        std::atomic<i64> buckets[bucket_cnt];
+        std::atomic<i64> cnt { 0 }, total { 0 }, maxValue { 0 };
+    };
+    
+    enum class MetricHist {
+        bestmoveToGo,   // from reading a bestmove to writing the next go
+        parse,          // parsing and handling one read of engine output
+        checkMake,      // ChessBoard::checkMake of a move from an engine
+        rule,           // ChessBoard::rule after that move
+        engineStartup,  // from launching an engine to its ready state
+        max
+    };
+    
+    enum class MetricCount {
+        parsedLines, parsedBytes, gamesStarted, max
+    };
+    
+    enum class MetricGauge {
+        logQueue,       // lines waiting for the log writer
+        max
+    };
+    
+    // Counters of the manager itself, to tell whether time goes to engines, the scheduler or I/O
+    class Metrics
+    {
+    public:
+        static void add(MetricHist name, i64 us) {
+            hists[static_cast<int>(name)].add(us);
+        }
+        static void add(MetricHist name, const std::chrono::steady_clock::time_point& from, const std::chrono::steady_clock::time_point& to) {
+            add(name, std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+        }
+        static void count(MetricCount name, i64 n = 1) {
+            counts[static_cast<int>(name)].fetch_add(n, std::memory_order_relaxed);
+        }
+        static void gauge(MetricGauge name, i64 delta);
+        
+        static i64 getCount(MetricHist name) {
+            return hists[static_cast<int>(name)].count();
+        }
+        static i64 getCount(MetricCount name) {
+            return counts[static_cast<int>(name)].load(std::memory_order_relaxed);
+        }
+        
+        static std::string toString();
+        static Json::Value saveToJson();
+        static bool saveToJsonFile(const std::string& path);
+        
+    private:
+        static Histogram hists[static_cast<int>(MetricHist::max)];
+        static std::atomic<i64> counts[static_cast<int>(MetricCount::max)];
+        static std::atomic<i64> gauges[static_cast<int>(MetricGauge::max)], gaugeMaxs[static_cast<int>(MetricGauge::max)];
+        static const std::chrono::steady_clock::time_point startClock;
+    };
+    
+} // namespace banksia
+
+#endif /* metrics_h */
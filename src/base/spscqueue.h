@@ -0,0 +1,78 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef spscqueue_h
+#define spscqueue_h
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace banksia {
+    
+    // Lock-free ring of fixed capacity for one producer thread and one consumer thread.
+    // Neither side ever waits, push fails when the ring is full
+    template <typename T, size_t capacity>
+    class SpscQueue
+    {
+    public:
+        // producer only
+        bool push(T&& item) {
+            auto t = tail.load(std::memory_order_relaxed);
+            auto next = (t + 1) % size;
+            if (next == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            slots[t] = std::move(item);
+            tail.store(next, std::memory_order_release);
+            return true;
+        }
+        
+        // consumer only
+        bool pop(T& item) {
+            auto h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = std::move(slots[h]);
+            head.store((h + 1) % size, std::memory_order_release);
+            return true;
+        }
+        
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+        
+    private:
+        // one slot stays empty to tell a full ring from an empty one
+        static const size_t size = capacity + 1;
+        
+        T slots[size];
+        std::atomic<size_t> head { 0 }, tail { 0 };
+    };
+    
+} // namespace banksia
+
+#endif /* spscqueue_h */
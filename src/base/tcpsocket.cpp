@@ -0,0 +1,266 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#else
+
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#endif
+
+#include <cstring>
+
+#include "tcpsocket.h"
+
+using namespace banksia;
+
+#ifdef _WIN32
+#define closeSocket(s) closesocket(SOCKET(s))
+#else
+#define closeSocket(s) ::close(s)
+#endif
+
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL;
+#else
+static const int send_flags = 0;
+#endif
+
+TcpSocket::~TcpSocket()
+{
+    close();
+    if (fd != invalid_fd) {
+        closeSocket(fd);
+        fd = invalid_fd;
+    }
+}
+
+bool TcpSocket::startup()
+{
+#ifdef _WIN32
+    static bool ok = false;
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        WSADATA wsaData;
+        ok = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    });
+    return ok;
+#else
+    return true;
+#endif
+}
+
+bool TcpSocket::parseAddress(const std::string& address, std::string& host, int& port)
+{
+    auto p = address.rfind(':');
+    if (p == std::string::npos || p == 0 || p + 1 >= address.size()) {
+        return false;
+    }
+    host = address.substr(0, p);
+    port = std::atoi(address.c_str() + p + 1);
+    return port > 0 && port < 65536;
+}
+
+bool TcpSocket::connect(const std::string& host, int port)
+{
+    if (fd != invalid_fd || !startup()) {
+        return false;
+    }
+    
+    struct addrinfo hints, *list = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &list) != 0) {
+        return false;
+    }
+    
+    for(auto ai = list; ai; ai = ai->ai_next) {
+        auto s = socket_t(socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+        if (s == invalid_fd) {
+            continue;
+        }
+        if (::connect(s, ai->ai_addr, int(ai->ai_addrlen)) == 0) {
+            fd = s;
+            break;
+        }
+        closeSocket(s);
+    }
+    freeaddrinfo(list);
+    
+    if (fd == invalid_fd) {
+        return false;
+    }
+    
+    // lines are small and should go out straight
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    peerName = host + ":" + std::to_string(port);
+    return true;
+}
+
+bool TcpSocket::listen(int port)
+{
+    if (fd != invalid_fd || !startup()) {
+        return false;
+    }
+    
+    auto s = socket_t(socket(AF_INET, SOCK_STREAM, 0));
+    if (s == invalid_fd) {
+        return false;
+    }
+    
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(u16(port));
+    
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(s, 16) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    fd = s;
+    return true;
+}
+
+TcpSocket* TcpSocket::accept()
+{
+    while (!closed) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        auto s = socket_t(::accept(fd, (struct sockaddr*)&addr, &len));
+        if (s == invalid_fd) {
+            if (closed) {
+                break;
+            }
+            continue;
+        }
+        
+        // the wake-up connection of close
+        if (closed) {
+            closeSocket(s);
+            break;
+        }
+        
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        
+        auto socket = new TcpSocket;
+        socket->fd = s;
+        char buf[64];
+        auto ip = inet_ntop(AF_INET, &addr.sin_addr, buf, sizeof(buf));
+        socket->peerName = std::string(ip ? ip : "?") + ":" + std::to_string(ntohs(addr.sin_port));
+        return socket;
+    }
+    return nullptr;
+}
+
+bool TcpSocket::writeLine(const std::string& line)
+{
+    std::lock_guard<std::mutex> dolock(writeMutex);
+    if (!isOpen()) {
+        return false;
+    }
+    
+    auto str = line + "\n";
+    for(size_t k = 0; k < str.size(); ) {
+        auto n = send(fd, str.c_str() + k, int(str.size() - k), send_flags);
+        if (n <= 0) {
+            return false;
+        }
+        k += size_t(n);
+    }
+    return true;
+}
+
+bool TcpSocket::readLine(std::string& line)
+{
+    while (true) {
+        auto p = readBuf.find('\n', readPos);
+        if (p != std::string::npos) {
+            line = readBuf.substr(readPos, p - readPos);
+            readPos = p + 1;
+            if (readPos == readBuf.size()) {
+                readBuf.clear();
+                readPos = 0;
+            }
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return true;
+        }
+        
+        if (closed) {
+            return false;
+        }
+        
+        char buf[16 * 1024];
+        auto n = recv(fd, buf, int(sizeof(buf)), 0);
+        if (n <= 0) {
+            return false;
+        }
+        if (readPos > 0) {
+            readBuf.erase(0, readPos);
+            readPos = 0;
+        }
+        readBuf.append(buf, size_t(n));
+    }
+}
+
+void TcpSocket::close()
+{
+    if (closed.exchange(true) || fd == invalid_fd) {
+        return;
+    }
+    
+#ifdef _WIN32
+    shutdown(SOCKET(fd), SD_BOTH);
+    // a listening socket wakes up its accept only when closed
+    closesocket(SOCKET(fd));
+    fd = invalid_fd;
+#else
+    // the descriptor is kept until the destructor thus a blocked thread never reads a reused one
+    shutdown(fd, SHUT_RDWR);
+#endif
+}
@@ -0,0 +1,85 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef tcpsocket_h
+#define tcpsocket_h
+
+#include <atomic>
+
+#include "comm.h"
+
+namespace banksia {
+    
+    // A blocking TCP connection exchanging text lines. One thread may read while
+    // others write, writes are serialized
+    class TcpSocket
+    {
+    public:
+        TcpSocket() {}
+        ~TcpSocket();
+        
+        bool connect(const std::string& host, int port);
+        bool listen(int port);
+        // nullptr when the listening socket has been closed
+        TcpSocket* accept();
+        
+        bool writeLine(const std::string& line);
+        // false when the connection is closed
+        bool readLine(std::string& line);
+        
+        // wakes up the threads blocked in accept or readLine
+        void close();
+        bool isOpen() const { return fd != invalid_fd && !closed; }
+        
+        std::string getPeerName() const { return peerName; }
+        
+        // "host:port" to host and port
+        static bool parseAddress(const std::string& address, std::string& host, int& port);
+        
+    private:
+        TcpSocket(const TcpSocket&) = delete;
+        TcpSocket& operator = (const TcpSocket&) = delete;
+        
+        static bool startup();
+        
+#ifdef _WIN32
+        typedef u64 socket_t;
+#else
+        typedef int socket_t;
+#endif
+        static const socket_t invalid_fd = socket_t(-1);
+        
+        socket_t fd = invalid_fd;
+        std::atomic<bool> closed { false };
+        std::string peerName;
+        std::mutex writeMutex;
+        
+        // used by the reading thread only
+        std::string readBuf;
+        size_t readPos = 0;
+    };
+    
+} // namespace banksia
+
+#endif /* tcpsocket_h */
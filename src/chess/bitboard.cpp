@@ -0,0 +1,173 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bitboard.h"
+
+using namespace banksia;
+
+u64 Bitboard::knightAttacks[64];
+u64 Bitboard::kingAttacks[64];
+u64 Bitboard::pawnAttacks[2][64];
+
+Bitboard::Magic Bitboard::bishopMagics[64];
+Bitboard::Magic Bitboard::rookMagics[64];
+u64 Bitboard::bishopTable[0x1480];
+u64 Bitboard::rookTable[0x19000];
+
+static const int bishopDirs[4][2] = { {-1, -1}, {-1, 1}, {1, -1}, {1, 1} };
+static const int rookDirs[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+// xorshift64star, seeded the same way every run so the magics are reproducible
+class MagicRandom {
+public:
+    MagicRandom(u64 seed) : s(seed) {}
+    
+    u64 rand() {
+        s ^= s >> 12; s ^= s << 25; s ^= s >> 27;
+        return s * 2685821657736338717ULL;
+    }
+    
+    // candidates with few bits set are found much faster
+    u64 sparse() {
+        return rand() & rand() & rand();
+    }
+    
+private:
+    u64 s;
+};
+
+u64 Bitboard::slidingAttacks(int pos, u64 occupied, const int (*dirs)[2])
+{
+    u64 attacks = 0;
+    for(int d = 0; d < 4; d++) {
+        for(int r = (pos >> 3) + dirs[d][0], c = (pos & 7) + dirs[d][1];
+            r >= 0 && r < 8 && c >= 0 && c < 8;
+            r += dirs[d][0], c += dirs[d][1]) {
+            auto b = BB(r * 8 + c);
+            attacks |= b;
+            if (occupied & b) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+void Bitboard::initMagics(Magic* magics, u64* table, const int (*dirs)[2])
+{
+    const u64 row0 = 0xffULL, row7 = row0 << 56;
+    const u64 col0 = 0x0101010101010101ULL, col7 = col0 << 7;
+    const int seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+    
+    static u64 occupancy[4096], reference[4096];
+    static int epoch[4096];
+    int cnt = 0;
+    
+    MagicRandom rng(seeds[0]);
+    auto attacks = table;
+    
+    for(int pos = 0; pos < 64; pos++) {
+        int row = pos >> 3, col = pos & 7;
+        if (col == 0) {
+            rng = MagicRandom(seeds[7 - row]);
+        }
+        
+        // edges are not relevant for occupancy, unless the piece stands on them
+        auto edges = ((row0 | row7) & ~(row0 << (row * 8))) | ((col0 | col7) & ~(col0 << col));
+        
+        auto& m = magics[pos];
+        m.mask = slidingAttacks(pos, 0, dirs) & ~edges;
+        m.shift = 64 - popCount(m.mask);
+        m.attacks = attacks;
+        
+        // Carry-Rippler trick to enumerate all subsets of the mask
+        int size = 0;
+        u64 b = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = slidingAttacks(pos, b, dirs);
+            size++;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        
+        attacks += size;
+        
+        for(int i = 0; i < size; ) {
+            for(m.magic = 0; popCount((m.magic * m.mask) >> 56) < 6; ) {
+                m.magic = rng.sparse();
+            }
+            
+            // epoch avoids clearing the attack table for every candidate
+            for(++cnt, i = 0; i < size; i++) {
+                auto idx = m.index(occupancy[i]);
+                if (epoch[idx] < cnt) {
+                    epoch[idx] = cnt;
+                    m.attacks[idx] = reference[i];
+                } else if (m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool Bitboard::init()
+{
+    const int knightSteps[8][2] = { {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1} };
+    
+    for(int pos = 0; pos < 64; pos++) {
+        int row = pos >> 3, col = pos & 7;
+        
+        knightAttacks[pos] = kingAttacks[pos] = 0;
+        for(int i = 0; i < 8; i++) {
+            int r = row + knightSteps[i][0], c = col + knightSteps[i][1];
+            if (r >= 0 && r < 8 && c >= 0 && c < 8) {
+                knightAttacks[pos] |= BB(r * 8 + c);
+            }
+        }
+        
+        for(int r = row - 1; r <= row + 1; r++) {
+            for(int c = col - 1; c <= col + 1; c++) {
+                if (r >= 0 && r < 8 && c >= 0 && c < 8 && (r != row || c != col)) {
+                    kingAttacks[pos] |= BB(r * 8 + c);
+                }
+            }
+        }
+        
+        // white pawns go up (to smaller positions), black ones go down
+        pawnAttacks[W][pos] = pawnAttacks[B][pos] = 0;
+        if (row > 0) {
+            if (col > 0) pawnAttacks[W][pos] |= BB(pos - 9);
+            if (col < 7) pawnAttacks[W][pos] |= BB(pos - 7);
+        }
+        if (row < 7) {
+            if (col > 0) pawnAttacks[B][pos] |= BB(pos + 7);
+            if (col < 7) pawnAttacks[B][pos] |= BB(pos + 9);
+        }
+    }
+    
+    initMagics(bishopMagics, bishopTable, bishopDirs);
+    initMagics(rookMagics, rookTable, rookDirs);
+    return true;
+}
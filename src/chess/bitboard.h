@@ -0,0 +1,101 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef bitboard_h
+#define bitboard_h
+
+#include "../base/comm.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace banksia {
+    
+    // Squares are numbered as in ChessBoard: 0 = a8, 7 = h8, 56 = a1, 63 = h1
+    #define BB(pos) (u64(1) << (pos))
+    
+    class Bitboard {
+    public:
+        static bool init();
+        
+        static u64 knightAttacks[64], kingAttacks[64];
+        static u64 pawnAttacks[2][64]; // index B / W
+        
+        static u64 bishopAttacks(int pos, u64 occupied) {
+            auto& m = bishopMagics[pos];
+            return m.attacks[m.index(occupied)];
+        }
+        
+        static u64 rookAttacks(int pos, u64 occupied) {
+            auto& m = rookMagics[pos];
+            return m.attacks[m.index(occupied)];
+        }
+        
+        static int lsb(u64 bb) {
+#ifdef _MSC_VER
+            unsigned long idx;
+            _BitScanForward64(&idx, bb);
+            return int(idx);
+#else
+            return __builtin_ctzll(bb);
+#endif
+        }
+        
+        static int popLsb(u64& bb) {
+            auto pos = lsb(bb);
+            bb &= bb - 1;
+            return pos;
+        }
+        
+        static int popCount(u64 bb) {
+#ifdef _MSC_VER
+            return int(__popcnt64(bb));
+#else
+            return __builtin_popcountll(bb);
+#endif
+        }
+        
+    private:
+        class Magic {
+        public:
+            u64 mask, magic;
+            u64* attacks;
+            int shift;
+            
+            int index(u64 occupied) const {
+                return int(((occupied & mask) * magic) >> shift);
+            }
+        };
+        
+        static Magic bishopMagics[64], rookMagics[64];
+        static u64 bishopTable[0x1480], rookTable[0x19000];
+        
+        static u64 slidingAttacks(int pos, u64 occupied, const int (*dirs)[2]);
+        static void initMagics(Magic* magics, u64* table, const int (*dirs)[2]);
+    };
+    
+} // namespace banksia
+
+#endif /* bitboard_h */
@@ -26,25 +26,43 @@
 #define chess_h
 
 #include <stdio.h>
+#include <array>
 
 #include "../base/base.h"
+#include "bitboard.h"
 
 namespace banksia {
     
     extern const char* originalFen;
     
-    class ChessBoard : public BoardCore {
+    // a position as fathom wants it (square a1 = 0), detached from the board so it can be probed on other threads
+    struct SyzygyPos
+    {
+        u64 white, black, kings, queens, rooks, bishops, knights, pawns;
+        u8 castling, rule50, ep;
+        bool turn;
+    };
+    
+    // The board of games, books and SAN parsing. It is final and keeps the squares in a fixed array,
+    // thus the square accesses, move generation, make and takeBack are inlined or called directly
+    class ChessBoard final : public BoardCore {
         
         const int CastleRight_long  = (1<<0);
         const int CastleRight_short = (1<<1);
         const int CastleRight_mask  = (CastleRight_long|CastleRight_short);
         
-        const int Chess_MaxMoveNumber = 250;
-
     protected:
+        std::array<Piece, 64> pieces;
+        
         int enpassant;
         int8_t castleRights[2];
         
+        // bitboards mirror pieces, they are kept in sync by setFen, make and takeBack
+        u64 bbPieces[2][7], bbOccupied[2];
+        
+        // hash keys before each move of histList, compact for repetition checks
+        std::vector<u64> repetitionKeys;
+        
     public:
         ChessBoard();
         virtual ~ChessBoard();
@@ -52,32 +70,87 @@ namespace banksia {
         virtual std::string toString() const override;
         virtual bool isValid() const override;
         
-        virtual int columnCount() const override;
-        virtual int getColumn(int pos) const override;
-        virtual int getRow(int pos) const override;
+        virtual void reset() override {
+            pieces.fill(Piece(PieceType::empty, Side::none));
+        }
+        
+        virtual int size() const override {
+            return 64;
+        }
+        
+        virtual bool isPositionValid(int pos) const override {
+            return pos >= 0 && pos < 64;
+        }
+        
+        virtual int columnCount() const override {
+            return 8;
+        }
+        virtual int getColumn(int pos) const override {
+            return pos & 7;
+        }
+        virtual int getRow(int pos) const override {
+            return pos >> 3;
+        }
+        
+        virtual void setPiece(int pos, Piece piece) override {
+            assert(isPositionValid(pos));
+            pieces[size_t(pos)] = piece;
+        }
+        
+        virtual Piece getPiece(int pos) const override {
+            assert(isPositionValid(pos));
+            return pieces[size_t(pos)];
+        }
+        
+        virtual bool isEmpty(int pos) const override {
+            assert(isPositionValid(pos));
+            return pieces[size_t(pos)].type == PieceType::empty;
+        }
+        
+        virtual bool isPiece(int pos, PieceType type, Side side) const override {
+            assert(isPositionValid(pos));
+            auto p = pieces[size_t(pos)];
+            return p.type == type && p.side == side;
+        }
+        
+        virtual void setEmpty(int pos) override {
+            assert(isPositionValid(pos));
+            pieces[size_t(pos)].setEmpty();
+        }
         
         virtual void setFen(const std::string& fen) override;
         virtual std::string getFen(int halfCount = 0, int fullMoveCount = 1) const override;
         
         bool isLegalMove(int from, int dest, PieceType promotion = PieceType::empty);
         
-        virtual void gen(std::vector<MoveFull>& moveList, Side attackerSide) const;
-        virtual void genLegalOnly(std::vector<MoveFull>& moveList, Side attackerSide);
-        virtual bool isIncheck(Side beingAttackedSide) const;
-        virtual bool beAttacked(int pos, Side attackerSide) const;
-        void genLegal(std::vector<MoveFull>& moves, Side side, int from, int dest, PieceType promotion);
+        MoveFull createFullMove(int from, int dest, PieceType promotion) const {
+            MoveFull move(from, dest, promotion);
+            if (isPositionValid(from)) {
+                move.setPiece(pieces[size_t(from)]);
+            }
+            return move;
+        }
         
-        virtual void make(const MoveFull& move, Hist& hist);
-        virtual void takeBack(const Hist& hist);
+        void gen(MoveList<256>& moveList, Side attackerSide) const;
+        void genLegalOnly(MoveList<256>& moveList, Side attackerSide);
+        bool isIncheck(Side beingAttackedSide) const;
+        bool beAttacked(int pos, Side attackerSide) const;
+        void genLegal(MoveList<256>& moves, Side side, int from, int dest, PieceType promotion);
         
-        virtual void make(const MoveFull& move);
-        virtual void takeBack();
+        void make(const MoveFull& move, Hist& hist);
+        void takeBack(const Hist& hist);
+        
+        void make(const MoveFull& move);
+        void takeBack();
         
         virtual Result rule() override;
         
         bool checkMake(int from, int dest, PieceType promotion);
         
-        std::string toMoveListString(MoveNotation notation, int itemPerLine, bool moveCounter, bool computingInfo) const;
+        // SAN of a played move, created on the first request since UCI-only games never need them
+        const char* getSan(size_t ply);
+        
+        std::string toMoveListString(MoveNotation notation, int itemPerLine, bool moveCounter, bool computingInfo);
         
         Move fromSanString(const std::string&);
         bool fromSanMoveList(const std::string&);
@@ -87,13 +160,29 @@ namespace banksia {
         std::vector<std::string> commentEcoString();
         Result probeSyzygy(int maxPieces, bool& tberror) const;
         
+        // false if the position has too many pieces for the tablebases
+        bool toSyzygyPos(int maxPieces, SyzygyPos& pos) const;
+        // WDL probe when the position allows it (no castling, rule50 zero), root probe otherwise
+        static Result probeSyzygy(const SyzygyPos& pos, bool& tberror);
+        
+        // counts leaf nodes of all legal move sequences, used to verify and measure the move generator
+        u64 perft(int depth);
+        
+        // room for a game of plyCnt moves, kept by newGame thus a reused board does not grow again
+        void reserve(size_t plyCnt);
+        
     private:
         void checkEnpassant();
         
-        virtual void clearCastleRights(int rookPos, Side rookSide);
+        void syncBitboards();
+        void toggleBitboard(int pos, Piece piece) {
+            auto sd = static_cast<int>(piece.side);
+            bbPieces[sd][static_cast<int>(piece.type)] ^= BB(pos);
+            bbOccupied[sd] ^= BB(pos);
+        }
+        
+        void clearCastleRights(int rookPos, Side rookSide);
         int findKing(Side side) const;
-
-        u64 perft(int depth);
         
         virtual u64 initHashKey() const override;
         virtual u64 xorHashKey(int pos) const override;
@@ -102,10 +191,11 @@ namespace banksia {
         int toPieceCount(int* pieceCnt) const;
         
     private:
-        bool createStringForLastMove(const std::vector<MoveFull>& moveList);
+        void createSans(size_t ply);
+        std::string sanString(const Hist& hist);
         
-        void gen_addMove(std::vector<MoveFull>& moveList, int from, int dest, bool capOnly) const;
-        void gen_addPawnMove(std::vector<MoveFull>& moveList, int from, int dest, bool capOnly) const;
+        void gen_addMoves(MoveList<256>& moveList, Piece piece, int from, u64 dests) const;
+        void gen_addPawnMoves(MoveList<256>& moveList, Piece piece, int from, u64 dests) const;
         
     };
     
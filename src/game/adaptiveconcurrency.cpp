@@ -0,0 +1,127 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <iomanip>
+
+#include "adaptiveconcurrency.h"
+
+using namespace banksia;
+
+bool AdaptiveConcurrency::isValid() const
+{
+    return minCnt >= 1 && minCnt <= maxCnt && targetLoad > 0 && interval > 0;
+}
+
+std::string AdaptiveConcurrency::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << "concurrency: " << limit << " (" << minCnt << ".." << maxCnt << ")"
+    << ", load: " << int(lastLoad * 100 + 0.5) << "%"
+    << ", time forfeits: " << lastForfeitCnt << "/" << lastGameCnt;
+    return stringStream.str();
+}
+
+bool AdaptiveConcurrency::load(const Json::Value& obj)
+{
+    mode = obj.isMember("mode") && obj["mode"].asBool();
+    if (obj.isMember("min")) {
+        minCnt = obj["min"].asInt();
+    }
+    if (obj.isMember("max")) {
+        maxCnt = obj["max"].asInt();
+    }
+    if (obj.isMember("interval")) {
+        interval = obj["interval"].asInt();
+    }
+    if (obj.isMember("load")) {
+        targetLoad = obj["load"].asDouble();
+    }
+    if (obj.isMember("forfeit rate")) {
+        maxForfeitRate = obj["forfeit rate"].asDouble();
+    }
+    return isValid();
+}
+
+Json::Value AdaptiveConcurrency::saveToJson() const
+{
+    Json::Value obj;
+    obj["mode"] = mode;
+    obj["min"] = minCnt;
+    obj["max"] = maxCnt;
+    obj["interval"] = interval;
+    obj["load"] = targetLoad;
+    obj["forfeit rate"] = maxForfeitRate;
+    return obj;
+}
+
+void AdaptiveConcurrency::start(int concurrency)
+{
+    limit = std::max(minCnt, std::min(maxCnt, concurrency));
+    getSystemCpuTimes(prevBusyTime, prevTotalTime);
+    gameCnt = forfeitCnt = 0;
+    checkClock = std::chrono::steady_clock::now();
+}
+
+void AdaptiveConcurrency::addGame(bool timeForfeit)
+{
+    gameCnt++;
+    if (timeForfeit) {
+        forfeitCnt++;
+    }
+}
+
+bool AdaptiveConcurrency::update(int playingCnt)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!mode || now - checkClock < std::chrono::seconds(interval)) {
+        return false;
+    }
+    checkClock = now;
+    
+    u64 busyTime, totalTime;
+    if (!getSystemCpuTimes(busyTime, totalTime) || totalTime <= prevTotalTime) {
+        return false;
+    }
+    lastLoad = double(busyTime - prevBusyTime) / double(totalTime - prevTotalTime);
+    prevBusyTime = busyTime; prevTotalTime = totalTime;
+    
+    auto oldLimit = limit;
+    
+    // losing on time is the sign of oversubscribing, even when the load looks fine
+    if (gameCnt > 0 && forfeitCnt > double(gameCnt) * maxForfeitRate) {
+        limit = std::max(minCnt, limit - 1);
+    } else if (lastLoad > std::min(0.98, targetLoad + 0.05)) {
+        limit = std::max(minCnt, limit - 1);
+    } else if (playingCnt >= limit && limit < maxCnt) {
+        // one game more should still fit, measured from the games playing now
+        auto gameLoad = lastLoad / std::max(1, playingCnt);
+        if (lastLoad + gameLoad <= targetLoad) {
+            limit++;
+        }
+    }
+    
+    lastGameCnt = gameCnt; lastForfeitCnt = forfeitCnt;
+    gameCnt = forfeitCnt = 0;
+    return limit != oldLimit;
+}
@@ -0,0 +1,71 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef adaptiveconcurrency_h
+#define adaptiveconcurrency_h
+
+#include <chrono>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // Raises or lowers the number of concurrent games between min and max, from the host load
+    // (engines included) and the time forfeits of the games completed since the last check
+    class AdaptiveConcurrency : public Jsonable
+    {
+    public:
+        virtual const char* className() const override { return "AdaptiveConcurrency"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        virtual bool load(const Json::Value& obj) override;
+        virtual Json::Value saveToJson() const override;
+        
+        void start(int concurrency);
+        
+        void addGame(bool timeForfeit);
+        
+        // called by ticks, returns true when the limit was changed
+        bool update(int playingCnt);
+        
+        int getLimit() const { return limit; }
+        
+    public:
+        bool mode = false;
+        int minCnt = 1, maxCnt = 4, interval = 10; // second
+        double targetLoad = 0.9, maxForfeitRate = 0.05;
+        
+    private:
+        int limit = 1;
+        u64 prevBusyTime = 0, prevTotalTime = 0;
+        int gameCnt = 0, forfeitCnt = 0, lastGameCnt = 0, lastForfeitCnt = 0;
+        double lastLoad = 0;
+        std::chrono::steady_clock::time_point checkClock;
+    };
+    
+} // namespace banksia
+
+#endif /* adaptiveconcurrency_h */
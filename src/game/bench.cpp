@@ -0,0 +1,558 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <fstream>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <cstdlib>
+
+#ifdef _WIN32
+
+#define NOMINMAX
+
+#include <windows.h>
+#include <psapi.h>
+
+#else
+
+#include <sys/resource.h>
+
+#endif
+
+#include "bench.h"
+#include "uciengine.h"
+#include "tourmng.h"
+#include "../base/metrics.h"
+
+using namespace banksia;
+
+bool Bench::run(const std::string& name, const std::string& path)
+{
+    if (name == "uci") {
+        return uciParser(path);
+    }
+    if (name == "perft") {
+        return perftSuite();
+    }
+    if (name == "mailbox") {
+        return mailbox();
+    }
+    
+    std::cerr << "Error: unknown benchmark " << name << std::endl;
+    return false;
+}
+
+// Moves are pushed by the test as a reader thread would, the clock runs from its go
+class MailboxPlayer : public Player
+{
+public:
+    MailboxPlayer(const std::string& name) : Player(name, PlayerType::engine) {}
+    
+    virtual bool kickStart() override { return true; }
+    virtual bool stopThinking() override { return true; }
+    virtual bool quit() override { return true; }
+    virtual bool kill() override { return true; }
+    virtual bool isSafeToDeattach() const override { return true; }
+    virtual void prepareToDeattach() override {}
+    virtual void tickWork() override {}
+    
+    virtual bool goPonder(const Move&) override { return true; }
+    virtual bool go() override {
+        Player::go();
+        goClock = std::chrono::steady_clock::now();
+        timeController->startEngineClock(goClock);
+        return true;
+    }
+    
+    void sendMove(const Move& move, double timeConsumed) {
+        moveReceiver(move, move.toCoordinateString(), Move::illegalMove, timeConsumed, EngineComputingState::thinking);
+    }
+    
+    std::chrono::steady_clock::time_point goClock;
+};
+
+static std::string createUciStream()
+{
+    const char* pv = " pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 f1e1 b7b5 a4b3 d7d6 c2c3 e8g8";
+    
+    std::ostringstream stringStream;
+    i64 nodes = 1000;
+    for(int depth = 1; depth <= 40; depth++) {
+        for(int multipv = 1; multipv <= 8; multipv++) {
+            nodes += nodes / 7 + 1;
+            stringStream << "info depth " << depth << " seldepth " << depth + 11
+            << " multipv " << multipv << " score cp " << 35 - multipv * 4
+            << " nodes " << nodes << " nps " << 2345678 << " hashfull " << depth * 20
+            << " tbhits " << 0 << " time " << nodes / 2345 << pv << "\n";
+        }
+        stringStream << "info depth " << depth << " currmove e2e4 currmovenumber 1\n";
+    }
+    return stringStream.str();
+}
+
+bool Bench::uciParser(const std::string& path)
+{
+    std::string data;
+    if (path.empty()) {
+        data = createUciStream();
+    } else {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open()) {
+            std::cerr << "Error: cannot open " << path << std::endl;
+            return false;
+        }
+        // bestmove needs a real search, keep other lines only
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (line.find("bestmove") != 0) {
+                data += line + "\n";
+            }
+        }
+    }
+    
+    if (data.empty()) {
+        return false;
+    }
+    
+    ChessBoard board;
+    board.newGame();
+    GameTimeController timeController;
+    
+    UciEngine engine;
+    engine.attach(&board, &timeController, [](const Move&, const std::string&, const Move&, double, EngineComputingState) {}, nullptr);
+    
+    auto lineCnt = std::count(data.begin(), data.end(), '\n');
+    
+    // pipes deliver the output in chunks, lines split between them
+    const size_t chunkSize = 4096;
+    const int loops = std::max(1, int(200 * 1024 * 1024 / data.size()));
+    
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < loops; i++) {
+        for(size_t k = 0; k < data.size(); k += chunkSize) {
+            engine.computingState = EngineComputingState::thinking;
+            engine.read_stdout(data.c_str() + k, std::min(chunkSize, data.size() - k));
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    elapsed = std::max(elapsed, 0.000001);
+    
+    auto totalLines = double(lineCnt) * loops;
+    auto totalBytes = double(data.size()) * loops;
+    std::cout << std::fixed << std::setprecision(2)
+    << "uci parser, lines: " << i64(totalLines)
+    << ", elapsed: " << elapsed << "s"
+    << ", lines/s: " << totalLines / elapsed
+    << ", MB/s: " << totalBytes / (elapsed * 1024 * 1024)
+    << ", ns/line: " << elapsed * 1e9 / totalLines
+    << std::endl;
+    return true;
+}
+
+bool Bench::perft(const std::string& fen, int depth, bool divide)
+{
+    if (depth < 0) {
+        std::cerr << "Error: perft depth must not be negative" << std::endl;
+        return false;
+    }
+    
+    ChessBoard board;
+    board.setFen(fen);
+    if (!board.isValid()) {
+        std::cerr << "Error: invalid fen " << fen << std::endl;
+        return false;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    u64 nodes = 0;
+    if (divide && depth > 0) {
+        MoveList<256> moveList;
+        board.genLegalOnly(moveList, board.side);
+        for(auto && move : moveList) {
+            board.make(move);
+            auto cnt = board.perft(depth - 1);
+            board.takeBack();
+            nodes += cnt;
+            std::cout << move.toCoordinateString() << ": " << cnt << std::endl;
+        }
+        std::cout << "moves: " << moveList.size() << std::endl;
+    } else {
+        nodes = board.perft(depth);
+    }
+    
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    elapsed = std::max(elapsed, 0.000001);
+    
+    std::cout << std::fixed << std::setprecision(2)
+    << "perft " << depth << ", nodes: " << nodes
+    << ", elapsed: " << elapsed << "s"
+    << ", Mnps: " << double(nodes) / (elapsed * 1000000)
+    << std::endl;
+    return true;
+}
+
+bool Bench::perftSuite()
+{
+    static const struct {
+        const char* name;
+        const char* fen;
+        int depth;
+        u64 nodes;
+    } positions[] = {
+        { "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609ULL },
+        { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603ULL },
+        { "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624ULL },
+        { "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333ULL },
+        { "promotions mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 4, 422333ULL },
+        { "underpromotions", "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1", 5, 3605103ULL },
+        { "discovered check", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487ULL },
+        { "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594ULL },
+        { "en passant pinned", "8/5bk1/8/2Pp4/8/1K6/8/8 w - d6 0 1", 6, 824064ULL },
+        { "en passant check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467ULL },
+        { "en passant discovered", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888ULL },
+        { "castling through check", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206ULL },
+        { "castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476ULL },
+    };
+    
+    auto ok = true;
+    u64 totalNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    
+    for(auto && p : positions) {
+        ChessBoard board;
+        board.setFen(p.fen);
+        
+        auto t = std::chrono::steady_clock::now();
+        auto nodes = board.perft(p.depth);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+        elapsed = std::max(elapsed, 0.000001);
+        totalNodes += nodes;
+        
+        auto matched = nodes == p.nodes;
+        ok = ok && matched;
+        std::cout << std::fixed << std::setprecision(2)
+        << (matched ? "ok     " : "FAILED ") << p.name
+        << ", depth: " << p.depth << ", nodes: " << nodes;
+        if (!matched) {
+            std::cout << " (expected " << p.nodes << ")";
+        }
+        std::cout << ", elapsed: " << elapsed << "s"
+        << ", Mnps: " << double(nodes) / (elapsed * 1000000)
+        << std::endl;
+    }
+    
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    elapsed = std::max(elapsed, 0.000001);
+    std::cout << std::fixed << std::setprecision(2)
+    << "perft total, nodes: " << totalNodes
+    << ", elapsed: " << elapsed << "s"
+    << ", Mnps: " << double(totalNodes) / (elapsed * 1000000)
+    << (ok ? "" : ", some positions FAILED")
+    << std::endl;
+    return ok;
+}
+
+/////////////////////////////////////////
+// position startpos|fen FEN [moves M1 M2 ...]
+static void setupPosition(ChessBoard& board, const std::string& line)
+{
+    auto movesPos = line.find(" moves ");
+    auto fenPos = line.find(" fen ");
+    
+    std::string fen;
+    if (fenPos != std::string::npos) {
+        fen = line.substr(fenPos + 5, movesPos == std::string::npos ? std::string::npos : movesPos - fenPos - 5);
+    }
+    board.newGame(fen);
+    
+    if (movesPos == std::string::npos) {
+        return;
+    }
+    
+    std::istringstream is(line.substr(movesPos + 7));
+    std::string str;
+    while (is >> str) {
+        auto move = ChessBoard::moveFromCoordiateString(str);
+        if (!board.checkMake(move.from, move.dest, move.promotion)) {
+            break;
+        }
+    }
+}
+
+bool Bench::mockEngine(int infoLineCnt)
+{
+    std::ios::sync_with_stdio(false);
+    
+    std::mt19937 rng(std::random_device{}());
+    ChessBoard board;
+    board.newGame();
+    
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        trim(line);
+        auto cmd = line.substr(0, line.find(' '));
+        
+        if (cmd == "uci") {
+            std::cout << "id name Banksia mock\n"
+            << "id author Banksia\n"
+            << "option name Hash type spin default 16 min 1 max 65536\n"
+            << "option name Threads type spin default 1 min 1 max 512\n"
+            << "uciok" << std::endl;
+        } else if (cmd == "isready") {
+            std::cout << "readyok" << std::endl;
+        } else if (cmd == "position") {
+            setupPosition(board, line);
+        } else if (cmd == "go") {
+            MoveList<256> moveList;
+            board.genLegalOnly(moveList, board.side);
+            if (moveList.empty()) {
+                std::cout << "bestmove 0000" << std::endl;
+                continue;
+            }
+            
+            auto move = moveList[size_t(rng()) % moveList.size()].toCoordinateString();
+            
+            // one write for the whole answer, as engines flush it at the end of a search
+            std::ostringstream stringStream;
+            i64 nodes = 0;
+            for(int depth = 1; depth <= infoLineCnt; depth++) {
+                nodes += depth * 1000;
+                stringStream << "info depth " << depth << " seldepth " << depth + 4
+                << " multipv 1 score cp " << int(rng() % 61) - 30
+                << " nodes " << nodes << " nps 1000000 hashfull 0 tbhits 0 time " << nodes / 1000
+                << " pv " << move << "\n";
+            }
+            stringStream << "bestmove " << move << "\n";
+            std::cout << stringStream.str() << std::flush;
+        } else if (cmd == "quit") {
+            break;
+        }
+    }
+    return true;
+}
+
+// cpu (user and system) of the manager itself, engines are not counted
+static double processCpuTime()
+{
+#ifdef _WIN32
+    FILETIME ftCreation, ftExit, ftKernel, ftUser;
+    if (!GetProcessTimes(GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser)) {
+        return 0;
+    }
+    auto toInt = [](const FILETIME& ft) { return (u64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+    return double(toInt(ftKernel) + toInt(ftUser)) / 1e7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// bytes
+static i64 peakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? i64(pmc.PeakWorkingSetSize) : 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return i64(usage.ru_maxrss);
+#else
+    return i64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static std::string tempFolder()
+{
+#ifdef _WIN32
+    auto s = std::getenv("TEMP");
+    std::string folder = s ? s : ".";
+    return folder + "\\";
+#else
+    auto s = std::getenv("TMPDIR");
+    std::string folder = s && *s ? s : "/tmp";
+    if (folder.back() != '/') {
+        folder += "/";
+    }
+    return folder;
+#endif
+}
+
+bool Bench::loadTest(const std::string& exePath, int gameCnt, int concurrency, int infoLineCnt)
+{
+    gameCnt = std::max(1, gameCnt);
+    concurrency = std::max(1, concurrency);
+    infoLineCnt = std::max(0, infoLineCnt);
+    
+    auto folder = tempFolder();
+    auto enginesPath = folder + "banksia-load-engines.json";
+    auto tourPath = folder + "banksia-load-tour.json";
+    
+    // the mock engines are this app, the command runs by the shell
+    auto command = exePath.find(' ') == std::string::npos ? exePath : "\"" + exePath + "\"";
+    command += " -mockengine " + std::to_string(infoLineCnt);
+    
+    Json::Value engines;
+    for(int i = 1; i <= 2; i++) {
+        Json::Value app;
+        app["name"] = "mock" + std::to_string(i);
+        app["protocol"] = "uci";
+        app["command"] = command;
+        app["working folder"] = ".";
+        Json::Value obj;
+        obj["app"] = app;
+        obj["options"] = Json::arrayValue;
+        engines.append(obj);
+    }
+    
+    Json::Value d;
+    d["base"]["type"] = "roundrobin";
+    d["base"]["event"] = "Load test";
+    d["base"]["games per pair"] = gameCnt;
+    d["base"]["concurrency"] = concurrency;
+    d["base"]["resumable"] = false;
+    d["engine configurations"]["path"] = enginesPath;
+    // the mock needs a while to set up its move generator, processes are kept between games
+    d["engine configurations"]["max reuse"] = gameCnt;
+    d["players"].append("mock1");
+    d["players"].append("mock2");
+    d["time control"]["mode"] = "standard";
+    d["time control"]["time"] = 60;
+    d["time control"]["increment"] = 0;
+    d["time control"]["moves"] = 0;
+    d["time control"]["margin"] = 0.8;
+    d["game adjudication"]["mode"] = true;
+    d["game adjudication"]["draw if game length over"] = 160;
+    d["game adjudication"]["tablebase"] = false;
+    d["logs"]["pgn"]["mode"] = false;
+    d["logs"]["result"]["mode"] = false;
+    d["logs"]["engine"]["mode"] = false;
+    
+    if (!JsonSavable::saveToJsonFile(enginesPath, engines) || !JsonSavable::saveToJsonFile(tourPath, d)) {
+        std::cerr << "Error: cannot write files of the load test in " << folder << std::endl;
+        return false;
+    }
+    
+    std::cout << "load test, games: " << gameCnt << ", concurrency: " << concurrency
+    << ", info lines per move: " << infoLineCnt << ", engine: " << command << std::endl;
+    
+    // per game lines would be most of the work
+    banksiaVerbose = false;
+    
+    auto startClock = std::chrono::steady_clock::now();
+    auto startCpu = processCpuTime();
+    
+    TourMng tourMng;
+    tourMng.setFinishedCallback([=]() {
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startClock).count();
+        elapsed = std::max(elapsed, 0.000001);
+        auto cpu = processCpuTime() - startCpu;
+        auto games = Metrics::getCount(MetricCount::gamesStarted);
+        auto moves = Metrics::getCount(MetricHist::checkMake);
+        
+        std::cout << std::fixed << std::setprecision(2)
+        << "load test, games: " << games << ", moves: " << moves
+        << ", elapsed: " << elapsed << "s"
+        << ", games/s: " << double(games) / elapsed
+        << ", moves/s: " << double(moves) / elapsed
+        << ", manager cpu: " << cpu << "s"
+        << ", cpu/move: " << cpu * 1e6 / double(std::max<i64>(1, moves)) << "us"
+        << ", peak rss: " << peakMemory() / (1024 * 1024) << " MB"
+        << std::endl;
+        
+        std::remove(enginesPath.c_str());
+        std::remove(tourPath.c_str());
+    });
+    
+    if (!tourMng.start(tourPath, false, true)) {
+        return false;
+    }
+    
+    // the app exits with the report when all games completed
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    return true;
+}
+
+// The move lands right at the deadline while the manager keeps updating the game, thus
+// some of them come between its drain of the mailbox and its clock check. Rounds whose
+// reader was scheduled too late to push before the deadline are not counted
+bool Bench::mailbox()
+{
+    const int rounds = 200;
+    const double moveTime = 0.02;
+    
+    auto lostCnt = 0, lateCnt = 0;
+    for(int i = 0; i < rounds; i++) {
+        MailboxPlayer white("white"), black("black");
+        TimeController timeController;
+        timeController.setup(TimeControlMode::standard, 0, moveTime, 0, 0);
+        GameConfig gameConfig;
+        gameConfig.adjudicationMode = false;
+        
+        Game game;
+        game.reset(gameConfig);
+        game.setMessageLogger([](const std::string&, const std::string&, LogType) {});
+        game.set(&white, &black, timeController);
+        game.newGame();
+        game.setState(GameState::playing);
+        game.startThinking();
+        
+        auto move = game.board.moveFromCoordiateString("e2e4");
+        auto deadline = white.goClock + std::chrono::duration<double>(moveTime);
+        auto late = false;
+        std::thread reader([&]() {
+            std::this_thread::sleep_until(deadline - std::chrono::milliseconds(2));
+            while (std::chrono::steady_clock::now() < deadline - std::chrono::microseconds(20)) {}
+            white.sendMove(move, moveTime - 0.001);
+            late = std::chrono::steady_clock::now() >= deadline;
+        });
+        
+        while (game.getState() == GameState::playing && game.board.side == Side::white) {
+            game.update();
+        }
+        reader.join();
+        
+        if (late) {
+            lateCnt++;
+        } else if (game.getState() != GameState::playing) {
+            lostCnt++;
+        }
+    }
+    
+    std::cout << "mailbox: " << rounds - lateCnt << " moves pushed just before the deadline, lost on time: " << lostCnt << std::endl;
+    return lostCnt == 0;
+}
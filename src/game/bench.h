@@ -0,0 +1,65 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef bench_h
+#define bench_h
+
+#include <stdio.h>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // Simple benchmarks, called from the command line
+    class Bench
+    {
+    public:
+        static bool run(const std::string& name, const std::string& path);
+        
+        // perft of a given position, divide lists node counts for each root move
+        static bool perft(const std::string& fen, int depth, bool divide);
+        
+        // a UCI engine answering at once, a burst of info lines before a random legal move
+        static bool mockEngine(int infoLineCnt);
+        
+        // the overhead of the manager itself: games between mock engines (exePath -mockengine),
+        // the app exits with the report when all are completed
+        static bool loadTest(const std::string& exePath, int gameCnt, int concurrency, int infoLineCnt);
+        
+    private:
+        // feeds a recorded (or a generated Stockfish-like) engine output to UciEngine
+        static bool uciParser(const std::string& path);
+        
+        // perft over a set of positions with known node counts
+        static bool perftSuite();
+        
+        // moves read in time but still in a game's mailbox at the deadline must not lose on time
+        static bool mailbox();
+    };
+    
+} // namespace banksia
+
+
+#endif /* bench_h */
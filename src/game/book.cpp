@@ -25,6 +25,8 @@
 
 #include <sstream>
 #include <fstream>
+#include <thread>
+#include <ctime>
 
 #include "book.h"
 
@@ -33,15 +35,104 @@ using namespace banksia;
 void BookEdp::load(const std::string& _path, int _maxPly, int _top100)
 {
     path = _path; maxPly = _maxPly; top100 = _top100;
-    stringVec = readTextFileToArray(path);
+    
+    lineOffsets.clear();
+    offsets = nullptr;
+    lineCnt = 0;
+    
+    if (!file.open(path)) {
+        std::cerr << "Error: cannot load book " << path << std::endl;
+        return;
+    }
+    
+    auto epdSize = file.size(), epdTime = getFileTime(path);
+    auto indexPath = path + ".index";
+    if (useCache && loadIndex(indexPath, epdSize, epdTime)) {
+        return;
+    }
+    
+    // offsets of non-empty lines
+    auto data = file.data(), end = data + epdSize;
+    for(auto p = data; p < end; ) {
+        auto q = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+        if (!q) q = end;
+        
+        for(auto c = p; c < q; c++) {
+            if (!isspace(*c)) {
+                lineOffsets.push_back(u64(p - data));
+                break;
+            }
+        }
+        p = q + 1;
+    }
+    
+    offsets = lineOffsets.data();
+    lineCnt = lineOffsets.size();
+    
+    if (useCache && lineCnt > 0 && !saveIndex(indexPath, epdSize, epdTime)) {
+        std::cerr << "Warning: cannot save book index " << indexPath << std::endl;
+    }
 }
 
-std::string BookEdp::getRandomFEN() const
+// The index is in native byte order: magic, epd size, epd time, line count then the offsets
+static const char epdIndexMagic[8] = { 'B', 'K', 'S', 'E', 'P', 'D', '0', '1' };
+static const i64 epdIndexHeaderSize = 32;
+
+bool BookEdp::loadIndex(const std::string& indexPath, i64 epdSize, i64 epdTime)
 {
-    if (!stringVec.empty()) {
+    if (!indexFile.open(indexPath) || indexFile.size() < epdIndexHeaderSize) {
+        indexFile.close();
+        return false;
+    }
+    
+    i64 header[3];
+    memcpy(header, indexFile.data() + 8, sizeof(header));
+    auto cnt = u64(header[2]);
+    if (memcmp(indexFile.data(), epdIndexMagic, sizeof(epdIndexMagic)) != 0
+        || header[0] != epdSize || header[1] != epdTime || cnt == 0
+        || indexFile.size() != epdIndexHeaderSize + i64(cnt * sizeof(u64))) {
+        indexFile.close();
+        return false;
+    }
+    
+    offsets = reinterpret_cast<const u64*>(indexFile.data() + epdIndexHeaderSize);
+    lineCnt = size_t(cnt);
+    return true;
+}
+
+bool BookEdp::saveIndex(const std::string& indexPath, i64 epdSize, i64 epdTime) const
+{
+    std::ofstream ofs(indexPath, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        return false;
+    }
+    
+    i64 header[3] = { epdSize, epdTime, i64(lineCnt) };
+    ofs.write(epdIndexMagic, sizeof(epdIndexMagic));
+    ofs.write((const char*)header, sizeof(header));
+    ofs.write((const char*)offsets, std::streamsize(lineCnt * sizeof(u64)));
+    return bool(ofs);
+}
+
+std::string BookEdp::lineAt(size_t idx) const
+{
+    auto data = file.data(), end = data + file.size();
+    auto p = data + offsets[idx];
+    if (p >= end) {
+        return "";
+    }
+    auto q = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+    std::string str(p, q ? q : end);
+    trim(str);
+    return str;
+}
+
+std::string BookEdp::getRandomFEN(std::mt19937& rng) const
+{
+    if (lineCnt > 0) {
         for(int atemp = 0; atemp < 5; atemp++) {
-            size_t k = size_t(std::rand()) % stringVec.size();
-            auto str = stringVec.at(k);
+            size_t k = size_t(rng()) % lineCnt;
+            auto str = lineAt(k);
             if (!str.empty()) {
                 ChessBoard board;
                 board.setFen(str);
@@ -59,29 +150,29 @@ std::string BookEdp::getRandomFEN() const
 
 bool BookEdp::isEmpty() const
 {
-    return stringVec.empty();
+    return lineCnt == 0;
 }
 
 size_t BookEdp::size() const
 {
-    return stringVec.size();
+    return lineCnt;
 }
 
-bool BookEdp::getRandomBook(std::string& fenString, std::vector<Move>&) const
+bool BookEdp::getRandomBook(std::mt19937& rng, std::string& fenString, std::vector<Move>&) const
 {
-    fenString = getRandomFEN();
+    fenString = getRandomFEN(rng);
     return !fenString.empty();
 }
 
 /////////////////////////////////
 bool BookPgn::isEmpty() const
 {
-    return moves.empty();
+    return size() == 0;
 }
 
 size_t BookPgn::size() const
 {
-    return moves.size();
+    return lineOffsets.empty() ? 0 : lineOffsets.size() - 1;
 }
 
 std::vector<Move> BookPgn::moveString2Moves(const std::string& str)
@@ -91,7 +182,7 @@ std::vector<Move> BookPgn::moveString2Moves(const std::string& str)
         ChessBoard board;
         board.newGame();
         if (board.fromSanMoveList(str) && !board.histList.empty()) {
-            for(auto hist : board.histList) {
+            for(auto && hist : board.histList) {
                 Move m = hist.move;
                 list.push_back(m);
             }
@@ -100,48 +191,222 @@ std::vector<Move> BookPgn::moveString2Moves(const std::string& str)
     return list;
 }
 
-bool BookPgn::addPgnMoves(const std::string& str)
+void BookPgn::load(const std::string& _path, int _maxPly, int _top100)
 {
-    if (!str.empty()) {
-        auto list = moveString2Moves(str);
-        if (!list.empty()) {
-            moves.push_back(list);
-            return true;
-        }
+    path = _path; maxPly = _maxPly; top100 = _top100;
+    
+    moveArena.clear();
+    lineOffsets.clear();
+    
+    auto pgnSize = getFileSize(path), pgnTime = getFileTime(path);
+    auto cachePath = path + ".cache";
+    if (useCache && loadCache(cachePath, pgnSize, pgnTime)) {
+        return;
+    }
+    
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Error: cannot load book " << path << std::endl;
+        return;
+    }
+    
+    parse(file.data(), file.data() + file.size());
+    
+    if (useCache && !isEmpty() && !saveCache(cachePath, pgnSize, pgnTime)) {
+        std::cerr << "Warning: cannot save book cache " << cachePath << std::endl;
     }
-    return false;
 }
 
-void BookPgn::load(const std::string& _path, int _maxPly, int _top100)
+// Streams the whole file once, tags are skipped, moves are made and stored
+// on the fly and the rest of a game is skipped when reaching maxPly
+void BookPgn::parse(const char* p, const char* end)
 {
-    path = _path; maxPly = _maxPly; top100 = _top100;
+    ChessBoard board;
+    board.newGame();
+    skipLine = badLine = false;
+    lineOffsets.push_back(0);
     
-    moves.clear();
-    auto vec = readTextFileToArray(path);
-    
-    std::string moveText;
-    for(auto && s : vec) {
-        if (s.find("[") != std::string::npos) {
-            if (s.find("[Event") != std::string::npos) {
-                addPgnMoves(moveText);
-                moveText = "";
-                continue;
+    auto commentDepth = 0, variationDepth = 0;
+    auto lineBegin = true;
+    
+    while (p < end) {
+        auto ch = *p;
+        
+        if (ch == '\n') {
+            lineBegin = true;
+            p++;
+            continue;
+        }
+        
+        // comments and variations may span over lines
+        if (commentDepth) {
+            if (ch == '}') commentDepth = 0;
+            p++;
+            continue;
+        }
+        
+        if (lineBegin && ch == '[' && !variationDepth) {
+            if (end - p > 6 && memcmp(p, "[Event", 6) == 0) {
+                endLine(board);
             }
+            // skip tag
+            for(; p < end && *p != '\n'; p++) {}
             continue;
         }
-        moveText += " " + s;
+        lineBegin = false;
+        
+        switch (ch) {
+            case '{':
+                commentDepth = 1;
+                p++;
+                continue;
+            case ';':
+            case '%':
+                for(; p < end && *p != '\n'; p++) {}
+                continue;
+            case '(':
+                variationDepth++;
+                p++;
+                continue;
+            case ')':
+                if (variationDepth) variationDepth--;
+                p++;
+                continue;
+            case ' ': case '\t': case '\r': case '.':
+                p++;
+                continue;
+            default:
+                break;
+        }
+        
+        auto token = p;
+        for(; p < end; p++) {
+            ch = *p;
+            if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '.'
+                || ch == '{' || ch == '(' || ch == ')' || ch == ';') {
+                break;
+            }
+        }
+        
+        if (!variationDepth && !skipLine) {
+            parseToken(board, token, size_t(p - token));
+        }
     }
-    addPgnMoves(moveText);
+    
+    endLine(board);
 }
 
+bool BookPgn::parseToken(ChessBoard& board, const char* token, size_t len)
+{
+    // move counters, results and NAGs
+    if (len < 2 || isdigit(*token) || *token == '$' || *token == '*') {
+        return false;
+    }
+    
+    // annotations such as ! ?!
+    for(; len > 0 && (token[len - 1] == '!' || token[len - 1] == '?'); len--) {}
+    
+    sanString.assign(token, len);
+    auto move = board.fromSanString(sanString);
+    if (!board.isLegalMove(move.from, move.dest, move.promotion)
+        || board.getPiece(move.from).side != board.side) {
+        skipLine = badLine = true;
+        return false;
+    }
+    
+    board.make(board.createFullMove(move.from, move.dest, move.promotion));
+    moveArena.push_back(InfoRecord::packMove(move.from, move.dest, move.promotion));
+    
+    if (maxPly > 0 && int(board.histList.size()) >= maxPly) {
+        skipLine = true;
+    }
+    return true;
+}
+
+void BookPgn::endLine(ChessBoard& board)
+{
+    auto lineStart = lineOffsets.back();
+    if (badLine || moveArena.size() == lineStart) {
+        moveArena.resize(lineStart);
+    } else {
+        lineOffsets.push_back(u32(moveArena.size()));
+    }
+    
+    skipLine = badLine = false;
+    board.newGame();
+}
+
+// The cache is in native byte order, it is rebuilt when the pgn file or maxPly changes
+static const char pgnCacheMagic[8] = { 'B', 'K', 'S', 'P', 'G', 'N', '0', '1' };
+
+bool BookPgn::loadCache(const std::string& cachePath, i64 pgnSize, i64 pgnTime)
+{
+    std::ifstream ifs(cachePath, std::ios::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+    
+    char magic[8];
+    i64 size, time;
+    i32 ply;
+    u64 lineCnt, moveCnt;
+    ifs.read(magic, sizeof(magic));
+    ifs.read((char*)&size, sizeof(size));
+    ifs.read((char*)&time, sizeof(time));
+    ifs.read((char*)&ply, sizeof(ply));
+    ifs.read((char*)&lineCnt, sizeof(lineCnt));
+    ifs.read((char*)&moveCnt, sizeof(moveCnt));
+    
+    if (!ifs || memcmp(magic, pgnCacheMagic, sizeof(magic)) != 0
+        || size != pgnSize || time != pgnTime || ply != maxPly
+        || lineCnt == 0 || moveCnt > 0xffffffffULL) {
+        return false;
+    }
+    
+    lineOffsets.resize(size_t(lineCnt));
+    moveArena.resize(size_t(moveCnt));
+    ifs.read((char*)lineOffsets.data(), std::streamsize(lineCnt * sizeof(u32)));
+    ifs.read((char*)moveArena.data(), std::streamsize(moveCnt * sizeof(u16)));
+    
+    if (!ifs || lineOffsets.front() != 0 || lineOffsets.back() != moveCnt) {
+        moveArena.clear();
+        lineOffsets.clear();
+        return false;
+    }
+    return true;
+}
 
-bool BookPgn::getRandomBook(std::string&, std::vector<Move>& moveList) const
+bool BookPgn::saveCache(const std::string& cachePath, i64 pgnSize, i64 pgnTime) const
 {
-    if (moves.empty()) {
+    std::ofstream ofs(cachePath, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
         return false;
     }
-    size_t k = size_t(std::rand()) % moves.size();
-    moveList = moves.at(k);
+    
+    i32 ply = maxPly;
+    u64 lineCnt = lineOffsets.size(), moveCnt = moveArena.size();
+    ofs.write(pgnCacheMagic, sizeof(pgnCacheMagic));
+    ofs.write((const char*)&pgnSize, sizeof(pgnSize));
+    ofs.write((const char*)&pgnTime, sizeof(pgnTime));
+    ofs.write((const char*)&ply, sizeof(ply));
+    ofs.write((const char*)&lineCnt, sizeof(lineCnt));
+    ofs.write((const char*)&moveCnt, sizeof(moveCnt));
+    ofs.write((const char*)lineOffsets.data(), std::streamsize(lineCnt * sizeof(u32)));
+    ofs.write((const char*)moveArena.data(), std::streamsize(moveCnt * sizeof(u16)));
+    return bool(ofs);
+}
+
+bool BookPgn::getRandomBook(std::mt19937& rng, std::string&, std::vector<Move>& moveList) const
+{
+    if (isEmpty()) {
+        return false;
+    }
+    size_t k = size_t(rng()) % size();
+    
+    moveList.clear();
+    for(auto i = lineOffsets[k]; i < lineOffsets[k + 1]; i++) {
+        moveList.push_back(InfoRecord::unpackMove(moveArena[i]));
+    }
     return !moveList.empty();
 }
 
@@ -185,10 +450,8 @@ std::string BookPolyglotItem::toString() const
 
 BookPolyglot::~BookPolyglot()
 {
-    if (items) {
-        delete items;
-        items = nullptr;
-    }
+    items = nullptr;
+    file.close();
 }
 
 bool BookPolyglot::isEmpty() const
@@ -205,42 +468,49 @@ void BookPolyglot::load(const std::string& _path, int _maxPly, int _top100)
 {
     path = _path; maxPly = _maxPly; top100 = _top100;
     
-    std::ifstream ifs(path, std::ios::binary| std::ios::ate);
-    
-    i64 length = 0;
-    if (ifs.is_open()) {
-        length = std::max<i64>(0, static_cast<i64>(ifs.tellg()));
-    }
+    items = nullptr;
+    itemCnt = 0;
     
+    // mapped, not read, pages are loaded on demand and shared with other processes using the same book
     assert(sizeof(BookPolyglotItem) == 16);
-    itemCnt = length / static_cast<i64>(sizeof(BookPolyglotItem));
+    if (file.open(path)) {
+        itemCnt = file.size() / static_cast<i64>(sizeof(BookPolyglotItem));
+    }
     
     if (itemCnt == 0) {
         std::cerr << "Error: cannot load book " << path << std::endl;
+        file.close();
         return;
     }
     
-    items = (BookPolyglotItem *) malloc(itemCnt * static_cast<i64>(sizeof(BookPolyglotItem)) + 64);
-    ifs.seekg(0, std::ios::beg);
-    ifs.read((char*)items, length);
-    
-    for(i64 i = 0; i < itemCnt; i++) {
-        items[i].convertToLittleEndian();
+    items = reinterpret_cast<const BookPolyglotItem*>(file.data());
+}
+
+u64 BookPolyglot::keyAt(i64 idx) const
+{
+    auto p = reinterpret_cast<const u8*>(&items[idx].key);
+    u64 key = 0;
+    for(int i = 0; i < 8; i++) {
+        key = key << 8 | p[i];
     }
+    return key;
 }
 
+// The whole book is not scanned since it may be huge, keys are checked at some samples only
 bool BookPolyglot::isValid() const
 {
     if (items == nullptr) {
         return false;
     }
     
+    const i64 sampleCnt = 64;
     u64 preKey = 0;
-    for(i64 i = 0; i < itemCnt; i++) {
-        if (preKey > items[i].key) {
+    for(i64 i = 0; i < sampleCnt; i++) {
+        auto key = keyAt(itemCnt * i / sampleCnt);
+        if (preKey > key) {
             return false;
         }
-        preKey = items[i].key;
+        preKey = key;
     }
     
     return true;
@@ -252,11 +522,12 @@ i64 BookPolyglot::binarySearch(u64 key) const
     
     while (first <= last) {
         auto middle = (first + last) / 2;
-        if (items[middle].key == key) {
+        auto middleKey = keyAt(middle);
+        if (middleKey == key) {
             return middle;
         }
         
-        if (items[middle].key > key)  {
+        if (middleKey > key)  {
             last = middle - 1;
         }
         else {
@@ -272,17 +543,19 @@ std::vector<BookPolyglotItem> BookPolyglot::search(u64 key) const
     
     auto k = binarySearch(key);
     if (k >= 0) {
-        for(; k > 0 && items[k - 1].key == key; k--) {}
+        for(; k > 0 && keyAt(k - 1) == key; k--) {}
         
-        for(; k < i64(itemCnt) && items[k].key == key; k++) {
-            vec.push_back(items[k]);
+        for(; k < i64(itemCnt) && keyAt(k) == key; k++) {
+            auto item = items[k];
+            item.convertToLittleEndian();
+            vec.push_back(item);
         }
     }
     
     return vec;
 }
 
-bool BookPolyglot::getRandomBook(std::string&, std::vector<Move>& moveList) const
+bool BookPolyglot::getRandomBook(std::mt19937& rng, std::string&, std::vector<Move>& moveList) const
 {
     ChessBoard board;
     board.newGame();
@@ -293,7 +566,7 @@ bool BookPolyglot::getRandomBook(std::string&, std::vector<Move>& moveList) cons
         
         auto k = int(vec.size()) * top100 / 100;
         assert(k >= 0 && k <= int(vec.size()));
-        auto idx = k == 0 ? 0 : (std::rand() % k);
+        auto idx = k == 0 ? 0 : int(rng() % u32(k));
         
         auto move = vec[size_t(idx)].getMove();
         if (!board.checkMake(move.from, move.dest, move.promotion)) break;
@@ -348,19 +621,15 @@ std::string BookMng::bookSelectType2String(BookSelectType type)
 }
 
 
-BookMng* BookMng::instance = nullptr;
+std::map<std::string, std::weak_ptr<Book>> BookMng::loadedBookMap;
+std::mutex BookMng::loadedBookMutex;
 
 BookMng::BookMng()
 {
-    instance = this;
 }
 
 BookMng::~BookMng()
 {
-    for(auto && book : bookList) {
-        delete book;
-    }
-    
     bookList.clear();
 }
 
@@ -431,6 +700,9 @@ bool BookMng::load(const Json::Value& obj)
         }
     }
     
+    baseSeed = seed >= 0 ? u32(seed) : std::random_device{}();
+    std::srand(seed >= 0 ? seed : static_cast<unsigned int>(std::time(nullptr)));
+    
     s = "books";
     if (obj.isMember(s) && obj[s].isArray()) {
         auto array = obj[s];
@@ -462,33 +734,49 @@ bool BookMng::loadSingle(const Json::Value& obj)
     auto typeStr = obj["type"].asString();
     auto type = string2BookType(typeStr);
     
-    auto maxPly = obj.isMember("maxply") ? obj["maxply"].asInt() : PologlotDefaultMaxPly;
+    // pgn lines are used in full when maxply is missing
+    auto maxPly = obj.isMember("maxply") ? obj["maxply"].asInt() : (type == BookType::pgn ? 0 : PologlotDefaultMaxPly);
     auto top100 = obj.isMember("top100") ? obj["top100"].asInt() : 0;
     
+    auto cache = obj.isMember("cache") && obj["cache"].asBool();
+    
     if (type == BookType::none) {
         std::cerr << "Error: does not support yet book type " << typeStr << std::endl;
     } else {
-        Book* book;
+        std::ostringstream keyStream;
+        keyStream << typeStr << "|" << maxPly << "|" << top100 << "|" << cache << "|" << path;
+        auto key = keyStream.str();
+        
+        std::lock_guard<std::mutex> dolock(loadedBookMutex);
+        auto it = loadedBookMap.find(key);
+        if (it != loadedBookMap.end()) {
+            auto book = it->second.lock();
+            if (book) {
+                bookList.push_back(book);
+                return true;
+            }
+        }
+        
+        std::shared_ptr<Book> book;
         switch (type) {
             case BookType::edp:
-                book = new BookEdp;
+                book = std::make_shared<BookEdp>(cache);
                 break;
             case BookType::pgn:
-                book = new BookPgn;
+                book = std::make_shared<BookPgn>(cache);
                 break;
                 
             case BookType::polygot:
-                book = new BookPolyglot;
+                book = std::make_shared<BookPolyglot>();
                 break;
                 
             default:
                 return false;
         }
         book->load(path, maxPly, top100);
-        if (book->isEmpty()) {
-            delete book;
-        } else {
+        if (!book->isEmpty()) {
             bookList.push_back(book);
+            loadedBookMap[key] = book;
         }
         
         return true;
@@ -503,45 +791,146 @@ Json::Value BookMng::saveToJson() const
     return obj;
 }
 
-bool BookMng::getRandomBook(int pairId, std::string& fenString, std::vector<Move>& moves)
+// Each draw has its own generator seeded from the draw index thus results
+// do not depend on how the draws are spread over threads
+bool BookMng::drawOpening(u64 drawIdx, std::string& fenString, std::vector<Move>& moves) const
 {
     fenString = "";
     moves.clear();
     
-    queryCnt++;
-    if (queryCnt == 1) {
-        std::srand(seed >= 0 ? seed : static_cast<unsigned int>(std::time(nullptr)));
-    }
+    std::seed_seq seq { baseSeed, u32(drawIdx), u32(drawIdx >> 32) };
+    std::mt19937 rng(seq);
+    auto k = size_t(rng()) % bookList.size();
+    return bookList.at(k)->getRandomBook(rng, fenString, moves);
+}
 
-    if (bookSelectType == BookSelectType::allone) {
-        if (!alloneFenString.empty()) {
-            fenString = alloneFenString;
-            return true;
-        }
-        if (!alloneMoves.empty()) {
-            moves = alloneMoves;
-            return true;
+std::vector<int> BookMng::sampleOpenings(size_t cnt)
+{
+    std::vector<int> idxList;
+    if (cnt == 0) {
+        return idxList;
+    }
+    
+    if (bookSelectType == BookSelectType::allone || bookList.empty()) {
+        if (alloneIdx < 0) {
+            std::string fenString;
+            std::vector<Move> moves;
+            if (bookSelectType == BookSelectType::allone && !alloneFenString.empty()) {
+                fenString = alloneFenString;
+            } else if (bookSelectType == BookSelectType::allone && !alloneMoves.empty()) {
+                moves = alloneMoves;
+            } else if (!bookList.empty()) {
+                drawOpening(drawCnt++, fenString, moves);
+            }
+            alloneIdx = openingTable.add(fenString, moves);
         }
+        idxList.resize(cnt, alloneIdx);
+        return idxList;
     }
     
-    if (bookList.empty()) {
-        return false;
+    const int maxRounds = 8;
+    idxList.resize(cnt, -1);
+    std::vector<size_t> pendingList;
+    for(size_t i = 0; i < cnt; i++) {
+        pendingList.push_back(i);
     }
     
-    if (queryCnt == 1 ||
-        bookSelectType == BookSelectType::allnew ||
-        (bookSelectType == BookSelectType::samepair && pairId != lastPairIdx)
-        ) {
-        theFenString = "";
-        theMoves.clear();
-        auto k = size_t(rand()) % bookList.size();
-        bookList.at(k)->getRandomBook(theFenString, theMoves);
+    for(int round = 0; !pendingList.empty(); round++) {
+        auto n = pendingList.size();
+        std::vector<std::string> fenList(n);
+        std::vector<std::vector<Move>> movesList(n);
+        
+        auto firstDraw = drawCnt;
+        drawCnt += n;
+        
+        auto threadCnt = std::min(size_t(std::max(1u, std::thread::hardware_concurrency())), (n + 63) / 64);
+        auto work = [&](size_t start) {
+            for(auto i = start; i < n; i += threadCnt) {
+                drawOpening(firstDraw + i, fenList[i], movesList[i]);
+            }
+        };
+        
+        if (threadCnt <= 1) {
+            work(0);
+        } else {
+            std::vector<std::thread> threadList;
+            for(size_t t = 0; t < threadCnt; t++) {
+                threadList.push_back(std::thread(work, t));
+            }
+            for(auto && t : threadList) {
+                t.join();
+            }
+        }
+        
+        // duplicates are accepted in the last round, the books may be too small
+        std::vector<size_t> rejectedList;
+        for(size_t i = 0; i < n; i++) {
+            if (round + 1 < maxRounds && openingTable.find(fenList[i], movesList[i]) >= 0) {
+                rejectedList.push_back(pendingList[i]);
+                continue;
+            }
+            idxList[pendingList[i]] = openingTable.add(fenList[i], movesList[i]);
+        }
+        
+        rejectedCnt += rejectedList.size();
+        pendingList.swap(rejectedList);
     }
     
-    lastPairIdx = pairId;
+    return idxList;
+}
+
+/////////////////////////////////////////
+std::string OpeningTable::createKey(const std::string& fenString, const std::vector<Move>& moves)
+{
+    auto key = fenString;
+    key.push_back('\n');
+    for(auto && m : moves) {
+        auto k = InfoRecord::packMove(m.from, m.dest, m.promotion);
+        key.push_back(char(k & 0xff));
+        key.push_back(char(k >> 8));
+    }
+    return key;
+}
+
+int OpeningTable::add(const std::string& fenString, const std::vector<Move>& moves)
+{
+    auto r = keyMap.emplace(createKey(fenString, moves), int(fenList.size()));
+    if (r.second) {
+        fenList.push_back(fenString);
+        for(auto && m : moves) {
+            moveArena.push_back(InfoRecord::packMove(m.from, m.dest, m.promotion));
+        }
+        moveOffsets.push_back(u32(moveArena.size()));
+    }
+    return r.first->second;
+}
+
+int OpeningTable::find(const std::string& fenString, const std::vector<Move>& moves) const
+{
+    auto it = keyMap.find(createKey(fenString, moves));
+    return it == keyMap.end() ? -1 : it->second;
+}
+
+bool OpeningTable::get(int idx, std::string& fenString, std::vector<Move>& moves) const
+{
+    fenString = "";
+    moves.clear();
     
-    fenString = theFenString;
-    moves = theMoves;
+    if (idx < 0 || idx >= int(fenList.size())) {
+        return false;
+    }
+    
+    fenString = fenList[size_t(idx)];
+    for(auto i = moveOffsets[size_t(idx)]; i < moveOffsets[size_t(idx) + 1]; i++) {
+        moves.push_back(InfoRecord::unpackMove(moveArena[i]));
+    }
     return true;
 }
 
+void OpeningTable::clear()
+{
+    fenList.clear();
+    moveArena.clear();
+    moveOffsets.assign(1, 0);
+    keyMap.clear();
+}
@@ -27,8 +27,14 @@
 #define book_h
 
 #include <stdio.h>
+#include <random>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include "../chess/chess.h"
+#include "../base/mappedfile.h"
 
 namespace banksia {
 
@@ -50,7 +56,8 @@ namespace banksia {
         virtual bool isEmpty() const = 0;
         virtual size_t size() const = 0;
 
-        virtual bool getRandomBook(std::string& fenString, std::vector<Move>& moves) const = 0;
+        // rng is owned by the caller so draws can run on several threads at once
+        virtual bool getRandomBook(std::mt19937& rng, std::string& fenString, std::vector<Move>& moves) const = 0;
 
     public:
         virtual void load(const std::string& path, int maxPly, int top100) = 0;
@@ -64,39 +71,63 @@ namespace banksia {
     class BookEdp : public Book
     {
     public:
-        BookEdp() : Book(BookType::edp) {}
+        BookEdp(bool useCache = false) : Book(BookType::edp), useCache(useCache) {}
         virtual ~BookEdp() {}
         
         virtual const char* className() const override { return "BookEdp"; }
         bool isEmpty() const override;
         size_t size() const override;
         
-        bool getRandomBook(std::string& fenString, std::vector<Move>& moves) const override;
+        bool getRandomBook(std::mt19937& rng, std::string& fenString, std::vector<Move>& moves) const override;
         void load(const std::string& path, int maxPly, int top100) override;
         
     private:
-        std::string getRandomFEN() const;
-        std::vector<std::string> stringVec;
+        std::string getRandomFEN(std::mt19937& rng) const;
+        std::string lineAt(size_t idx) const;
+        
+        bool loadIndex(const std::string& indexPath, i64 epdSize, i64 epdTime);
+        bool saveIndex(const std::string& indexPath, i64 epdSize, i64 epdTime) const;
+        
+        // lines are read from the mapped file on demand, the offsets are either
+        // built into lineOffsets or mapped from a saved index file
+        MappedFile file, indexFile;
+        std::vector<u64> lineOffsets;
+        const u64* offsets = nullptr;
+        size_t lineCnt = 0;
+        
+        bool useCache;
     };
 
     class BookPgn : public Book
     {
     public:
-        BookPgn() : Book(BookType::pgn) {}
+        BookPgn(bool useCache = false) : Book(BookType::pgn), useCache(useCache) {}
         virtual ~BookPgn() {}
         
         virtual const char* className() const override { return "BookPgn"; }
         
         bool isEmpty() const override;
         size_t size() const override;
-        bool getRandomBook(std::string& fenString, std::vector<Move>& moves) const override;
+        bool getRandomBook(std::mt19937& rng, std::string& fenString, std::vector<Move>& moves) const override;
         void load(const std::string& path, int maxPly, int top100) override;
         static std::vector<Move> moveString2Moves(const std::string& str);
+        
     private:
-        void loadPgnBook(const std::string& path);
-        bool addPgnMoves(const std::string& s);
+        void parse(const char* data, const char* end);
+        bool parseToken(ChessBoard& board, const char* token, size_t len);
+        void endLine(ChessBoard& board);
+        
+        bool loadCache(const std::string& cachePath, i64 pgnSize, i64 pgnTime);
+        bool saveCache(const std::string& cachePath, i64 pgnSize, i64 pgnTime) const;
         
-        std::vector<std::vector<Move>> moves;
+        // all lines in one arena, moves packed by InfoRecord::packMove,
+        // line i is from lineOffsets[i] to lineOffsets[i + 1]
+        std::vector<u16> moveArena;
+        std::vector<u32> lineOffsets;
+        
+        bool useCache;
+        bool skipLine = false, badLine = false;
+        std::string sanString;
     };
     
     class BookPolyglotItem {
@@ -122,7 +153,7 @@ namespace banksia {
 
         bool isEmpty() const override;
         size_t size() const override;
-        bool getRandomBook(std::string& fenString, std::vector<Move>& moves) const override;
+        bool getRandomBook(std::mt19937& rng, std::string& fenString, std::vector<Move>& moves) const override;
         void load(const std::string& path, int maxPly, int top100) override;
         
         std::vector<BookPolyglotItem> search(u64 key) const;
@@ -130,18 +161,42 @@ namespace banksia {
     private:
         i64 binarySearch(u64 key) const;
         
+        // items are kept as in the file (big endian), only keys are converted when comparing
+        u64 keyAt(i64 idx) const;
+        
+        MappedFile file;
         i64 itemCnt = 0;
-        BookPolyglotItem* items = nullptr;
+        const BookPolyglotItem* items = nullptr;
     };
     
 
+    // Openings of a tournament, each one is stored once and match records refer to it by index
+    class OpeningTable
+    {
+    public:
+        // returns the index of the opening, adds it if it is not in the table yet
+        int add(const std::string& fenString, const std::vector<Move>& moves);
+        int find(const std::string& fenString, const std::vector<Move>& moves) const;
+        bool get(int idx, std::string& fenString, std::vector<Move>& moves) const;
+        
+        size_t size() const { return fenList.size(); }
+        void clear();
+        
+    private:
+        static std::string createKey(const std::string& fenString, const std::vector<Move>& moves);
+        
+        std::vector<std::string> fenList;
+        std::vector<u16> moveArena;
+        std::vector<u32> moveOffsets = { 0 };
+        std::unordered_map<std::string, int> keyMap;
+    };
+
     class BookMng : public Jsonable
     {
     public:
         BookMng();
         virtual ~BookMng();
         
-        static BookMng* instance;
         
         virtual bool isValid() const override;
         virtual std::string toString() const override;
@@ -149,7 +204,15 @@ namespace banksia {
         
         virtual bool load(const Json::Value& obj) override;
         virtual Json::Value saveToJson() const override;
-        bool getRandomBook(int pairId, std::string& fenString, std::vector<Move>& moves);
+        
+        // draws cnt openings in one batch into the opening table and returns their indexes.
+        // Openings already in the table are rejected and redrawn for a few rounds
+        std::vector<int> sampleOpenings(size_t cnt);
+        size_t getRejectedCnt() const { return rejectedCnt; }
+        
+        OpeningTable& getOpeningTable() { return openingTable; }
+        const OpeningTable& getOpeningTable() const { return openingTable; }
+        void clearOpenings() { openingTable.clear(); alloneIdx = -1; }
 
         static BookType string2BookType(const std::string& name);
         static std::string bookType2String(BookType type);
@@ -164,18 +227,24 @@ namespace banksia {
 
     private:
         bool loadSingle(const Json::Value& obj);
+        bool drawOpening(u64 drawIdx, std::string& fenString, std::vector<Move>& moves) const;
 
         BookSelectType bookSelectType = BookSelectType::allnew;
         
-        std::vector<Book*> bookList;
+        // books are read-only after loading thus tournaments of a batch share the same ones
+        std::vector<std::shared_ptr<Book>> bookList;
+        static std::map<std::string, std::weak_ptr<Book>> loadedBookMap;
+        static std::mutex loadedBookMutex;
         
-        int queryCnt = 0, lastPairIdx = 1;
-        std::string theFenString;
-        std::vector<Move> theMoves;
+        OpeningTable openingTable;
+        u64 drawCnt = 0;
+        size_t rejectedCnt = 0;
+        int alloneIdx = -1;
         
         std::string alloneFenString;
         std::vector<Move> alloneMoves;
         int seed = -1;
+        u32 baseSeed = 0;
     };
     
     
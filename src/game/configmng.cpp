@@ -23,6 +23,8 @@
  */
 
 
+#include <algorithm>
+
 #include "configmng.h"
 
 namespace banksia {
@@ -443,6 +445,8 @@ bool Config::load(const Json::Value& obj)
     
     if (app.isMember("ponderable")) ponderable = app["ponderable"].asBool(); // useful for Winboard only
     if (app.isMember("elo")) elo = app["elo"].asInt();
+    if (app.isMember("fen position ply")) fenPositionPly = std::max(0, app["fen position ply"].asInt()); // useful for UCI only
+    if (app.isMember("nodes factor") && app["nodes factor"].asDouble() > 0) nodesFactor = app["nodes factor"].asDouble();
     
     variantSet.clear();
     if (app.isMember("variants")) {
@@ -489,6 +493,7 @@ bool Config::load(const Json::Value& obj)
             }
         }
     }
+    rebuildOptionIndex();
     
     return true;
 }
@@ -506,6 +511,12 @@ Json::Value Config::saveToJson() const
     if (protocol == Protocol::wb) { // useful for Winboard only
         app["ponderable"] = ponderable;
     }
+    if (protocol == Protocol::uci && fenPositionPly > 0) {
+        app["fen position ply"] = fenPositionPly;
+    }
+    if (nodesFactor != 1.0) {
+        app["nodes factor"] = nodesFactor;
+    }
 
     if (!variantSet.empty()) {
         Json::Value array;
@@ -597,37 +608,54 @@ std::string Config::toString() const
     return stringStream.str();
 }
 
-Option* Config::getOption(const std::string& name)
+void Config::rebuildOptionIndex()
 {
-    for(auto && option : optionList) {
-        if (option.name == name) {
-            return &option;
-        }
+    optionIndexMap.clear();
+    lowerOptionIndexMap.clear();
+    for(int i = 0; i < int(optionList.size()); i++) {
+        // the first one wins as the linear search did
+        auto name = optionList.at(i).name;
+        optionIndexMap.insert(std::make_pair(name, i));
+        toLower(name);
+        lowerOptionIndexMap.insert(std::make_pair(name, i));
     }
-    return nullptr;
+    optionsChanged();
+}
+
+Option* Config::getOption(const std::string& name)
+{
+    auto it = optionIndexMap.find(name);
+    return it == optionIndexMap.end() ? nullptr : &optionList.at(it->second);
 }
 
 const Option* Config::getOption(const std::string& name) const
 {
-    for(auto && option : optionList) {
-        if (option.name == name) {
-            return &option;
-        }
-    }
-    return nullptr;
+    auto it = optionIndexMap.find(name);
+    return it == optionIndexMap.end() ? nullptr : &optionList.at(it->second);
+}
+
+const Option* Config::getOptionIgnoreCase(const std::string& lowerName) const
+{
+    auto it = lowerOptionIndexMap.find(lowerName);
+    return it == lowerOptionIndexMap.end() ? nullptr : &optionList.at(it->second);
 }
 
 void Config::updateOption(const Option& o)
 {
-    for(auto && option : optionList) {
-        if (option.name == o.name) {
-            if (option != o) {
-                option.update(o);
-            }
-            return;
+    auto option = getOption(o.name);
+    if (option == nullptr) {
+        appendOption(o);
+        return;
+    }
+    
+    // engines report their options at every start, mostly the same, the values are kept anyway
+    if (*option != o) {
+        auto old = *option;
+        option->update(o);
+        if (*option != old) {
+            optionsChanged();
         }
     }
-    appendOption(o);
 }
 
 void Config::appendOption(const Option& option)
@@ -636,13 +664,42 @@ void Config::appendOption(const Option& option)
         ponderable = true;
     }
     
+    auto name = option.name;
+    optionIndexMap.insert(std::make_pair(name, int(optionList.size())));
+    toLower(name);
+    lowerOptionIndexMap.insert(std::make_pair(name, int(optionList.size())));
     optionList.push_back(option);
+    optionsChanged();
+}
+
+const std::string& Config::getUciOptionCommands() const
+{
+    auto generation = ConfigMng::instance ? ConfigMng::instance->getOverrideGeneration() : 0;
+    if (uciOptionCommandsGeneration == generation) {
+        return uciOptionCommands;
+    }
+    
+    uciOptionCommands.clear();
+    for(auto && option : optionList) {
+        auto o = ConfigMng::instance ? ConfigMng::instance->checkOverrideOption(option) : option;
+        if (o.isDefaultValue()) {
+            continue;
+        }
+        
+        if (!uciOptionCommands.empty()) {
+            uciOptionCommands += "\n";
+        }
+        uciOptionCommands += "setoption name " + o.name + " value " + o.getValueAsString();
+    }
+    uciOptionCommandsGeneration = generation;
+    return uciOptionCommands;
 }
 
 bool Config::updateOptionValue(const std::string& name, int val)
 {
     auto option = getOption(name);
     if (option == nullptr) return false;
+    optionsChanged();
     option->value = val;
     assert(option->type == OptionType::spin);
     return true;
@@ -652,6 +709,7 @@ bool Config::updateOptionValue(const std::string& name, bool val)
 {
     auto option = getOption(name);
     if (option == nullptr) return false;
+    optionsChanged();
     option->checked = val;
     assert(option->type == OptionType::check);
     return true;
@@ -661,6 +719,7 @@ bool Config::updateOptionValue(const std::string& name, const std::string& val)
 {
     auto option = getOption(name);
     if (option == nullptr) return false;
+    optionsChanged();
     option->string = val;
     assert(option->type == OptionType::string);
     return true;
@@ -718,6 +777,56 @@ std::vector<std::string> ConfigMng::nameList() const
     return list;
 }
 
+bool ConfigMng::loadFile(const std::string& path)
+{
+    if (loadedFileMap.find(path) != loadedFileMap.end()) {
+        return true;
+    }
+    
+    loadingNames.clear();
+    loadingPath = path;
+    if (!loadFromJsonFile(path)) {
+        return false;
+    }
+    loadedFileMap[path] = loadingNames;
+    return true;
+}
+
+// A name of an engine file loaded earlier keeps its config, the tournaments using that file
+// have counted on it. The same config again is fine
+bool ConfigMng::isDefinedByOtherFile(const Config& config) const
+{
+    auto it = configMap.find(config.name);
+    if (it == configMap.end()) {
+        return false;
+    }
+    
+    for(auto && p : loadedFileMap) {
+        if (std::find(p.second.begin(), p.second.end(), config.name) == p.second.end()) {
+            continue;
+        }
+        if (it->second.saveToJson() != config.saveToJson()) {
+            std::cerr << "Warning: engine " << config.name << " of " << loadingPath << " is ignored, " << p.first << " has a different one of that name" << std::endl;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::string> ConfigMng::nameList(const std::string& path) const
+{
+    auto it = loadedFileMap.find(path);
+    if (it == loadedFileMap.end()) {
+        return std::vector<std::string>();
+    }
+    
+    // sorted as ones of the whole map
+    auto list = it->second;
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+    return list;
+}
+
 size_t ConfigMng::size() const
 {
     return configMap.size();
@@ -731,6 +840,7 @@ void ConfigMng::clear()
 std::vector<Config> ConfigMng::configList() const
 {
     std::vector<Config> list;
+    std::lock_guard<std::mutex> dolock(configMutex);
     for(auto && c : configMap) {
         list.push_back(c.second);
     }
@@ -742,8 +852,11 @@ bool ConfigMng::parseJsonAfterLoading(Json::Value& jsonData)
     for (Json::Value::const_iterator it = jsonData.begin(); it != jsonData.end(); ++it) {
         Config config;
         config.load(*it);
-        if (editingMode || config.isValid()) {
-            insert(config);
+        if (!editingMode && config.isValid() && isDefinedByOtherFile(config)) {
+            continue;
+        }
+        if ((editingMode || config.isValid()) && insert(config)) {
+            loadingNames.push_back(config.name);
         }
     }
     return true;
@@ -764,13 +877,21 @@ Json::Value ConfigMng::createJsonForSaving()
 Config ConfigMng::get(const std::string& name) const
 {
     auto it = configMap.find(name);
-    if (it != configMap.end()) return it->second;
+    if (it != configMap.end()) {
+        // the copies carry the resolved setoption lines, thus they are built once, not at every engine start
+        std::lock_guard<std::mutex> dolock(configMutex);
+        if (it->second.protocol == Protocol::uci) {
+            it->second.getUciOptionCommands();
+        }
+        return it->second;
+    }
     return Config();
 }
 
 Config ConfigMng::get(int idx) const
 {
     if (idx < configMap.size()) {
+        std::lock_guard<std::mutex> dolock(configMutex);
         auto it = configMap.begin();
         std::advance(it, idx);
         return it->second;
@@ -809,11 +930,16 @@ bool ConfigMng::insert(const Config& config)
 
 bool ConfigMng::loadOverrideOptions(const Json::Value& oo)
 {
+    overrideGeneration++;
+    
     if (oo.isMember("base")) {
         auto v = oo["base"];
         overrideOptionMode = v.isMember("mode") && v["mode"].asBool();
         overrideOptionThreads = v.isMember("threads") ? v["threads"].asInt() : 0;
         overrideOptionMemory = v.isMember("memory") ? v["memory"].asInt() : 0;
+        memoryPlanMode = v.isMember("memory plan") && v["memory plan"].asBool();
+        memoryReserve = v.isMember("memory reserve") ? v["memory reserve"].asInt() : default_memory_reserve;
+        memoryLimitRoom = v.isMember("memory limit") ? v["memory limit"].asInt() : 0;
 
 		if (overrideOptionThreads > 0) {
 			threadOption.name = "threads";
@@ -822,13 +948,7 @@ bool ConfigMng::loadOverrideOptions(const Json::Value& oo)
 			threadOption.setDefaultValue(overrideOptionThreads, 1, overrideOptionThreads * 2);
 			assert(threadOption.isValid());
 		}
-		if (overrideOptionMemory > 0) {
-			memoryOption.name = "memory";
-			memoryOption.type = OptionType::spin;
-			memoryOption.setOverrideType(true);
-			memoryOption.setDefaultValue(overrideOptionMemory, 1, overrideOptionMemory * 2);
-			assert(memoryOption.isValid());
-		}
+		setEngineMemory(overrideOptionMemory);
     }
     
     if (!overrideOptionMode || !oo.isMember("options")) {
@@ -849,9 +969,24 @@ bool ConfigMng::loadOverrideOptions(const Json::Value& oo)
     return true;
 }
 
+void ConfigMng::setEngineMemory(int memory)
+{
+    overrideOptionMemory = memory;
+    overrideGeneration++;
+    
+    if (overrideOptionMemory > 0) {
+        memoryOption.name = "memory";
+        memoryOption.type = OptionType::spin;
+        memoryOption.setOverrideType(true);
+        memoryOption.setDefaultValue(overrideOptionMemory, 1, overrideOptionMemory * 2);
+        assert(memoryOption.isValid());
+    }
+}
+
 void ConfigMng::setSyzygyPath(const std::string& path)
 {
 	syzygyPath = path;
+    overrideGeneration++;
 
 	if (syzygyPath.empty()) return;
 
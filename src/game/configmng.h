@@ -27,6 +27,8 @@
 
 #include <vector>
 #include <set>
+#include <mutex>
+#include <unordered_map>
 
 #include "player.h"
 
@@ -115,6 +117,8 @@ namespace banksia {
         
         Option* getOption(const std::string& name);
         const Option* getOption(const std::string& name) const;
+        // name in lower case, for the options engines spell their own ways (Hash, hash)
+        const Option* getOptionIgnoreCase(const std::string& lowerName) const;
         void updateOption(const Option&);
         void appendOption(const Option&);
         
@@ -129,6 +133,17 @@ namespace banksia {
         int getElo() const {
             return elo;
         }
+        
+        // the setoption lines of all non-default options, overrides applied, built once
+        // until the options or the overrides change
+        const std::string& getUciOptionCommands() const;
+        
+    private:
+        void rebuildOptionIndex();
+        void optionsChanged() {
+            uciOptionCommandsGeneration = -1;
+        }
+        
     public:
         Protocol protocol;
         int elo = 0;
@@ -136,9 +151,25 @@ namespace banksia {
         
         std::vector<std::string> argumentList, initStringList;
         std::set<std::string> variantSet;
-        std::vector<Option> optionList;
         
         bool ponderable = true; // for Winboard protocol only
+        
+        // for UCI protocol only, from this ply on "position fen" of the last irreversible move
+        // goes with the moves after it, instead of all moves of the game. Zero is off
+        int fenPositionPly = 0;
+        
+        // scales the nodes of the time control mode nodes, for engines counting nodes differently
+        double nodesFactor = 1.0;
+        
+    private:
+        // added and found through appendOption, updateOption and getOption only, they keep the indexes
+        std::vector<Option> optionList;
+        
+        // indexes of optionList by names
+        std::unordered_map<std::string, int> optionIndexMap, lowerOptionIndexMap;
+        
+        mutable std::string uciOptionCommands;
+        mutable int uciOptionCommandsGeneration = -1;
     };
     
     class ConfigMng : public Obj, public JsonSavable
@@ -154,6 +185,8 @@ namespace banksia {
         bool isValid() const override;
         std::string toString() const override;
         
+        // copies may be taken from several threads, the cache of setoption lines is filled
+        // under a lock. The configs themselves are changed before the games start only
         Config get(const std::string& name) const;
         Config get(int idx) const;
         
@@ -165,6 +198,11 @@ namespace banksia {
         
         bool isNameExistent(const std::string& name) const;
         std::vector<std::string> nameList() const;
+        
+        // tournaments of a batch may use the same file, it is loaded once; the names are of that file only.
+        // A name defined differently by an earlier file is ignored with a warning
+        bool loadFile(const std::string& path);
+        std::vector<std::string> nameList(const std::string& path) const;
 
         size_t size() const;
         void clear();
@@ -192,20 +230,45 @@ namespace banksia {
         int getEngineMemory() const {
             return overrideOptionMode ? overrideOptionMemory : 0;
         }
+        // the hash in MB for all engines, set by the memory plan too
+        void setEngineMemory(int memory);
+        
+        // the hash is worked out from the host memory, getEngineMemory is then its cap
+        bool isMemoryPlanMode() const { return overrideOptionMode && memoryPlanMode; }
+        int getMemoryReserve() const { return memoryReserve; }
+        // MB an engine process may use over its hash, zero for no limit
+        int getMemoryLimitRoom() const { return overrideOptionMode ? memoryLimitRoom : 0; }
+        
+        // changes whenever the override options change, for caches of resolved options
+        int getOverrideGeneration() const {
+            return overrideGeneration;
+        }
 
     protected:
         Json::Value createJsonForSaving() override;
         
     private:
         bool parseJsonAfterLoading(Json::Value&) override;
+        bool isDefinedByOtherFile(const Config& config) const;
         
         std::map<std::string, Config> configMap;
+        mutable std::mutex configMutex;
         std::map<std::string, Option> overrideOptions;
+        
+        std::map<std::string, std::vector<std::string>> loadedFileMap;
+        std::vector<std::string> loadingNames;
+        std::string loadingPath;
 
         bool editingMode = false, overrideOptionMode = false;
         
         int overrideOptionThreads = 0;
         int overrideOptionMemory = 0;
+        int overrideGeneration = 0;
+        
+        // MB left for the system and the manager
+        static const int default_memory_reserve = 1024;
+        bool memoryPlanMode = false;
+        int memoryReserve = default_memory_reserve, memoryLimitRoom = 0;
 		std::string syzygyPath;
 
 		Option threadOption, memoryOption, syzygyOption;
@@ -0,0 +1,266 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "distributed.h"
+#include "scheduler.h"
+
+using namespace banksia;
+
+std::vector<RemoteMessage> RemoteLink::takeMessages()
+{
+    std::vector<RemoteMessage> vec;
+    std::lock_guard<std::mutex> dolock(inboxMutex);
+    vec.swap(inbox);
+    return vec;
+}
+
+std::string RemoteLink::toLine(const Json::Value& obj)
+{
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, obj);
+}
+
+void RemoteLink::readLoop(TcpSocket* socket, int connId)
+{
+    std::string line;
+    while (socket->readLine(line)) {
+        RemoteMessage msg;
+        msg.connId = connId;
+        if (line.empty() || !JsonSavable::loadFromJsonString(line, msg.obj, false) || !msg.obj.isObject()) {
+            std::cerr << "Warning: bad message from " << socket->getPeerName() << std::endl;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> dolock(inboxMutex);
+            inbox.push_back(msg);
+        }
+        EventScheduler::post();
+    }
+    
+    RemoteMessage msg;
+    msg.connId = connId;
+    msg.obj["cmd"] = "closed";
+    {
+        std::lock_guard<std::mutex> dolock(inboxMutex);
+        inbox.push_back(msg);
+    }
+    EventScheduler::post();
+}
+
+static const char* base64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string RemoteLink::toBase64(const std::string& data)
+{
+    std::string str;
+    str.reserve((data.size() + 2) / 3 * 4);
+    
+    size_t i = 0;
+    for(; i + 2 < data.size(); i += 3) {
+        u32 v = u32(u8(data[i])) << 16 | u32(u8(data[i + 1])) << 8 | u8(data[i + 2]);
+        str += base64Chars[v >> 18];
+        str += base64Chars[(v >> 12) & 63];
+        str += base64Chars[(v >> 6) & 63];
+        str += base64Chars[v & 63];
+    }
+    
+    if (i < data.size()) {
+        u32 v = u32(u8(data[i])) << 16;
+        if (i + 1 < data.size()) {
+            v |= u32(u8(data[i + 1])) << 8;
+        }
+        str += base64Chars[v >> 18];
+        str += base64Chars[(v >> 12) & 63];
+        str += i + 1 < data.size() ? base64Chars[(v >> 6) & 63] : '=';
+        str += '=';
+    }
+    return str;
+}
+
+bool RemoteLink::fromBase64(const std::string& str, std::string& data)
+{
+    if (str.size() % 4) {
+        return false;
+    }
+    
+    data.clear();
+    data.reserve(str.size() / 4 * 3);
+    
+    u32 v = 0;
+    int bits = 0;
+    for(size_t i = 0; i < str.size(); i++) {
+        auto ch = str[i];
+        if (ch == '=') {
+            // padding only at the end
+            return i + 2 >= str.size();
+        }
+        auto p = strchr(base64Chars, ch);
+        if (p == nullptr || ch == 0) {
+            return false;
+        }
+        v = v << 6 | u32(p - base64Chars);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data += char((v >> bits) & 0xff);
+        }
+    }
+    return true;
+}
+
+//////////////////////////////////////////
+Coordinator::~Coordinator()
+{
+    shutdown();
+}
+
+bool Coordinator::start(int _port)
+{
+    port = _port;
+    if (running || !server.listen(port)) {
+        return false;
+    }
+    running = true;
+    acceptThread = new std::thread([=]() { acceptLoop(); });
+    return true;
+}
+
+void Coordinator::acceptLoop()
+{
+    while (running) {
+        auto socket = server.accept();
+        if (socket == nullptr) {
+            break;
+        }
+        
+        std::lock_guard<std::mutex> dolock(connMutex);
+        if (!running) {
+            delete socket;
+            break;
+        }
+        auto connId = nextConnId++;
+        Connection conn;
+        conn.socket = socket;
+        conn.thread = new std::thread([=]() { readLoop(socket, connId); });
+        connMap[connId] = conn;
+    }
+}
+
+void Coordinator::shutdown()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    
+    server.close();
+    {
+        // wakes up accept where closing doesn't
+        TcpSocket waker;
+        waker.connect("127.0.0.1", port);
+    }
+    
+    if (acceptThread) {
+        acceptThread->join();
+        delete acceptThread;
+        acceptThread = nullptr;
+    }
+    
+    std::lock_guard<std::mutex> dolock(connMutex);
+    for(auto && p : connMap) {
+        p.second.socket->close();
+        p.second.thread->join();
+        delete p.second.thread;
+        delete p.second.socket;
+    }
+    connMap.clear();
+}
+
+bool Coordinator::send(int connId, const Json::Value& obj)
+{
+    std::lock_guard<std::mutex> dolock(connMutex);
+    auto it = connMap.find(connId);
+    return it != connMap.end() && it->second.socket->writeLine(toLine(obj));
+}
+
+std::string Coordinator::getPeerName(int connId)
+{
+    std::lock_guard<std::mutex> dolock(connMutex);
+    auto it = connMap.find(connId);
+    return it != connMap.end() ? it->second.socket->getPeerName() : "";
+}
+
+void Coordinator::removeConnection(int connId)
+{
+    Connection conn;
+    {
+        std::lock_guard<std::mutex> dolock(connMutex);
+        auto it = connMap.find(connId);
+        if (it == connMap.end()) {
+            return;
+        }
+        conn = it->second;
+        connMap.erase(it);
+    }
+    
+    conn.socket->close();
+    conn.thread->join();
+    delete conn.thread;
+    delete conn.socket;
+}
+
+//////////////////////////////////////////
+Worker::~Worker()
+{
+    shutdown();
+}
+
+bool Worker::start(const std::string& host, int port)
+{
+    if (running || !socket.connect(host, port)) {
+        return false;
+    }
+    running = true;
+    readThread = new std::thread([=]() { readLoop(&socket, 0); });
+    return true;
+}
+
+void Worker::shutdown()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    socket.close();
+    if (readThread) {
+        readThread->join();
+        delete readThread;
+        readThread = nullptr;
+    }
+}
+
+bool Worker::send(const Json::Value& obj)
+{
+    return socket.writeLine(toLine(obj));
+}
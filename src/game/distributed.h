@@ -0,0 +1,154 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef distributed_h
+#define distributed_h
+
+#include <thread>
+#include <map>
+#include <chrono>
+
+#include "../base/tcpsocket.h"
+#include "../base/base.h"
+
+namespace banksia {
+    
+    // Distributed mode: one coordinator owns the match list and openings, workers
+    // play the matches with their own engines and send back the games.
+    // Both sides talk with JSON objects, one per line, their "cmd" tells what they are:
+    //  worker -> coordinator: hello, request (a match), result, failed, alive
+    //  coordinator -> worker: hello, match, wait (nothing to give now)
+    // Games are sent as GameArchive records in base64.
+    
+    enum class RemoteMode {
+        off, coordinator, worker
+    };
+    
+    // A line received by a reader thread. cmd "closed" is made up when the connection is lost
+    class RemoteMessage
+    {
+    public:
+        int connId = 0;
+        Json::Value obj;
+        
+        std::string getCmd() const { return obj["cmd"].asString(); }
+    };
+    
+    // a match given to a worker, back to the pending queue when the lease expires
+    class RemoteLease
+    {
+    public:
+        int connId = 0, leaseId = 0;
+        std::chrono::steady_clock::time_point expireClock;
+    };
+    
+    // a match received by a worker, kept by its local game index
+    class RemoteMatch
+    {
+    public:
+        int leaseId = 0, gameIdx = 0;
+    };
+    
+    // Messages are read on their own threads and queued, the tournament manager
+    // takes and handles them on its thread
+    class RemoteLink
+    {
+    public:
+        RemoteLink() {}
+        virtual ~RemoteLink() {}
+        
+        std::vector<RemoteMessage> takeMessages();
+        
+        static std::string toLine(const Json::Value& obj);
+        static std::string toBase64(const std::string& data);
+        static bool fromBase64(const std::string& str, std::string& data);
+        
+        static const int default_port = 7400;
+        
+    protected:
+        void readLoop(TcpSocket* socket, int connId);
+        
+        std::mutex inboxMutex;
+        std::vector<RemoteMessage> inbox;
+        
+    private:
+        RemoteLink(const RemoteLink&) = delete;
+        RemoteLink& operator = (const RemoteLink&) = delete;
+    };
+    
+    class Coordinator : public RemoteLink
+    {
+    public:
+        virtual ~Coordinator();
+        
+        bool start(int port);
+        void shutdown();
+        bool isRunning() const { return running; }
+        
+        bool send(int connId, const Json::Value& obj);
+        std::string getPeerName(int connId);
+        
+        // after its "closed" message, its reader thread has finished
+        void removeConnection(int connId);
+        
+    private:
+        class Connection
+        {
+        public:
+            TcpSocket* socket = nullptr;
+            std::thread* thread = nullptr;
+        };
+        
+        void acceptLoop();
+        
+        TcpSocket server;
+        int port = default_port;
+        std::atomic<bool> running { false };
+        std::thread* acceptThread = nullptr;
+        
+        std::mutex connMutex;
+        std::map<int, Connection> connMap;
+        int nextConnId = 1;
+    };
+    
+    class Worker : public RemoteLink
+    {
+    public:
+        virtual ~Worker();
+        
+        bool start(const std::string& host, int port);
+        void shutdown();
+        bool isRunning() const { return running; }
+        
+        bool send(const Json::Value& obj);
+        
+    private:
+        TcpSocket socket;
+        std::atomic<bool> running { false };
+        std::thread* readThread = nullptr;
+    };
+    
+} // namespace banksia
+
+#endif /* distributed_h */
@@ -27,14 +27,22 @@
     #include <codecvt>
 #endif
 
+#include <chrono>
+#include <cctype>
+#include <cmath>
+
 #include "engine.h"
 #include "tourmng.h"
+#include "../base/coreallocator.h"
+#include "../base/memoryplanner.h"
+#include "../base/metrics.h"
 
 using namespace banksia;
 
 ////////////////////////////////////
 Engine::~Engine()
 {
+#ifdef _WIN32
     if (processId && isRunning(processId)) {
         std::cout << "Warning: a chess engine/program (" << name << ", PID: " << processId << ") refused to stop. Try to kill!" << std::endl;
         TinyProcessLib::Process::kill(processId, true);
@@ -44,10 +52,40 @@ Engine::~Engine()
             pThread->join();
         }
     }
+#else
+    std::lock_guard<std::mutex> dolock(processMutex);
+    if (process) {
+        if (isRunning(processId)) {
+            std::cout << "Warning: a chess engine/program (" << name << ", PID: " << processId << ") refused to stop. Try to kill!" << std::endl;
+            TinyProcessLib::Process::kill(processId, true);
+        }
+        
+        // give it a moment to avoid leaving a zombie
+        int exitStatus;
+        for(int i = 0; i < 20 && !process->try_get_exit_status(exitStatus); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        delete process;
+        process = nullptr;
+    }
+    
+    if (exitedProcess) {
+        delete exitedProcess;
+        exitedProcess = nullptr;
+    }
+#endif
 }
 
 void Engine::tickWork()
 {
+#ifndef _WIN32
+    // the engine closed its pipes but was still running at that time
+    if (pipeClosed && process) {
+        std::lock_guard<std::mutex> dolock(processMutex);
+        checkExited();
+    }
+#endif
+    
     if (state == PlayerState::stopped) {
         return;
     }
@@ -69,7 +107,13 @@ void Engine::tickWork()
         tick_being_kill--;
         if (tick_being_kill == 0) {
             TinyProcessLib::Process::kill(processId, true);
+#ifdef _WIN32
             process = nullptr;
+#else
+            std::lock_guard<std::mutex> dolock(processMutex);
+            exitedProcess = process;
+            process = nullptr;
+#endif
             setState(PlayerState::stopped);
             finished();
         }
@@ -134,47 +178,67 @@ void Engine::read_stderr(const char *bytes, size_t n)
 void Engine::read_stdout(const char *bytes, size_t n)
 {
     // check before use since it may be being deleted
-    if (!isAttached() || n <= 0) {
+    if ((!isAttached() && !pooled) || n <= 0) {
         return;
     }
     
-    std::vector<std::string> vec;
+    // a bestmove is timed here, not after parsing
+    lastReadClock = std::chrono::steady_clock::now();
+    i64 lineCnt = 0;
+    
+    // complete lines are parsed straight from the read buffer, only a line
+    // split between two reads is kept (in a buffer whose capacity is reused)
     size_t k = 0;
     for (size_t i = 0; i < n; i++) {
-        if (bytes[i] == '\n') {
-            std::string str;
-            if (vec.empty()) {
-                str += lastIncompletedStdout;
-                lastIncompletedStdout = "";
-            }
-            
-            if (i > k) {
-                str += std::string(bytes + k, i + 1 - k);
-            }
-            
-            std::replace(str.begin(), str.end(), '\t', ' ');
-            trim(str);
-            if (!str.empty()) {
-                vec.push_back(str);
-            }
-            
-            k = i + 1;
+        if (bytes[i] != '\n') {
+            continue;
+        }
+        
+        if (lastIncompletedStdout.empty()) {
+            parseLine(bytes + k, i - k);
+        } else {
+            lastIncompletedStdout.append(bytes + k, i - k);
+            parseLine(lastIncompletedStdout.c_str(), lastIncompletedStdout.length());
+            lastIncompletedStdout.clear();
         }
+        k = i + 1;
+        lineCnt++;
     }
     
     if (k < n) {
-        lastIncompletedStdout += std::string(bytes + k, n - k);
+        lastIncompletedStdout.append(bytes + k, n - k);
+        
+        // something wrong, try to do
+        if (lastIncompletedStdout.length() > process_buffer_size) {
+            parseLine(lastIncompletedStdout.c_str(), lastIncompletedStdout.length());
+            lastIncompletedStdout.clear();
+            lineCnt++;
+        }
     }
     
-    // something wrong, try to do
-    if (vec.empty() && lastIncompletedStdout.length() > process_buffer_size) {
-        vec.push_back(lastIncompletedStdout);
+    Metrics::count(MetricCount::parsedLines, lineCnt);
+    Metrics::count(MetricCount::parsedBytes, i64(n));
+    Metrics::add(MetricHist::parse, lastReadClock, std::chrono::steady_clock::now());
+}
+
+void Engine::parseLine(const char* str, size_t len)
+{
+    // trim
+    while (len > 0 && isspace(static_cast<unsigned char>(*str))) {
+        str++; len--;
+    }
+    while (len > 0 && isspace(static_cast<unsigned char>(str[len - 1]))) {
+        len--;
     }
     
-    
-    for (auto && line : vec) {
-        parseLine(line);
+    if (len == 0) {
+        return;
     }
+    
+    // assign keeps the capacity, no allocation once the line is warmed up
+    lineString.assign(str, len);
+    std::replace(lineString.begin(), lineString.end(), '\t', ' ');
+    parseLine(lineString);
 }
 
 void Engine::parseLine(const std::string& line)
@@ -182,9 +246,9 @@ void Engine::parseLine(const std::string& line)
     log(line, LogType::fromEngine);
     
     auto p = line.find(' ');
-    auto cmdString = p == std::string::npos ? line : line.substr(0, p);
+    cmdString.assign(line, 0, p);
     
-    auto engineCmdMap = getEngineCmdMap();
+    auto& engineCmdMap = getEngineCmdMap();
     auto it = engineCmdMap.find(cmdString);
     if (it == engineCmdMap.end()) { // bad cmd
         parseLine(-1, cmdString, line);
@@ -195,24 +259,88 @@ void Engine::parseLine(const std::string& line)
     parseLine(it->second, cmdString, line);
 }
 
+void Engine::setState(PlayerState st)
+{
+    if (launching && st == PlayerState::ready) {
+        launching = false;
+        Metrics::add(MetricHist::engineStartup, launchClock, std::chrono::steady_clock::now());
+    }
+    Player::setState(st);
+}
+
 bool Engine::kickStart()
 {
     resetPing();
     
+    // a reused engine is initialized already, it gets ready once it answers isready
+    if (process && reuseCnt > 0) {
+        resetIdle();
+        return true;
+    }
+    
     if (process == nullptr) {
         setState(PlayerState::none);
+        launchClock = std::chrono::steady_clock::now();
+        launching = true;
         
 #if (defined _WIN32) && (defined UNICODE)
         std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
         auto command = converter.from_bytes(config.command);
         auto workingFolder = converter.from_bytes(config.workingFolder);
-#else
+#elif defined(_WIN32)
         auto command = config.command;
         auto workingFolder = config.workingFolder;
+#else
+        // the command runs by /bin/sh, exec replaces the shell thus processId is the engine's own
+        // one, for killing, cpu pinning and profiling
+        auto command = "exec " + config.command;
+        auto workingFolder = config.workingFolder;
 #endif
         
         assert(!command.empty());
         
+#ifndef _WIN32
+        {
+            std::lock_guard<std::mutex> dolock(processMutex);
+            if (exitedProcess) {
+                delete exitedProcess;
+                exitedProcess = nullptr;
+            }
+            
+            pipeClosed = false;
+            TinyProcessLib::Config config;
+            config.buffer_size = process_buffer_size;
+            config.on_close = [=]() {
+                pipeClosed = true;
+                // never block the shared reader thread, tickWork will retry
+                std::unique_lock<std::mutex> lock(processMutex, std::try_to_lock);
+                if (lock.owns_lock()) {
+                    checkExited();
+                }
+            };
+            
+            process = new TinyProcessLib::Process(
+                                                  command,
+                                                  workingFolder,
+                                                  [=](const char *bytes, size_t n) {
+                                                      read_stdout(bytes, n);
+                                                  }, [=](const char *bytes, size_t n) {
+                                                      read_stdout(bytes, n);
+                                                  },
+                                                  true, config);
+            processId = process->get_id();
+            applyCpuSet();
+            applyMemoryLimit();
+            setState(PlayerState::starting);
+            write(protocolString());
+        }
+        
+        // the engine may have exited before the process was stored
+        if (pipeClosed) {
+            std::lock_guard<std::mutex> dolock(processMutex);
+            checkExited();
+        }
+#else
         std::thread processThread([=]() {
             TinyProcessLib::Config config;
             config.buffer_size = process_buffer_size;
@@ -228,6 +356,8 @@ bool Engine::kickStart()
             
             processId = engineProcess.get_id();
             process = &engineProcess;
+            applyCpuSet();
+            applyMemoryLimit();
             setState(PlayerState::starting);
             write(protocolString());
 
@@ -244,6 +374,7 @@ bool Engine::kickStart()
         
         pThread = &processThread;
         processThread.detach();
+#endif
         return true;
     }
     
@@ -251,7 +382,25 @@ bool Engine::kickStart()
     return true;
 }
 
-void Engine::attach(ChessBoard* board, const GameTimeController* timeController, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)> moveFunc, std::function<void()> resignFunc)
+#ifndef _WIN32
+// processMutex must be locked
+bool Engine::checkExited()
+{
+    int exitStatus;
+    if (!pipeClosed || process == nullptr || !process->try_get_exit_status(exitStatus)) {
+        return false;
+    }
+    
+    // keep the object alive, other threads may still be writing to it
+    exitedProcess = process;
+    process = nullptr;
+    setState(PlayerState::stopped);
+    finished();
+    return true;
+}
+#endif
+
+void Engine::attach(ChessBoard* board, GameTimeController* timeController, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)> moveFunc, std::function<void()> resignFunc)
 {
     Player::attach(board, timeController, moveFunc, resignFunc);
     tick_deattach = -1;
@@ -267,6 +416,20 @@ bool Engine::isSafeToDeattach() const
     return computingState == EngineComputingState::idle || exited() || !isAttached() || tick_deattach == 0;
 }
 
+void Engine::applyCpuSet()
+{
+    if (!cpuSet.empty() && !CoreAllocator::apply(processId, cpuSet)) {
+        std::cerr << "Warning: can't pin " << name << " (PID: " << processId << ") to its CPUs" << std::endl;
+    }
+}
+
+void Engine::applyMemoryLimit()
+{
+    if (memoryLimit > 0 && !MemoryPlanner::applyLimit(processId, memoryLimit)) {
+        std::cerr << "Warning: can't limit the memory of " << name << " (PID: " << processId << ")" << std::endl;
+    }
+}
+
 bool Engine::isSafeToDelete() const
 {
     return process == nullptr;
@@ -286,12 +449,26 @@ bool Engine::write(const std::string& str)
 {
     if (state >= PlayerState::starting && state < PlayerState::stopped && process) {
         process->write(str + "\n");
+        lastWriteClock = std::chrono::steady_clock::now();
         log(str, LogType::toEngine);
         return true;
     }
     return false;
 }
 
+void Engine::startEngineClock()
+{
+    if (timeController) {
+        timeController->startEngineClock(lastWriteClock);
+    }
+}
+
+int64_t Engine::nodeLimit() const
+{
+    assert(timeController);
+    return std::max<int64_t>(1, std::llround(double(timeController->nodes) * config.nodesFactor));
+}
+
 bool Engine::sendQuit()
 {
     return write("quit");
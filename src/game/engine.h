@@ -28,6 +28,8 @@
 
 #include <vector>
 #include <set>
+#include <atomic>
+#include <chrono>
 
 #include "../3rdparty/process/process.hpp"
 #include "../chess/chess.h"
@@ -42,6 +44,8 @@ namespace banksia {
 
     class Engine : public Player
     {
+        friend class Bench;
+        
     protected:
         const int tick_period_ping = 30; // 20s
         const int tick_period_deattach = 6; // 3s
@@ -61,6 +65,7 @@ namespace banksia {
         void setMessageLogger(std::function<void(const std::string&, const std::string&, LogType logType)> messageLogger);
         
     public:
+        virtual void setState(PlayerState st) override;
         virtual bool kickStart() override;
         virtual bool stopThinking() override;
 
@@ -69,17 +74,23 @@ namespace banksia {
         virtual bool kill() override;
 
     public:
-        virtual void attach(ChessBoard*, const GameTimeController*, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)>, std::function<void()>) override;
+        virtual void attach(ChessBoard*, GameTimeController*, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)>, std::function<void()>) override;
 
         virtual bool isSafeToDeattach() const override;
         virtual bool isSafeToDelete() const;
 
+        // makes an idle engine ready for another game without restarting its process,
+        // false if it can't be reused (see PlayerMng)
+        virtual bool prepareForReuse() { return false; }
+        void setPooled(bool _pooled) { pooled = _pooled; }
+        
         virtual std::string protocolString() const = 0;
         virtual void parseLine(int, const std::string&, const std::string&) {}
         virtual const std::unordered_map<std::string, int>& getEngineCmdMap() const = 0;
 
     protected:
         virtual void parseLine(const std::string&);
+        void parseLine(const char* str, size_t len);
 
     protected:
         virtual void log(const std::string& line, LogType engineLog) const;
@@ -96,30 +107,64 @@ namespace banksia {
         void read_stderr(const char *bytes, size_t n);
         
         bool exited() const;
+        void applyCpuSet();
+        void applyMemoryLimit();
+        
+        // call right after writing a go (or ponderhit) command
+        void startEngineClock();
+        
+        // nodes per move of the time control, scaled for this engine
+        int64_t nodeLimit() const;
         
         virtual bool isIdleCrash() const;
 
         virtual void finished() {}
         virtual void tickPing();
         
+#ifndef _WIN32
+        bool checkExited();
+#endif
+        
     public:
-        EngineComputingState computingState = EngineComputingState::idle;
+        // read by the profile sampler thread too
+        std::atomic<EngineComputingState> computingState { EngineComputingState::idle };
         Config config;
+        int reuseCnt = 0; // games played after the first one, by the same process
+        std::vector<int> cpuSet; // logical CPUs the process is pinned to, empty for none
+        int memoryLimit = 0; // MB, the cap of the process, zero for none
         
     protected:
         bool write(const std::string&);
+        
+        // steady clocks of the last write to the engine and the last read from it
+        std::chrono::steady_clock::time_point lastWriteClock, lastReadClock;
+        
+        // the process has been launched but not ready yet
+        std::chrono::steady_clock::time_point launchClock;
+        bool launching = false;
+        
         int tick_deattach = -1;
         int tick_ping, tick_idle, tick_being_kill = -1; //, tick_stopping = 0;
         std::function<void(const std::string&, const std::string&, LogType)> messageLogger = nullptr;
 
         int correctCmdCnt = 0;
         TinyProcessLib::Process::id_type processId = 0;
+        
+        // kept by PlayerMng between games, its output is still read while not attached
+        std::atomic<bool> pooled { false };
 
     private:
         const int process_buffer_size = 16 * 1024;
-        std::string lastIncompletedStdout;
+        std::string lastIncompletedStdout, lineString, cmdString;
         TinyProcessLib::Process* process = nullptr;
+#ifdef _WIN32
         std::thread* pThread = nullptr;
+#else
+        // pipes are read by the shared reactor of TinyProcessLib, no thread per engine
+        TinyProcessLib::Process* exitedProcess = nullptr;
+        std::atomic<bool> pipeClosed { false };
+        std::mutex processMutex;
+#endif
     };
     
     
@@ -0,0 +1,180 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "enginecache.h"
+
+using namespace banksia;
+
+EngineFingerprint EngineFingerprint::create(const std::string& path, bool withHash)
+{
+    EngineFingerprint fingerprint;
+    fingerprint.size = getFileSize(path);
+    fingerprint.mtime = getFileTime(path);
+    if (withHash && fingerprint.isValid()) {
+        fingerprint.hash = hashFile(path);
+    }
+    return fingerprint;
+}
+
+// FNV-1a, 64 bits
+u64 EngineFingerprint::hashFile(const std::string& path)
+{
+    u64 hash = 14695981039346656037ULL;
+    
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile) {
+        return 0;
+    }
+    
+    char buf[64 * 1024];
+    while (inFile) {
+        inFile.read(buf, sizeof(buf));
+        auto n = inFile.gcount();
+        for(std::streamsize i = 0; i < n; i++) {
+            hash ^= static_cast<unsigned char>(buf[i]);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+bool EngineCache::isValid() const
+{
+    return true;
+}
+
+std::string EngineCache::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << "files: " << itemMap.size();
+    return stringStream.str();
+}
+
+bool EngineCache::loadFromJsonFile(const std::string& path)
+{
+    itemMap.clear();
+    
+    Json::Value jsonData;
+    if (!JsonSavable::loadFromJsonFile(path, jsonData, false) || !jsonData.isMember("files")) {
+        return false;
+    }
+    
+    const Json::Value& array = jsonData["files"];
+    for (int i = 0; i < int(array.size()); i++) {
+        auto v = array[i];
+        auto filePath = v["path"].asString();
+        if (filePath.empty()) {
+            continue;
+        }
+        
+        Item item;
+        item.fingerprint.size = v["size"].asInt64();
+        item.fingerprint.mtime = v["modified"].asInt64();
+        item.fingerprint.hash = std::strtoull(v["hash"].asString().c_str(), nullptr, 16);
+        item.isEngine = v.isMember("engine");
+        if (item.isEngine) {
+            item.config = v["engine"];
+        }
+        itemMap[filePath] = item;
+    }
+    return true;
+}
+
+bool EngineCache::saveToJsonFile(const std::string& path) const
+{
+    Json::Value array(Json::arrayValue);
+    for(auto && p : itemMap) {
+        auto& item = p.second;
+        if (!item.used) {
+            continue;
+        }
+        
+        std::ostringstream stringStream;
+        stringStream << std::hex << std::setw(16) << std::setfill('0') << item.fingerprint.hash;
+        
+        Json::Value v;
+        v["path"] = p.first;
+        v["size"] = Json::Int64(item.fingerprint.size);
+        v["modified"] = Json::Int64(item.fingerprint.mtime);
+        v["hash"] = stringStream.str();
+        if (item.isEngine) {
+            v["engine"] = item.config;
+        }
+        array.append(v);
+    }
+    
+    Json::Value jsonData;
+    jsonData["files"] = array;
+    return JsonSavable::saveToJsonFile(path, jsonData);
+}
+
+bool EngineCache::find(const std::string& path, bool& isEngine, Config* config)
+{
+    auto it = itemMap.find(path);
+    if (it == itemMap.end()) {
+        return false;
+    }
+    
+    auto& item = it->second;
+    auto fingerprint = EngineFingerprint::create(path, false);
+    if (!fingerprint.isValid() || fingerprint.size != item.fingerprint.size) {
+        return false;
+    }
+    
+    // touched or copied only, the same content is still the same engine
+    if (fingerprint.mtime != item.fingerprint.mtime) {
+        if (EngineFingerprint::hashFile(path) != item.fingerprint.hash) {
+            return false;
+        }
+        item.fingerprint.mtime = fingerprint.mtime;
+    }
+    
+    isEngine = item.isEngine;
+    if (isEngine && config && !config->load(item.config)) {
+        return false;
+    }
+    item.used = true;
+    return true;
+}
+
+void EngineCache::update(const std::string& path, const Config* config)
+{
+    auto fingerprint = EngineFingerprint::create(path, true);
+    if (!fingerprint.isValid()) {
+        return;
+    }
+    
+    Item item;
+    item.fingerprint = fingerprint;
+    item.isEngine = config != nullptr;
+    if (config) {
+        item.config = config->saveToJson();
+    }
+    item.used = true;
+    itemMap[path] = item;
+}
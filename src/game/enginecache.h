@@ -0,0 +1,82 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef enginecache_h
+#define enginecache_h
+
+#include <map>
+#include <string>
+
+#include "configmng.h"
+
+namespace banksia {
+    
+    // the identity of an executable file, the content hash is computed only when needed
+    class EngineFingerprint
+    {
+    public:
+        static EngineFingerprint create(const std::string& path, bool withHash);
+        static u64 hashFile(const std::string& path);
+        
+        bool isValid() const {
+            return size > 0;
+        }
+        
+    public:
+        i64 size = 0, mtime = 0;
+        u64 hash = 0;
+    };
+    
+    // Detection results of executable files (an engine config or not an engine), kept next to the
+    // engine configurations JSON file thus the files not changed since the last scan need no probe
+    class EngineCache : public Obj
+    {
+    private:
+        class Item
+        {
+        public:
+            EngineFingerprint fingerprint;
+            bool isEngine = false, used = false; // used: found or probed in this scan, others are dropped
+            Json::Value config;
+        };
+        
+    public:
+        virtual const char* className() const override { return "EngineCache"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+
+        bool loadFromJsonFile(const std::string& path);
+        bool saveToJsonFile(const std::string& path) const;
+        
+        // true if the file has the same content as when it was probed, config is set for engines only
+        bool find(const std::string& path, bool& isEngine, Config* config);
+        void update(const std::string& path, const Config* config);
+        
+    private:
+        std::map<std::string, Item> itemMap;
+    };
+    
+} // namespace banksia
+
+#endif /* enginecache_h */
@@ -26,6 +26,8 @@
 #include <sstream>
 #include <algorithm>
 #include <iomanip> // for setprecision
+#include <fstream>
+#include <chrono>
 
 #ifdef _WIN32
 
@@ -35,8 +37,16 @@
 #include <psapi.h>
 #include <tlhelp32.h>
 
+#elif defined(__APPLE__)
+
+#include <unistd.h>
+#include <libproc.h>
+#include <mach/mach_time.h>
+
 #else
 
+#include <unistd.h>
+
 #endif
 
 #include "engineprofile.h"
@@ -50,13 +60,15 @@ std::string Profile::toString(bool lastReport) const
 	auto mem = int(memTotal / (std::max<u64>(1, memCall) * 1024 * 1024));
 	auto maxmem = int(memMax / (1024 * 1024));
 	auto threads = int(threadTotal / std::max<u64>(1, threadCall));
+	auto switches = int((switchVoluntary + switchNonvoluntary) * 1000 / std::max<u64>(1, switchTime));
+	auto nonvoluntary = int(switchNonvoluntary * 1000 / std::max<u64>(1, switchTime));
 	std::ostringstream stringStream;
 	stringStream.precision(1);
 	stringStream << std::fixed;
 
 	const int pw = 7;
 
-	// cpu, thinking cpu, mem, max mem, #thread
+	// cpu, thinking cpu, mem, max mem, #thread, context switches per second
 	if (lastReport) {
 		stringStream
 			<< std::right << std::setw(pw) << cpu
@@ -64,7 +76,9 @@ std::string Profile::toString(bool lastReport) const
 			<< std::right << std::setw(pw) << mem
 			<< std::right << std::setw(pw) << maxmem
 			<< std::right << std::setw(pw) << threads
-			<< std::right << std::setw(pw) << threadMax;
+			<< std::right << std::setw(pw) << threadMax
+			<< std::right << std::setw(pw) << switches
+			<< std::right << std::setw(pw) << nonvoluntary;
 	}
 	else {
 		stringStream
@@ -73,7 +87,9 @@ std::string Profile::toString(bool lastReport) const
 			<< ", mem(MB): " << mem
 			<< ", max: " << maxmem
 			<< ", threads: " << threads
-			<< ", max: " << threadMax;
+			<< ", max: " << threadMax
+			<< ", csw/s: " << switches
+			<< ", nonvoluntary: " << nonvoluntary;
 	}
 
 	return stringStream.str();
@@ -91,138 +107,340 @@ void Profile::addFrom(const Profile& o)
 	threadCall += o.threadCall;
 	memMax = std::max(memMax, o.memMax);
 	threadMax = std::max(threadMax, o.threadMax);
+	switchVoluntary += o.switchVoluntary;
+	switchNonvoluntary += o.switchNonvoluntary;
+	switchTime += o.switchTime;
 }
 
 //////////////////////////////////////////
 EngineProfile::EngineProfile()
 	: Engine()
 {
-#ifdef _WIN32
-	resetProfile();
-#endif
+	if (ProfileSampler::instance) {
+		ProfileSampler::instance->add(this);
+	}
 }
+
 EngineProfile::EngineProfile(const Config& config)
 	: Engine(config)
 {
-#ifdef _WIN32
-	resetProfile();
-#endif
+	if (ProfileSampler::instance) {
+		ProfileSampler::instance->add(this);
+	}
 }
 
 EngineProfile::~EngineProfile()
 {
+	// waits if the sampler is working with this engine
+	if (ProfileSampler::instance) {
+		ProfileSampler::instance->remove(this);
+	}
 }
 
-#ifdef _WIN32
-
-void EngineProfile::resetProfile()
+Profile EngineProfile::takeProfile()
 {
-	ZeroMemory(&m_ftPrevSysKernel, sizeof(FILETIME));
-	ZeroMemory(&m_ftPrevSysUser, sizeof(FILETIME));
-	ZeroMemory(&m_ftPrevProcKernel, sizeof(FILETIME));
-	ZeroMemory(&m_ftPrevProcUser, sizeof(FILETIME));
+	std::lock_guard<std::mutex> dolock(profileMutex);
+	auto r = profile;
+	profile.reset();
+	return r;
 }
 
+#ifdef _WIN32
 
-u64 subtractTimes(const FILETIME& ftA, const FILETIME& ftB)
+static u64 fileTime2Int(const FILETIME& ft)
 {
-	LARGE_INTEGER a, b;
-	a.LowPart = ftA.dwLowDateTime;
-	a.HighPart = ftA.dwHighDateTime;
+	LARGE_INTEGER a;
+	a.LowPart = ft.dwLowDateTime;
+	a.HighPart = ft.dwHighDateTime;
+	return a.QuadPart;
+}
 
-	b.LowPart = ftB.dwLowDateTime;
-	b.HighPart = ftB.dwHighDateTime;
+#elif defined(__APPLE__)
 
-	return a.QuadPart - b.QuadPart;
+static u64 machTime2Ns(u64 t)
+{
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return t * timebase.numer / timebase.denom;
 }
 
-void EngineProfile::tickWork()
-{
-	Engine::tickWork();
+#endif
 
-	if (!profileMode || state == PlayerState::stopped || processId == 0) {
+void EngineProfile::sample(const ProfileSystemSample& system)
+{
+	if (state == PlayerState::stopped || processId == 0) {
+		prevSysTime = prevSwitchTime = 0;
 		return;
 	}
 
-	tickCnt++;
+	u64 procTime = 0, mem = 0;
+	int threadCnt = -1;
+	// voluntary, nonvoluntary; not read on Windows
+	u64 switches[2] = { 0, 0 };
+	auto switchOk = false;
 
-	{
-		// then get a process list snapshot.
-		HANDLE const  snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPALL, 0);
-
-		// initialize the process entry structure.
-		PROCESSENTRY32 entry = { 0 };
-		entry.dwSize = sizeof(entry);
-
-		// get the first process info.
-		BOOL  ret = true;
-		ret = Process32First(snapshot, &entry);
-		while (ret && entry.th32ProcessID != processId) {
-			ret = Process32Next(snapshot, &entry);
-		}
-		CloseHandle(snapshot);
-		if (ret) {
-			profile.threadTotal += entry.cntThreads;
-			profile.threadCall++;
-			if (profile.threadMax < int(entry.cntThreads))
-				profile.threadMax = entry.cntThreads;
-		}
+#ifdef _WIN32
+	auto it = system.threadMap.find(processId);
+	if (it != system.threadMap.end()) {
+		threadCnt = it->second;
 	}
 
-
-	/////
-
-	auto hProcess = OpenProcess(PROCESS_QUERY_INFORMATION |
-		PROCESS_VM_READ,
-		FALSE, processId);
+	auto hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
 	if (nullptr == hProcess)
 		return;
 
-	if ((tickCnt & 0x1) == 0) {
-		PROCESS_MEMORY_COUNTERS_EX pmc;
-		GetProcessMemoryInfo(hProcess, (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc));
-		profile.memTotal += pmc.PrivateUsage;
-		profile.memMax = std::max(profile.memMax, int(pmc.PrivateUsage));
-		profile.memCall++;
+	PROCESS_MEMORY_COUNTERS_EX pmc;
+	if (GetProcessMemoryInfo(hProcess, (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
+		mem = pmc.PrivateUsage;
 	}
 
-	FILETIME ftSysIdle, ftSysKernel, ftSysUser;
 	FILETIME ftProcCreation, ftProcExit, ftProcKernel, ftProcUser;
+	auto ok = GetProcessTimes(hProcess, &ftProcCreation, &ftProcExit, &ftProcKernel, &ftProcUser);
+	CloseHandle(hProcess);
+	if (!ok) {
+		return;
+	}
+	procTime = fileTime2Int(ftProcKernel) + fileTime2Int(ftProcUser);
 
-	if (!GetSystemTimes(&ftSysIdle, &ftSysKernel, &ftSysUser) ||
-		!GetProcessTimes(hProcess, &ftProcCreation, &ftProcExit, &ftProcKernel, &ftProcUser))
-	{
+#elif defined(__APPLE__)
+	struct proc_taskinfo ti;
+	if (proc_pidinfo(processId, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) != int(sizeof(ti))) {
 		return;
 	}
+	procTime = machTime2Ns(ti.pti_total_user + ti.pti_total_system);
+	mem = ti.pti_resident_size;
+	threadCnt = ti.pti_threadnum;
+	// one counter for both kinds
+	switches[0] = u64(ti.pti_csw);
+	switchOk = true;
 
-	if (m_ftPrevSysKernel.dwLowDateTime)
-	{
-		/*
-		 CPU usage is calculated by getting the total amount of time the system has operated
-		 since the last measurement (made up of kernel + user) and the total
-		 amount of time the process has run (kernel + user).
-		 */
-		auto timeCnt = subtractTimes(ftSysKernel, m_ftPrevSysKernel) + subtractTimes(ftSysUser, m_ftPrevSysUser);
-		auto proCnt = subtractTimes(ftProcKernel, m_ftPrevProcKernel) + subtractTimes(ftProcUser, m_ftPrevProcUser);
+#else
+	// all needed fields are in one line: utime (14), stime (15), num_threads (20), rss (24)
+	std::ifstream ifs("/proc/" + std::to_string(processId) + "/stat");
+	std::string line;
+	if (!std::getline(ifs, line)) {
+		return;
+	}
+	// the name (field 2) may have spaces, the fields are counted from its closing bracket
+	auto p = line.rfind(')');
+	if (p == std::string::npos) {
+		return;
+	}
+	std::istringstream iss(line.substr(p + 1));
+	std::vector<std::string> vec;
+	for (std::string str; iss >> str; ) {
+		vec.push_back(str);
+	}
+	if (vec.size() < 22) {
+		return;
+	}
+	procTime = std::stoull(vec.at(11)) + std::stoull(vec.at(12));
+	threadCnt = std::atoi(vec.at(17).c_str());
+	static const u64 pageSize = u64(sysconf(_SC_PAGESIZE));
+	mem = std::stoull(vec.at(21)) * pageSize;
+
+	// the switch counters are in status only, near its end
+	std::ifstream statusStream("/proc/" + std::to_string(processId) + "/status");
+	auto found = 0;
+	while (found < 2 && std::getline(statusStream, line)) {
+		auto k = line.find("voluntary_ctxt_switches:");
+		if (k == 0 || k == 3) { // voluntary_ or nonvoluntary_
+			switches[k ? 1 : 0] = std::strtoull(line.c_str() + line.find(':') + 1, nullptr, 10);
+			found++;
+		}
+	}
+	switchOk = found == 2;
+#endif
+
+	std::lock_guard<std::mutex> dolock(profileMutex);
+
+	if (threadCnt >= 0) {
+		profile.threadTotal += threadCnt;
+		profile.threadCall++;
+		profile.threadMax = std::max(profile.threadMax, threadCnt);
+	}
+
+	if (mem) {
+		profile.memTotal += mem;
+		profile.memMax = std::max(profile.memMax, mem);
+		profile.memCall++;
+	}
+
+	/*
+	 CPU usage is calculated by getting the total amount of time the system has operated
+	 since the last measurement and the total amount of time the process has run
+	 */
+	EngineComputingState curComputingState = computingState;
+	if (prevSysTime && system.sysTime > prevSysTime && procTime >= prevProcTime) {
+		auto timeCnt = system.sysTime - prevSysTime;
+		auto proCnt = procTime - prevProcTime;
 
 		profile.cpuTime += timeCnt;
 		profile.cpuTotal += proCnt;
 
-		if (computingState == EngineComputingState::thinking && prevComputingState == EngineComputingState::thinking) {
+		if (curComputingState == EngineComputingState::thinking && prevComputingState == EngineComputingState::thinking) {
 			profile.cpuThinkingTime += timeCnt;
 			profile.cpuThinkingTotal += proCnt;
 		}
-		prevComputingState = computingState;
 	}
+	prevComputingState = curComputingState;
 
-	m_ftPrevSysKernel = ftSysKernel;
-	m_ftPrevSysUser = ftSysUser;
-	m_ftPrevProcKernel = ftProcKernel;
-	m_ftPrevProcUser = ftProcUser;
+	prevSysTime = system.sysTime;
+	prevProcTime = procTime;
 
-	CloseHandle(hProcess);
+	if (switchOk) {
+		auto now = u64(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		if (prevSwitchTime && switches[0] >= prevSwitches[0] && switches[1] >= prevSwitches[1]) {
+			profile.switchVoluntary += switches[0] - prevSwitches[0];
+			profile.switchNonvoluntary += switches[1] - prevSwitches[1];
+			profile.switchTime += now - prevSwitchTime;
+		}
+		prevSwitches[0] = switches[0];
+		prevSwitches[1] = switches[1];
+		prevSwitchTime = now;
+	}
 }
 
+//////////////////////////////////////////
+ProfileSampler* ProfileSampler::instance = nullptr;
 
+ProfileSampler::ProfileSampler()
+{
+}
+
+ProfileSampler::~ProfileSampler()
+{
+	shutdown();
+	if (instance == this) {
+		instance = nullptr;
+	}
+}
+
+void ProfileSampler::start(int _intervalMs)
+{
+	if (running) {
+		return;
+	}
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
+	intervalMs = std::max(10, _intervalMs);
+	running = true;
+	// the first started one samples engines of all tournaments of a batch
+	if (!instance) {
+		instance = this;
+	}
+	pThread = new std::thread([=]() { run(); });
 #endif
+}
+
+void ProfileSampler::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> dolock(waitMutex);
+		if (!running) {
+			return;
+		}
+		running = false;
+	}
+	waitCondition.notify_one();
+
+	if (pThread) {
+		if (pThread->joinable()) {
+			pThread->join();
+		}
+		delete pThread;
+		pThread = nullptr;
+	}
+}
+
+void ProfileSampler::add(EngineProfile* engine)
+{
+	std::lock_guard<std::mutex> dolock(engineMutex);
+	engineList.push_back(engine);
+}
 
+void ProfileSampler::remove(EngineProfile* engine)
+{
+	std::lock_guard<std::mutex> dolock(engineMutex);
+	auto it = std::find(engineList.begin(), engineList.end(), engine);
+	if (it != engineList.end()) {
+		engineList.erase(it);
+	}
+}
+
+void ProfileSampler::run()
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(waitMutex);
+			waitCondition.wait_for(lock, std::chrono::milliseconds(intervalMs), [&]() {
+				return !running;
+			});
+		}
+
+		if (!running) {
+			break;
+		}
+		sampleAll();
+	}
+}
+
+void ProfileSampler::sampleAll()
+{
+	ProfileSystemSample system;
+	if (!sampleSystem(system)) {
+		return;
+	}
+
+	// engines can't be deleted while being sampled
+	std::lock_guard<std::mutex> dolock(engineMutex);
+	for (auto && engine : engineList) {
+		engine->sample(system);
+	}
+}
+
+bool ProfileSampler::sampleSystem(ProfileSystemSample& system)
+{
+#ifdef _WIN32
+	FILETIME ftSysIdle, ftSysKernel, ftSysUser;
+	if (!GetSystemTimes(&ftSysIdle, &ftSysKernel, &ftSysUser)) {
+		return false;
+	}
+	// kernel time includes idle time
+	system.sysTime = fileTime2Int(ftSysKernel) + fileTime2Int(ftSysUser);
+
+	// one snapshot for all engines
+	HANDLE const snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		return true;
+	}
+	PROCESSENTRY32 entry = { 0 };
+	entry.dwSize = sizeof(entry);
+	for (auto ret = Process32First(snapshot, &entry); ret; ret = Process32Next(snapshot, &entry)) {
+		system.threadMap[entry.th32ProcessID] = int(entry.cntThreads);
+	}
+	CloseHandle(snapshot);
+	return true;
+
+#elif defined(__APPLE__)
+	// wall time of all cores, in nanoseconds as the process times
+	static const u64 coreCnt = std::max<u64>(1, sysconf(_SC_NPROCESSORS_ONLN));
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	system.sysTime = u64(ns) * coreCnt;
+	return true;
+
+#else
+	// the first line sums all cores, in clock ticks as the process times
+	std::ifstream ifs("/proc/stat");
+	std::string name;
+	if (!(ifs >> name) || name != "cpu") {
+		return false;
+	}
+	u64 t;
+	for (int i = 0; i < 8 && ifs >> t; i++) {
+		system.sysTime += t;
+	}
+	return system.sysTime > 0;
+#endif
+}
@@ -27,6 +27,12 @@
 #define memcpu_h
 
 #include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
 #include "../base/comm.h"
 #include "engine.h"
 
@@ -48,7 +54,10 @@ namespace banksia {
         u64 cpuThinkingTotal = 0, cpuThinkingTime = 0;
         u64 memTotal = 0, memCall = 0;
         u64 threadTotal = 0, threadCall = 0;
-        int memMax = 0, threadMax = 0;
+        u64 memMax = 0;
+        int threadMax = 0;
+        // context switches over switchTime (ms of wall time), macOS counts all as voluntary
+        u64 switchVoluntary = 0, switchNonvoluntary = 0, switchTime = 0;
         
         //static std::string memSizeString(u64 memSize);
         std::string toString(bool lastReport) const;
@@ -63,6 +72,16 @@ namespace banksia {
         void addFrom(const Profile& o);
     };
     
+    // what the sampler reads once per round and shares for all engines
+    class ProfileSystemSample {
+    public:
+        // cpu time of the whole system (all cores), same unit as the process times
+        u64 sysTime = 0;
+        
+        // Windows: thread counts from one process snapshot
+        std::unordered_map<u64, int> threadMap;
+    };
+    
     class EngineProfile : public Engine
     {
     public:
@@ -71,31 +90,57 @@ namespace banksia {
 
         virtual ~EngineProfile();
         
+        // returns what has been sampled since the last call
+        Profile takeProfile();
+        
+        // called by the profile sampler thread
+        void sample(const ProfileSystemSample& system);
+        
+    private:
         Profile profile;
-
-#ifdef _WIN32
-        virtual void tickWork() override;
-
+        std::mutex profileMutex;
+        
+        u64 prevSysTime = 0, prevProcTime = 0;
+        u64 prevSwitches[2] = { 0, 0 }, prevSwitchTime = 0;
+        EngineComputingState prevComputingState = EngineComputingState::idle;
+    };
+    
+    // One thread samples all engines at a fixed interval. It works only when profile mode is on,
+    // engines register with the first started one, tournaments start it before creating engines
+    class ProfileSampler
+    {
+    public:
+        ProfileSampler();
+        ~ProfileSampler();
+        
+        static ProfileSampler* instance;
+        
+        void start(int intervalMs);
+        void shutdown();
+        
+        void add(EngineProfile* engine);
+        void remove(EngineProfile* engine);
+        
     private:
-        void resetProfile();
-
-        //system total times
-		FILETIME m_ftPrevSysKernel;
-		FILETIME m_ftPrevSysUser;
+        ProfileSampler(const ProfileSampler&) = delete;
+        ProfileSampler& operator = (const ProfileSampler&) = delete;
         
-        //process times
-		FILETIME m_ftPrevProcKernel;
-		FILETIME m_ftPrevProcUser;
+        void run();
+        void sampleAll();
+        static bool sampleSystem(ProfileSystemSample& system);
         
-        EngineComputingState prevComputingState = EngineComputingState::idle;
-#endif
+        std::vector<EngineProfile*> engineList;
+        std::mutex engineMutex;
+        
+        std::atomic<bool> running { false };
+        int intervalMs = 500;
         
-	private:
-        i64 tickCnt = 0;
+        std::mutex waitMutex;
+        std::condition_variable waitCondition;
+        std::thread* pThread = nullptr;
     };
     
 } // namespace banksia
 
 
 #endif /* memcpu_h */
-
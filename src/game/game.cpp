@@ -30,6 +30,8 @@
 #include "game.h"
 #include "engine.h"
 #include "tourmng.h"
+#include "scheduler.h"
+#include "../base/metrics.h"
 
 using namespace banksia;
 
@@ -37,15 +39,41 @@ Game::Game()
 {
     state = GameState::none;
     players[0] = players[1] = nullptr;
+    board.reserve(typical_game_ply);
 }
 
 Game::Game(Player* player0, Player* player1, const TimeController& timeController, const GameConfig& gameConfig)
 : state(GameState::none), gameConfig(gameConfig)
 {
     players[0] = players[1] = nullptr;
+    board.reserve(typical_game_ply);
     set(player0, player1, timeController);
 }
 
+void Game::reset(const GameConfig& _gameConfig)
+{
+    assert(players[0] == nullptr && players[1] == nullptr);
+    
+    gameConfig = _gameConfig;
+    state = GameState::none;
+    stateTick = openingPly = 0;
+    standbyMode = false;
+    messageLogger = nullptr;
+    syzygyProbe.reset();
+    
+    startFen.clear();
+    startMoves.clear();
+    
+    PlayerMessage msg;
+    for(int sd = 0; sd < 2; sd++) {
+        while (mailboxes[sd].pop(msg)) {}
+    }
+    timeController.lastQueryConsumed = timeController.lastMoveOverhead = 0;
+    
+    // newGame sets the board up again, the result is of the game only
+    board.result.reset();
+}
+
 Game::~Game()
 {
 }
@@ -64,8 +92,9 @@ void Game::setState(GameState st)
 {
     if (state != st) {
         stateTick = 0;
+        state = st;
+        EventScheduler::post();
     }
-    state = st;
 }
 
 void Game::setStartup(int _idx, const std::string& _startFen, const std::vector<Move>& _startMoves)
@@ -108,12 +137,25 @@ void Game::attachPlayer(Player* player, Side side)
     players[sd] = player;
     
     player->setPonderMode(gameConfig.ponderMode);
+    // called on the reader thread of the engine, the game handles them in update
     player->attach(&board, &timeController,
                    [=](const Move& move, const std::string& moveString, const Move& ponderMove, double timeConsumed, EngineComputingState state) {
-                       moveFromPlayer(move, moveString, ponderMove, timeConsumed, side, state);
+                       PlayerMessage msg;
+                       msg.move = move;
+                       msg.ponderMove = ponderMove;
+                       msg.moveString = moveString;
+                       msg.timeConsumed = timeConsumed;
+                       msg.oldState = state;
+                       if (!mailboxes[sd].push(std::move(msg))) {
+                           std::cerr << "Warning: too many moves from " << player->getName() << ", dropped " << moveString << std::endl;
+                       }
+                       EventScheduler::post();
                    },
                    [=]() {
-                       gameOver(BoardCore::getXSide(board.side), ReasonType::resign);
+                       PlayerMessage msg;
+                       msg.resign = true;
+                       mailboxes[sd].push(std::move(msg));
+                       EventScheduler::post();
                    }
                    );
 }
@@ -141,6 +183,7 @@ void Game::kickStart()
 void Game::newGame()
 {
     // Include opening
+    syzygyProbe.reset();
     board.newGame(startFen);
     
     timeController.setupClocksBeforeThinking(0);
@@ -153,8 +196,14 @@ void Game::newGame()
                 break;
             }
         }
-        board.histList.back().comment = "End of opening";
+        if (!board.histList.empty()) {
+            board.getNote(board.histList.size() - 1).comment = "End of opening";
+            // Winboard engines are sent the opening as SANs after the pong of their new
+            // game ping, on their reader threads, they only read the notes made here
+            board.getSan(board.histList.size() - 1);
+        }
     }
+    openingPly = int(board.histList.size());
     
     for(int i = 0; i < 2; i++) {
         if (players[i]) {
@@ -183,16 +232,30 @@ void Game::stop()
 {
 }
 
+void Game::processMailboxes()
+{
+    PlayerMessage msg;
+    for(int sd = 0; sd < 2; sd++) {
+        auto side = static_cast<Side>(sd);
+        while (mailboxes[sd].pop(msg)) {
+            if (!msg.resign) {
+                moveFromPlayer(msg.move, msg.moveString, msg.ponderMove, msg.timeConsumed, side, msg.oldState);
+            } else if (state == GameState::playing) {
+                gameOver(BoardCore::getXSide(side), ReasonType::resign);
+            }
+        }
+    }
+}
+
 void Game::moveFromPlayer(const Move& move, const std::string& moveString, const Move& ponderMove, double timeConsumed, Side side, EngineComputingState oldState)
 {
+    // moves of stopped engines come after their games or turns
     if (state != GameState::playing || board.side != side) {
         return;
     }
     
-    // avoid conflicting between this function and one called by tickWork
-    std::lock_guard<std::mutex> dolock(criticalMutex);
-    
-    if (state != GameState::playing || checkTimeOver() || board.side != side) {
+    // a move is judged by the time it was read, not by when the mailbox was drained
+    if (checkTimeOver(oldState == EngineComputingState::thinking ? timeConsumed : -1)) {
         (messageLogger)(getAppName(), "TimeOver for " + move.toString(), LogType::system);
         return;
     }
@@ -204,25 +267,33 @@ void Game::moveFromPlayer(const Move& move, const std::string& moveString, const
         if (make(move, moveString)) {
             assert(board.side != side);
             
-            auto& lastHist = board.histList.back();
-            lastHist.elapsed = timeConsumed;
-            lastHist.score = players[sd]->getScore();
-            lastHist.depth = players[sd]->getDepth();
-            lastHist.nodes = players[sd]->getNodes();
-            timeController.udateClockAfterMove(timeConsumed, lastHist.move.piece.side, int(board.histList.size()));
+            auto& lastNote = board.getNote(board.histList.size() - 1);
+            lastNote.elapsed = timeConsumed;
+            lastNote.overhead = timeController.lastMoveOverhead;
+            timeController.udateClockAfterMove(timeConsumed, board.histList.back().move.piece().side, int(board.histList.size()));
             
             startThinking(gameConfig.ponderMode ? ponderMove : Move::illegalMove);
         }
     } else if (oldState == EngineComputingState::pondering) { // missed ponderhit, stop called
         players[sd]->go();
     }
+    
+    // the side to move and its deadline have changed
+    EventScheduler::post();
 }
 
 bool Game::make(const Move& move, const std::string& moveString)
 {
+    auto clock0 = std::chrono::steady_clock::now();
+    auto sd = static_cast<int>(board.side);
     if (board.checkMake(move.from, move.dest, move.promotion)) {
         assert(ChessBoard::isValidPromotion(move.promotion));
+        // the score is needed for adjudicating right below
+        board.getNote(board.histList.size() - 1).info = players[sd]->getInfo();
+        auto clock1 = std::chrono::steady_clock::now();
         auto result = board.rule();
+        Metrics::add(MetricHist::checkMake, clock0, clock1);
+        Metrics::add(MetricHist::rule, clock1, std::chrono::steady_clock::now());
         if (result.result != ResultType::noresult) {
             gameOver(result);
             return false;
@@ -236,24 +307,20 @@ bool Game::make(const Move& move, const std::string& moveString)
             }
             
             if (gameConfig.adjudicationEgtbMode) {
-                bool tberror;
-                auto result = board.probeSyzygy(gameConfig.adjudicationMaxPieces, tberror);
-                if (result.result == ResultType::noresult) {
-                    if (tberror && !board.histList.back().cap.isEmpty()) { // make message only for capture moves to avoid too many
-                        auto msg = "Error: unable to probe tablebase, position invalid, illegal or not in tablebase";
-                        (messageLogger)(getAppName(), msg, LogType::system);
-                    }
-                } else {
-                    gameOver(result);
+                probeSyzygy();
+                if (checkSyzygyResult()) {
                     return false;
                 }
             }
+            
+            if (checkScoreAdjudication()) {
+                return false;
+            }
         }
         
         assert(board.isValid());
         
-        auto sanMoveString = board.histList.back().moveString;
-        players[static_cast<int>(board.side)]->oppositeMadeMove(move, sanMoveString);
+        players[static_cast<int>(board.side)]->oppositeMadeMove(move);
         return true;
     } else {
         auto playerName = players[static_cast<int>(board.side)]->getName();
@@ -265,6 +332,98 @@ bool Game::make(const Move& move, const std::string& moveString)
     return false;
 }
 
+// Both engines must agree for their last moves, scores are turned into the view of white.
+// A move without a score (from a book or an engine not sending it) breaks the run
+bool Game::checkScoreAdjudication()
+{
+    auto n = int(board.histList.size());
+    auto resignPlies = gameConfig.adjudicationResignMoves * 2;
+    auto drawPlies = n >= gameConfig.adjudicationDrawStartPly ? gameConfig.adjudicationDrawMoves * 2 : 0;
+    
+    auto resign = resignPlies > 0 && n >= resignPlies, draw = drawPlies > 0 && n >= drawPlies;
+    auto winner = Side::none;
+    
+    for(int i = 0, k = std::max(resignPlies, drawPlies); i < k && (resign || draw); i++) {
+        auto ply = n - 1 - i;
+        auto& info = board.findNote(ply).info;
+        auto scored = info.depth > 0 || info.nodes > 0 || info.mate != 0;
+        auto score = board.histList[ply].move.piece().side == Side::white ? info.score : -info.score;
+        
+        if (i < drawPlies && (!scored || std::abs(score) > gameConfig.adjudicationDrawScore)) {
+            draw = false;
+        }
+        if (i < resignPlies) {
+            auto sd = !scored ? Side::none : score >= gameConfig.adjudicationResignScore ? Side::white : score <= -gameConfig.adjudicationResignScore ? Side::black : Side::none;
+            if (sd == Side::none || (i > 0 && sd != winner)) {
+                resign = false;
+            }
+            winner = sd;
+        }
+    }
+    
+    if (resign) {
+        gameOver(winner, ReasonType::adjudication);
+        return true;
+    }
+    if (draw) {
+        gameOver(Result(ResultType::draw, ReasonType::adjudication));
+        return true;
+    }
+    return false;
+}
+
+void Game::probeSyzygy()
+{
+    if (syzygyProbe && !syzygyProbe->done) {
+        return;
+    }
+    
+    auto probe = std::make_shared<SyzygyProbe>();
+    if (!board.toSyzygyPos(gameConfig.adjudicationMaxPieces, probe->pos)) {
+        return;
+    }
+    probe->key = board.key();
+    probe->ply = board.histList.size();
+    syzygyProbe = probe;
+    
+    if (!SyzygyProber::instance) {
+        probe->result = ChessBoard::probeSyzygy(probe->pos, probe->tberror);
+        probe->done = true;
+    } else {
+        SyzygyProber::instance->probe(probe);
+    }
+}
+
+// Applies a finished probe. The game may have gone on meanwhile, it is cut back
+// to the probed position as it would have ended there
+bool Game::checkSyzygyResult()
+{
+    if (!syzygyProbe || !syzygyProbe->done) {
+        return false;
+    }
+    
+    auto probe = syzygyProbe;
+    syzygyProbe.reset();
+    
+    if (probe->ply > board.histList.size()) {
+        return false;
+    }
+    
+    if (probe->result.result == ResultType::noresult) {
+        if (probe->tberror && probe->ply > 0 && !board.histList[probe->ply - 1].cap.isEmpty()) { // make message only for capture moves to avoid too many
+            auto msg = "Error: unable to probe tablebase, position invalid, illegal or not in tablebase";
+            (messageLogger)(getAppName(), msg, LogType::system);
+        }
+        return false;
+    }
+    
+    while (board.histList.size() > probe->ply) {
+        board.takeBack();
+    }
+    gameOver(probe->result);
+    return true;
+}
+
 void Game::gameOver(Side winner, ReasonType reasonType)
 {
     Result result(winner == Side::white ? ResultType::win : ResultType::loss, reasonType);
@@ -306,9 +465,9 @@ std::string Game::getGameTitleString(bool includeResult) const
     return str;
 }
 
-bool Game::checkTimeOver()
+bool Game::checkTimeOver(double consumed)
 {
-    if (timeController.isTimeOver(board.side)) {
+    if (timeController.isTimeOver(board.side, consumed)) {
         // Report more detail
         if (messageLogger) {
             std::ostringstream stringStream;
@@ -339,9 +498,23 @@ bool Game::checkTimeOver()
     return false;
 }
 
+double Game::timeBeforeTimeOver() const
+{
+    if (state != GameState::playing) {
+        return -1;
+    }
+    return timeController.timeBeforeTimeOver(board.side);
+}
+
 void Game::tickWork()
 {
     stateTick++;
+    update();
+}
+
+void Game::update()
+{
+    processMailboxes();
     
     switch (state) {
         case GameState::begin:
@@ -369,6 +542,9 @@ void Game::tickWork()
             
             if (okCnt == 2) {
                 if (state == GameState::begin) {
+                    if (standbyMode) {
+                        break;
+                    }
                     setState(GameState::ready);
                     newGame();
                 } else {
@@ -400,12 +576,10 @@ void Game::tickWork()
                 break;
             }
             
-            // std::lock_guard<std::mutex> dolock(criticalMutex); // avoid conflicting with moveFromPlayer
-            if (criticalMutex.try_lock()) {
-                if (state == GameState::playing) {
-                    checkTimeOver();
-                }
-                criticalMutex.unlock();
+            // a move landing after the drain above was read before this check,
+            // the next update judges it by its read time
+            if (!checkSyzygyResult() && timeController.isTimeOver(board.side) && mailboxes[sd].empty()) {
+                checkTimeOver();
             }
             break;
         }
@@ -434,37 +608,59 @@ void Game::tickWork()
 
 
 std::string Game::toPgn(std::string event, std::string site, int round, int gameIdx, bool richMode)
+{
+    return toPgn(board, createPgnHeader(event, site, round, gameIdx), richMode);
+}
+
+PgnHeader Game::createPgnHeader(const std::string& event, const std::string& site, int round, int gameIdx) const
+{
+    PgnHeader header;
+    header.event = event;
+    header.site = site;
+    header.round = round;
+    header.gameIdx = gameIdx;
+    header.date = std::time(0);
+    header.timeControl = timeController.toString();
+    for(int sd = 0; sd < 2; sd++) {
+        if (players[sd]) {
+            header.names[sd] = players[sd]->getName();
+        }
+    }
+    return header;
+}
+
+std::string Game::toPgn(ChessBoard& board, const PgnHeader& header, bool richMode)
 {
     std::ostringstream stringStream;
     
-    if (!event.empty()) {
-        stringStream << "[Event \"" << event << "\"]" << std::endl;
+    if (!header.event.empty()) {
+        stringStream << "[Event \"" << header.event << "\"]" << std::endl;
     }
-    if (!site.empty()) {
-        stringStream << "[Site \"" << site << "\"]" << std::endl;
+    if (!header.site.empty()) {
+        stringStream << "[Site \"" << header.site << "\"]" << std::endl;
     }
     
-    auto tm = localtime_xp(std::time(0));
+    auto tm = localtime_xp(header.date);
     
     stringStream << "[Date \"" << std::put_time(&tm, "%Y.%m.%d") << "\"]" << std::endl;
     
-    if (round >= 0) {
-        stringStream << "[Round \"" << round << "\"]" << std::endl;
+    if (header.round >= 0) {
+        stringStream << "[Round \"" << header.round << "\"]" << std::endl;
     }
     
     for(int sd = 1; sd >= 0; sd--) {
-        if (players[sd]) {
-            stringStream << "[" << (sd == W ? "White \"" : "Black \"") << players[sd]->getName() << "\"]" << std::endl;
+        if (!header.names[sd].empty()) {
+            stringStream << "[" << (sd == W ? "White \"" : "Black \"") << header.names[sd] << "\"]" << std::endl;
         }
     }
     stringStream << "[Result \"" << board.result.toShortString() << "\"]" << std::endl;
     
-    stringStream << "[TimeControl \"" << timeController.toString() << "\"]" << std::endl;
+    stringStream << "[TimeControl \"" << header.timeControl << "\"]" << std::endl;
     
     stringStream << "[Time \"" << std::put_time(&tm, "%H:%M:%S") << "\"]" << std::endl;
     
-    if (gameIdx >= 0) {
-        stringStream << "[Board \"" << std::to_string(gameIdx + 1) << "\"]" << std::endl;
+    if (header.gameIdx >= 0) {
+        stringStream << "[Board \"" << std::to_string(header.gameIdx + 1) << "\"]" << std::endl;
     }
 
     auto str = board.result.reasonString();
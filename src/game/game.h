@@ -26,8 +26,12 @@
 #ifndef game_hpp
 #define game_hpp
 
+#include <memory>
+
+#include "../base/spscqueue.h"
 #include "../chess/chess.h"
 #include "engine.h"
+#include "syzygyprober.h"
 
 
 namespace banksia {
@@ -48,6 +52,31 @@ namespace banksia {
         bool adjudicationEgtbMode = true;
         int adjudicationMaxGameLength = 0;
         int adjudicationMaxPieces = 10;
+        
+        // by scores of the engines (centipawns), move counts are of each side, zero counts turn them off
+        int adjudicationResignScore = 1000, adjudicationResignMoves = 0;
+        int adjudicationDrawScore = 10, adjudicationDrawMoves = 0, adjudicationDrawStartPly = 80;
+    };
+    
+    // What an engine reader thread hands over to its game, a bestmove or a resign
+    class PlayerMessage
+    {
+    public:
+        bool resign = false;
+        Move move = Move::illegalMove, ponderMove = Move::illegalMove;
+        std::string moveString;
+        double timeConsumed = 0;
+        EngineComputingState oldState = EngineComputingState::idle;
+    };
+    
+    // The tags of a PGN game, players without names are left out
+    class PgnHeader
+    {
+    public:
+        std::string event, site, timeControl;
+        std::string names[2]; // by side
+        std::time_t date = 0;
+        int round = -1, gameIdx = -1;
     };
     
     class Game : public Obj, public Tickable
@@ -59,6 +88,9 @@ namespace banksia {
         virtual ~Game();
         
         void set(Player*, Player*, const TimeController&);
+        
+        // back to the state of a new game for recycling, its players must be deattached
+        void reset(const GameConfig& gameConfig);
         void attachPlayer(Player* player, Side side);
         Player* deattachPlayer(Side side);
         void setMessageLogger(std::function<void(const std::string&, const std::string&, LogType)> logger);
@@ -66,6 +98,11 @@ namespace banksia {
         void newGame();
         
         void kickStart();
+        
+        // a standby game starts its engines but waits at begin, until it is let go for playing
+        void setStandby(bool standby) { standbyMode = standby; }
+        bool isStandby() const { return standbyMode; }
+        
         void pause();
         void stop();
         bool make(const Move& move, const std::string& moveString);
@@ -82,6 +119,10 @@ namespace banksia {
         
         virtual void tickWork() override;
         
+        // advance the game without counting a tick, called by events too
+        void update();
+        double timeBeforeTimeOver() const;
+        
         Player* getPlayer(Side side);
         const Player* getPlayer(Side side) const;
 
@@ -93,6 +134,11 @@ namespace banksia {
         int getStateTick() const { return stateTick; }
         
         std::string toPgn(std::string event = "", std::string site = "", int round = -1, int gameIdx = -1, bool richMode = false);
+        static std::string toPgn(ChessBoard& board, const PgnHeader& header, bool richMode);
+        PgnHeader createPgnHeader(const std::string& event, const std::string& site, int round, int gameIdx) const;
+        
+        // plies of the opening made by newGame
+        int getOpeningPly() const { return openingPly; }
         
         std::string getGameTitleString(bool includeResult = false) const;
         
@@ -100,11 +146,21 @@ namespace banksia {
         ChessBoard board;
         
     private:
-        bool checkTimeOver();
+        void processMailboxes();
+        bool checkTimeOver(double consumed = -1);
+        void probeSyzygy();
+        bool checkSyzygyResult();
+        bool checkScoreAdjudication();
         
     private:
-        int idx, stateTick = 0;
+        // most games end before, longer ones grow the lists as usual
+        static const int typical_game_ply = 256;
+        // a bestmove and a late one after stop are the most an engine has in flight
+        static const int mailbox_capacity = 16;
+        
+        int idx, stateTick = 0, openingPly = 0;
         GameState state;
+        bool standbyMode = false;
         GameConfig gameConfig;
         
         Player* players[2];
@@ -114,7 +170,13 @@ namespace banksia {
         
         std::string startFen;
         std::vector<Move> startMoves;
-        std::mutex criticalMutex;
+        
+        // one per side, filled by its engine's reader thread only and drained by update,
+        // which the tournament calls under its schedule lock
+        SpscQueue<PlayerMessage, mailbox_capacity> mailboxes[2];
+        
+        // at most one probe in flight, positions coming meanwhile are not probed
+        std::shared_ptr<SyzygyProbe> syzygyProbe;
     };
     
 } // namespace banksia
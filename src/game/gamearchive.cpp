@@ -0,0 +1,312 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <fstream>
+#include <cmath>
+#include <cstring>
+
+#include "../base/mappedfile.h"
+#include "gamearchive.h"
+
+using namespace banksia;
+
+// bumped whenever the record layout changes
+const char* GameArchive::magic = "BKSARC1\n";
+
+static const int magicLength = 8;
+
+// record flags
+static const int flag_info = 1 << 0;
+
+static void putVarint(std::string& str, u64 value)
+{
+    while (value >= 0x80) {
+        str += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    str += char(value);
+}
+
+static bool getVarint(const char*& p, const char* end, u64& value)
+{
+    value = 0;
+    for(int shift = 0; p < end && shift < 64; shift += 7) {
+        auto ch = u8(*p++);
+        value |= u64(ch & 0x7f) << shift;
+        if (!(ch & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void putString(std::string& str, const std::string& s)
+{
+    putVarint(str, s.size());
+    str += s;
+}
+
+static bool getString(const char*& p, const char* end, std::string& s)
+{
+    u64 len;
+    if (!getVarint(p, end, len) || len > u64(end - p)) {
+        return false;
+    }
+    s.assign(p, size_t(len));
+    p += len;
+    return true;
+}
+
+// signed values, small ones of both signs take one byte
+static u64 zigzag(i64 value)
+{
+    return u64(value) << 1 ^ u64(value >> 63);
+}
+
+static i64 unzigzag(u64 value)
+{
+    return i64(value >> 1) ^ -i64(value & 1);
+}
+
+GameArchive::~GameArchive()
+{
+    close();
+}
+
+bool GameArchive::open(const std::string& path, bool _infoMode)
+{
+    close();
+    file = fopen(path.c_str(), "ab");
+    if (!file) {
+        std::cerr << "Error: can't open archive file " << path << std::endl;
+        return false;
+    }
+    
+    // games are small, let many of them go in one write
+    setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    
+    infoMode = _infoMode;
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        fwrite(magic, 1, magicLength, file);
+    }
+    return true;
+}
+
+void GameArchive::close()
+{
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool GameArchive::append(const Game& game, const PgnHeader& header)
+{
+    if (!file) {
+        return false;
+    }
+    
+    return appendRecord(encode(game, header, infoMode));
+}
+
+bool GameArchive::appendRecord(const std::string& body)
+{
+    if (!file) {
+        return false;
+    }
+    
+    u8 len[4];
+    for(int i = 0; i < 4; i++) {
+        len[i] = u8(body.size() >> (i * 8));
+    }
+    
+    // handed to the system per game, a crash of the app loses nothing
+    return fwrite(len, 1, 4, file) == 4
+        && fwrite(body.c_str(), 1, body.size(), file) == body.size()
+        && fflush(file) == 0;
+}
+
+std::string GameArchive::encode(const Game& game, const PgnHeader& header, bool infoMode)
+{
+    auto& board = game.board;
+    
+    std::string str;
+    str.reserve(64 + board.histList.size() * (infoMode ? 12 : 2));
+    
+    str += char(infoMode ? flag_info : 0);
+    str += char(board.result.result);
+    str += char(board.result.reason);
+    putVarint(str, zigzag(header.date));
+    putVarint(str, zigzag(header.round));
+    putVarint(str, zigzag(header.gameIdx));
+    
+    putString(str, header.event);
+    putString(str, header.site);
+    putString(str, header.names[W]);
+    putString(str, header.names[B]);
+    putString(str, header.timeControl);
+    putString(str, board.getStartingFen());
+    
+    putVarint(str, board.histList.size());
+    putVarint(str, std::min(size_t(game.getOpeningPly()), board.histList.size()));
+    
+    for(auto && hist : board.histList) {
+        auto m = InfoRecord::packMove(hist.move.from, hist.move.dest, hist.move.promotion);
+        str += char(m & 0xff);
+        str += char(m >> 8);
+    }
+    
+    if (infoMode) {
+        for(size_t i = 0; i < board.histList.size(); i++) {
+            auto& note = board.findNote(i);
+            putVarint(str, zigzag(note.info.score));
+            putVarint(str, u64(std::max(0, note.info.depth)));
+            putVarint(str, u64(std::max(i64(0), note.info.nodes)));
+            putVarint(str, u64(std::llround(std::max(0.0, note.elapsed) * 1000)));
+        }
+    }
+    
+    return str;
+}
+
+bool GameArchive::decode(const char* data, size_t size, ChessBoard& board, PgnHeader& header, bool& infoMode)
+{
+    auto p = data, end = data + size;
+    if (size < 3) {
+        return false;
+    }
+    
+    infoMode = (*p++ & flag_info) != 0;
+    auto resultType = static_cast<ResultType>(*p++);
+    auto reasonType = static_cast<ReasonType>(*p++);
+    if (resultType > ResultType::loss || reasonType > ReasonType::crash) {
+        return false;
+    }
+    
+    u64 date, round, gameIdx, moveCnt, openingPly;
+    std::string startFen;
+    if (!getVarint(p, end, date) || !getVarint(p, end, round) || !getVarint(p, end, gameIdx)
+        || !getString(p, end, header.event) || !getString(p, end, header.site)
+        || !getString(p, end, header.names[W]) || !getString(p, end, header.names[B])
+        || !getString(p, end, header.timeControl) || !getString(p, end, startFen)
+        || !getVarint(p, end, moveCnt) || !getVarint(p, end, openingPly)
+        || moveCnt * 2 > u64(end - p)) {
+        return false;
+    }
+    header.date = std::time_t(unzigzag(date));
+    header.round = int(unzigzag(round));
+    header.gameIdx = int(unzigzag(gameIdx));
+    
+    board.newGame(startFen);
+    for(u64 i = 0; i < moveCnt; i++, p += 2) {
+        auto m = InfoRecord::unpackMove(u16(u8(p[0]) | u8(p[1]) << 8));
+        if (!board.checkMake(m.from, m.dest, m.promotion)) {
+            return false;
+        }
+    }
+    
+    if (openingPly > 0 && openingPly <= moveCnt) {
+        board.getNote(size_t(openingPly - 1)).comment = "End of opening";
+    }
+    
+    if (infoMode) {
+        for(size_t i = 0; i < moveCnt; i++) {
+            u64 score, depth, nodes, elapsed;
+            if (!getVarint(p, end, score) || !getVarint(p, end, depth)
+                || !getVarint(p, end, nodes) || !getVarint(p, end, elapsed)) {
+                return false;
+            }
+            auto& note = board.getNote(i);
+            note.info.score = int(unzigzag(score));
+            note.info.depth = int(depth);
+            note.info.nodes = i64(nodes);
+            note.elapsed = double(elapsed) / 1000;
+        }
+    }
+    
+    board.result = Result(resultType, reasonType);
+    return true;
+}
+
+bool GameArchive::convert(const std::string& archivePath, const std::string& pgnPath)
+{
+    MappedFile mappedFile;
+    if (!mappedFile.open(archivePath)) {
+        std::cerr << "Error: can't open archive file " << archivePath << std::endl;
+        return false;
+    }
+    
+    auto p = mappedFile.data(), end = p + mappedFile.size();
+    if (end - p < magicLength || memcmp(p, magic, magicLength) != 0) {
+        std::cerr << "Error: " << archivePath << " is not a game archive" << std::endl;
+        return false;
+    }
+    p += magicLength;
+    
+    auto path = pgnPath;
+    if (path.empty()) {
+        auto k = archivePath.find_last_of("./\\");
+        path = (k != std::string::npos && archivePath[k] == '.' ? archivePath.substr(0, k) : archivePath) + ".pgn";
+    }
+    
+    std::ofstream ofs(path, std::ofstream::out | std::ofstream::trunc);
+    if (!ofs.is_open()) {
+        std::cerr << "Error: can't write PGN file " << path << std::endl;
+        return false;
+    }
+    
+    auto gameCnt = 0, corruptedCnt = 0;
+    while (end - p >= 4) {
+        size_t len = 0;
+        for(int i = 0; i < 4; i++) {
+            len |= size_t(u8(p[i])) << (i * 8);
+        }
+        if (len > size_t(end - p - 4)) {
+            break;
+        }
+        p += 4;
+        
+        ChessBoard board;
+        PgnHeader header;
+        bool infoMode;
+        if (decode(p, len, board, header, infoMode)) {
+            ofs << Game::toPgn(board, header, infoMode) << std::endl;
+            gameCnt++;
+        } else {
+            corruptedCnt++;
+        }
+        p += len;
+    }
+    
+    if (corruptedCnt) {
+        std::cerr << "Warning: " << corruptedCnt << " corrupted games of " << archivePath << " ignored" << std::endl;
+    }
+    if (p < end) {
+        std::cerr << "Warning: the last game of " << archivePath << " is incomplete, ignored" << std::endl;
+    }
+    
+    std::cout << "Converted " << gameCnt << " games to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,70 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef gamearchive_h
+#define gamearchive_h
+
+#include <stdio.h>
+
+#include "game.h"
+
+namespace banksia {
+    
+    // A compact binary file of completed games, an alternative to PGN for long runs.
+    // Each game is one record: a small header (tags, result, start position) then
+    // every move in 16 bits, optionally followed by its score, depth, nodes and time.
+    // Records are length-prefixed so a record cut by a crash is detected when reading
+    class GameArchive
+    {
+    public:
+        GameArchive() {}
+        ~GameArchive();
+        
+        bool open(const std::string& path, bool infoMode);
+        void close();
+        bool isOpen() const { return file != nullptr; }
+        
+        bool append(const Game& game, const PgnHeader& header);
+        // a record made by encode, e.g. on another host
+        bool appendRecord(const std::string& body);
+        
+        // writes all games of an archive as PGN, by default next to the archive with the extension .pgn
+        static bool convert(const std::string& archivePath, const std::string& pgnPath);
+        
+        static std::string encode(const Game& game, const PgnHeader& header, bool infoMode);
+        static bool decode(const char* data, size_t size, ChessBoard& board, PgnHeader& header, bool& infoMode);
+        
+    private:
+        GameArchive(const GameArchive&) = delete;
+        GameArchive& operator = (const GameArchive&) = delete;
+        
+        static const char* magic;
+        
+        FILE* file = nullptr;
+        bool infoMode = false;
+    };
+    
+} // namespace banksia
+
+#endif /* gamearchive_h */
@@ -107,11 +107,24 @@ void JsonEngine::parseLine(int cmdInt, const std::string& cmdString, const std::
     if (cmdInt >= 0) {
         usedCmdSet.insert(cmdString);
         engine->parseLine(cmdInt, cmdString, line);
+        
+        // uciok or feature done=1, no need to wait for the next tick
+        if (engine->getState() == PlayerState::ready) {
+            completed(&engine->config);
+        }
+    } else if (config.protocol == Protocol::uci
+               && (cmdString == "Error" || cmdString == "Illegal") && line.find("uci") != std::string::npos) {
+        // Error (unknown command): uci
+        uciRejected = definitelyNotEngine = true;
     }
 }
 
 void JsonEngine::completed(Config* config)
 {
+    std::lock_guard<std::mutex> dolock(completeMutex);
+    if (jsonstate == JsonEngineState::done) {
+        return;
+    }
     (taskComplete)(config);
     quit();
     kill();
@@ -126,6 +139,15 @@ void JsonEngine::tickWork()
         return;
     }
     
+    // the program has exited
+    if (getState() == PlayerState::stopped) {
+        if (correctCmdCnt == 0) {
+            definitelyNotEngine = true;
+        }
+        return completed(nullptr);
+    }
+    
+    // stalled, the engine part gave up waiting
     auto st = engine->getState();
     if (st == PlayerState::stopped) {
         return completed(nullptr);
@@ -145,6 +167,9 @@ void JsonEngine::tickWork()
     }
     
     tick_test--;
+    if (uciRejected) {
+        tick_test = tryNum = 0;
+    }
     if (tick_test > 0) {
         return;
     }
@@ -171,6 +196,7 @@ void JsonEngine::tickWork()
     setupEngine();
     
     usedCmdSet.clear();
+    uciRejected = false;
     correctCmdCnt = 0;
     tick_idle = 0;
     tick_test = tick_test_period;
@@ -27,6 +27,8 @@
 #define jsonengineplayer_h
 
 #include <stdio.h>
+#include <atomic>
+#include <mutex>
 
 #include "engine.h"
 #include "uciengine.h"
@@ -55,6 +57,12 @@ namespace banksia {
         bool isFinished() const {
             return jsonstate == JsonEngineState::done;
         }
+        
+        // a failed probe got a clear answer: the program rejected the uci command or exited
+        // without any protocol reply. Timeouts are not, slow engines on busy hosts time out too
+        bool isDefinitelyNotEngine() const {
+            return definitelyNotEngine;
+        }
     private:
         const std::unordered_map<std::string, int>& getEngineCmdMap() const override;
         void parseLine(int, const std::string&, const std::string&) override;
@@ -73,7 +81,9 @@ namespace banksia {
         void completed(Config* config);
         void setupEngine();
         
-        JsonEngineState jsonstate = JsonEngineState::none;
+        // completed by the reader thread at uciok or feature done=1, by the ticks otherwise
+        std::atomic<JsonEngineState> jsonstate { JsonEngineState::none };
+        std::mutex completeMutex;
         Protocol originalProtocol;
 
         std::function<void(Config* config)> taskComplete = nullptr;
@@ -82,6 +92,9 @@ namespace banksia {
         const int tick_test_period_wb = 50; // 25 seconds
         int tick_test = 0, tryNum = 3;      // 4 x 12 -> 48s
         
+        // a Winboard engine has answered the uci command with an error, no need to wait out the test period
+        bool uciRejected = false, definitelyNotEngine = false;
+        
         Engine* engine = nullptr;
         
         UciEngine uciEngine;
@@ -33,22 +33,45 @@ using namespace banksia;
 
 static const std::string jsonTourString =
 "{\n"
+"    \"adaptive concurrency\" :\n"
+"    {\n"
+"        \"forfeit rate\" : 0.05,\n"
+"        \"guide\" : \"mode: start new games only when the host has headroom; concurrency (of base) is the first limit, it is raised up to max while one more game fits the load (0..1 of all cores), lowered down to min when the load is over or more games than forfeit rate lose on time; interval in seconds\",\n"
+"        \"interval\" : 10,\n"
+"        \"load\" : 0.9,\n"
+"        \"max\" : 4,\n"
+"        \"min\" : 1,\n"
+"        \"mode\" : false\n"
+"    },\n"
 "    \"base\" :\n"
 "    {\n"
 "        \"concurrency\" : 2,\n"
 "        \"event\" : \"Computer event\",\n"
 "        \"games per pair\" : 2,\n"
 "        \"swap pair sides\" : true,\n"
-"        \"guide\" : \"type: roundrobin, knockout, swiss; event, site for PGN tags; shuffle: random players for roundrobin or swiss\",\n"
+"        \"guide\" : \"type: roundrobin, knockout, swiss; event, site for PGN tags; shuffle: random players for roundrobin or swiss; lookahead: number of next games whose engines are started while all slots are busy, they start at once when a slot frees; priority: tournaments of a batch (-batch) with higher ones get free game slots first\",\n"
+"        \"lookahead\" : 0,\n"
 "        \"ponder\" : false,\n"
+"        \"priority\" : 0,\n"
 "        \"resumable\" : true,\n"
 "        \"shuffle players\" : false,\n"
 "        \"site\" : \"Somewhere on Earth\",\n"
 "        \"swiss rounds\" : 6,\n"
 "        \"type\" : \"roundrobin\"\n"
 "    },\n"
+"    \"distributed\" :\n"
+"    {\n"
+"        \"guide\" : \"mode: off, coordinator, worker; coordinator leases matches to workers connecting to its port, a worker plays them with its own engines; lease in seconds, a match not reported in time is given to another worker; concurrency 0 lets the coordinator play nothing itself\",\n"
+"        \"host\" : \"127.0.0.1\",\n"
+"        \"lease\" : 120,\n"
+"        \"mode\" : \"off\",\n"
+"        \"port\" : 7400\n"
+"    },\n"
 "    \"engine configurations\" :\n"
 "    {\n"
+"        \"cpu pinning\" : false,\n"
+"        \"guide\" : \"cpu pinning: run each engine on its own CPUs (as many as its threads, in one NUMA node if possible) for steadier speeds, Linux and Windows only; max reuse: an engine process plays up to that many more games instead of being restarted for each game (faster for engines slow to start), zero to turn it off; UCI engines only\",\n"
+"        \"max reuse\" : 0,\n"
 "        \"path\" : \"\",\n"
 "        \"update\" : false\n"
 "    },\n"
@@ -61,20 +84,39 @@ static const std::string jsonTourString =
 "    },\n"
 "    \"logs\" :\n"
 "    {\n"
+"        \"archive\" :\n"
+"        {\n"
+"            \"guide\" : \"a compact binary file of all games, convert it to PGN with banksia -convert; rich info: store scores, depths, nodes, elapses too\",\n"
+"            \"mode\" : false,\n"
+"            \"path\" : \"games.bka\",\n"
+"            \"rich info\" : true\n"
+"        },\n"
 "        \"engine\" :\n"
 "        {\n"
+"            \"compress\" : false,\n"
 "            \"game title surfix\" : true,\n"
-"            \"guide\" : \"one file: if false, games are stored in multi files using game indexes as surfix; game title surfix: use players names, results for file name surfix, affective only when 'one file' is false; separate by sides: each side has different logs\",\n"
+"            \"guide\" : \"one file: if false, games are stored in multi files using game indexes as surfix; game title surfix: use players names, results for file name surfix, affective only when 'one file' is false; separate by sides: each side has different logs; compress: gzip the logs in frames, .gz is added to the path\",\n"
 "            \"mode\" : true,\n"
 "            \"one file\" : false,\n"
 "            \"path\" : \"logengine.txt\",\n"
 "            \"separate by sides\" : false,\n"
 "            \"show time\" : true\n"
 "        },\n"
+"        \"flush interval\" : 500,\n"
+"        \"frame size\" : 1024,\n"
+"        \"guide\" : \"flush interval: milliseconds between writes of engine and result logs; frame size: KB of text per frame of compressed logs, a crash loses at most the last frame\",\n"
+"        \"metrics\" :\n"
+"        {\n"
+"            \"guide\" : \"a JSON file of the manager's counters and latency histograms, rewritten every interval seconds\",\n"
+"            \"interval\" : 60,\n"
+"            \"mode\" : false,\n"
+"            \"path\" : \"metrics.json\"\n"
+"        },\n"
 "        \"pgn\" :\n"
 "        {\n"
+"            \"compress\" : false,\n"
 "            \"game title surfix\" : true,\n"
-"            \"guide\" : \"one file: if false, games are stored in multi files using game indexes as surfix; game title surfix: use players names, results for file name surfix, affective only when 'one file' is false; rich info: log more info such as scores, depths, elapses\",\n"
+"            \"guide\" : \"one file: if false, games are stored in multi files using game indexes as surfix; game title surfix: use players names, results for file name surfix, affective only when 'one file' is false; rich info: log more info such as scores, depths, elapses; compress: gzip the games in frames, .gz is added to the path\",\n"
 "            \"mode\" : true,\n"
 "            \"one file\" : true,\n"
 "            \"path\" : \"games.pgn\",\n"
@@ -99,11 +141,16 @@ static const std::string jsonTourString =
 "        \"books\" :\n"
 "        [\n"
 "            {\n"
+"                \"cache\" : false,\n"
+"                \"guide\" : \"cache: save an index of lines into a file next to the book for faster loading\",\n"
 "                \"mode\" : false,\n"
 "                \"path\" : \"\",\n"
 "                \"type\" : \"epd\"\n"
 "            },\n"
 "            {\n"
+"                \"cache\" : false,\n"
+"                \"guide\" : \"maxply: ply to play, 0 or missing is all; cache: save parsed lines into a file next to the book for faster loading\",\n"
+"                \"maxply\" : 0,\n"
 "                \"mode\" : false,\n"
 "                \"path\" : \"\",\n"
 "                \"type\" : \"pgn\"\n"
@@ -119,14 +166,20 @@ static const std::string jsonTourString =
 "        ]\n"
 "    },\n"
 "    \"endgames\" : {\n"
-"        \"guide\" : \"syzygypath used for both 'override options' and 'game adjudication'\",\n"
+"        \"guide\" : \"syzygypath used for both 'override options' and 'game adjudication'; syzygy warmup: read tablebase files up to 'tablebase max pieces' before the first game to avoid slow first probes\",\n"
+"        \"syzygy warmup\" : false,\n"
 "        \"syzygypath\" : \"\"\n"
 "    },\n"
 "    \"game adjudication\" :\n"
 "    {\n"
 "        \"mode\" : true,\n"
-"        \"guide\" : \"finish and adjudicate result; set game length zero to turn it off; tablebase path is from endgames\",\n"
+"        \"guide\" : \"finish and adjudicate result; set game length zero to turn it off; tablebase path is from endgames; resign if score over: centipawns both engines agree on for 'resign score moves' moves each; draw if score within: centipawns both engines stay within for 'draw score moves' moves each, from 'draw score from ply' on; set score moves zero to turn them off\",\n"
 "        \"draw if game length over\" : 500,\n"
+"        \"draw if score within\" : 10,\n"
+"        \"draw score from ply\" : 80,\n"
+"        \"draw score moves\" : 8,\n"
+"        \"resign if score over\" : 1000,\n"
+"        \"resign score moves\" : 3,\n"
 "        \"tablebase max pieces\" : 7,\n"
 "        \"tablebase\" : true\n"
 "    },\n"
@@ -134,10 +187,13 @@ static const std::string jsonTourString =
 "    {\n"
 "        \"base\" :\n"
 "        {\n"
-"            \"guide\" : \"threads (cores), memory (hash), syzygypath (from endgames) will overwrite for any relative options (both UCI and Winboard), memory in MB, set zero/empty to disable them; options will relplace engines' options which are same names and types, 'value' is the most important, others ignored; to avoid some options from specific engines being overridden, add and set field 'overridable' to false for them\",\n"
+"            \"guide\" : \"threads (cores), memory (hash), syzygypath (from endgames) will overwrite for any relative options (both UCI and Winboard), memory in MB, set zero/empty to disable them; memory plan: work out the hash from the host memory (less 'memory reserve' MB and tablebase files) for all concurrent engines, memory is then its cap; memory limit: MB an engine process may use over its hash, zero to turn it off, Linux and Windows only; options will relplace engines' options which are same names and types, 'value' is the most important, others ignored; to avoid some options from specific engines being overridden, add and set field 'overridable' to false for them\",\n"
 "            \"mode\" : true,\n"
 "            \"threads\" : 1,\n"
-"            \"memory\" : 64\n"
+"            \"memory\" : 64,\n"
+"            \"memory limit\" : 0,\n"
+"            \"memory plan\" : false,\n"
+"            \"memory reserve\" : 1024\n"
 "        },\n"
 "        \"options\" :\n"
 "        [\n"
@@ -172,13 +228,24 @@ static const std::string jsonTourString =
 "        \"crafty\",\n"
 "        \"gaviota-1.0\"\n"
 "    ],    \n"
+"    \"sprt\" :\n"
+"    {\n"
+"        \"alpha\" : 0.05,\n"
+"        \"beta\" : 0.05,\n"
+"        \"elo0\" : 0,\n"
+"        \"elo1\" : 5,\n"
+"        \"guide\" : \"mode: stop the tournament once the test is decided, for a match of two players (the first one is tested) or a gauntlet of one inclusive player; games are counted by pairs (games per pair: 2); elo0, elo1: logistic Elo of H0, H1; alpha, beta: error rates\",\n"
+"        \"mode\" : false\n"
+"    },\n"
 "    \"time control\" :\n"
 "    {\n"
-"        \"guide\" : \"unit's second; time: could be a real number (e.g. 6.5 for 6.5s) or a string (e.g. '2:10:30' for 2h 20m 30s); mode: standard, infinite, depth, movetime; margin: an extra delay time before checking if time's over\",\n"
+"        \"guide\" : \"unit's second; time: could be a real number (e.g. 6.5 for 6.5s) or a string (e.g. '2:10:30' for 2h 20m 30s); mode: standard, infinite, depth, movetime, nodes; margin: an extra delay time before checking if time's over; latency compensation: taken from each move time for the pipe latency; nodes: nodes per move for mode nodes, time is then a safety cap in seconds of each move, an engine may scale nodes by its 'nodes factor'\",\n"
 "        \"increment\" : 0.5,\n"
+"        \"latency compensation\" : 0,\n"
 "        \"margin\" : 0.8,\n"
 "        \"mode\" : \"standard\",\n"
 "        \"moves\" : 40,\n"
+"        \"nodes\" : 100000,\n"
 "        \"time\" : 6.5\n"
 "    }\n"
 "}";
@@ -241,6 +308,7 @@ void JsonMaker::tickWork()
         workingEngineVec.push_back(jsonEngine);
         
         jsonEngine->kickStart([=](Config* rConfig) {
+            std::lock_guard<std::mutex> dolock(resultMutex);
             tick_idle = 0;
             
             if (rConfig) {
@@ -254,9 +322,14 @@ void JsonMaker::tickWork()
                 
                 std::cout << "OK, an engine detected: " << rConfig->name << ", " << nameFromProtocol(rConfig->protocol) << std::endl;
                 goodConfigVec.push_back(*rConfig);
-            } else {
+            } else if (jsonEngine->isDefinitelyNotEngine()) {
                 std::cout << "  not an engine: " << config.command << std::endl;
+            } else {
+                // not cached, it is probed again by the next scan
+                std::cout << "  no answer in time: " << config.command << std::endl;
+                return;
             }
+            engineCache.update(config.command, rConfig);
         });
     }
     
@@ -288,6 +361,7 @@ void JsonMaker::completed()
     
     ConfigMng::instance->setJsonPath(jsonEngineConfigPath);
     ConfigMng::instance->saveToJsonFile();
+    engineCache.saveToJsonFile(jsonEngineCachePath);
     
     // update tour json
     {
@@ -299,7 +373,9 @@ void JsonMaker::completed()
 
 		auto curPath = currentWorkingFolder() + folderSlash;
 		auto logs = sample["logs"];
+		logs["archive"]["path"] = curPath + logs["archive"]["path"].asString();
 		logs["engine"]["path"] = curPath + logs["engine"]["path"].asString();
+		logs["metrics"]["path"] = curPath + logs["metrics"]["path"].asString();
 		logs["pgn"]["path"] = curPath + logs["pgn"]["path"].asString();
 		logs["result"]["path"] = curPath + logs["result"]["path"].asString();
 		sample["logs"] = logs;
@@ -378,8 +454,18 @@ void JsonMaker::build(const std::string& mainJsonPath, const std::string& mainEn
     std::cout << " engine configurations JSON file: " << jsonEngineConfigPath << std::endl;
     std::cout << " tournament JSON file: " << jsonTourMngPath << std::endl;
     
+    // engines.json -> engines.cache.json
+    jsonEngineCachePath = jsonEngineConfigPath;
+    auto p = jsonEngineCachePath.rfind(".json");
+    if (p != std::string::npos && p + 5 == jsonEngineCachePath.size()) {
+        jsonEngineCachePath = jsonEngineCachePath.substr(0, p);
+    }
+    jsonEngineCachePath += ".cache.json";
+    engineCache.loadFromJsonFile(jsonEngineCachePath);
+    
     // Scan engines
     std::set<std::string> pathSet;
+    auto cachedCnt = 0;
     
     ConfigMng::instance->setEditingMode(true);
     ConfigMng::instance->loadFromJsonFile(jsonEngineConfigPath, false);
@@ -388,24 +474,42 @@ void JsonMaker::build(const std::string& mainJsonPath, const std::string& mainEn
         if (config.command.empty() || pathSet.find(config.command) != pathSet.end()) {
             continue;
         }
-        configVec.push_back(config);
         pathSet.insert(config.command);
+        
+        // an unchanged engine keeps its config, edits included
+        auto isEngine = false;
+        if (engineCache.find(config.command, isEngine, nullptr) && isEngine) {
+            goodConfigVec.push_back(config);
+            cachedCnt++;
+            continue;
+        }
+        configVec.push_back(config);
     }
     
     if (!motherEngineFolder.empty()) {
-        Config config;
-        config.protocol = Protocol::none;
         auto allPaths = listExcecutablePaths(motherEngineFolder);
         for(auto && path : allPaths) {
             if (path.empty() || pathSet.find(path) != pathSet.end())
                 continue;
+            
+            Config config;
+            auto isEngine = false;
+            if (engineCache.find(path, isEngine, &config)) {
+                if (isEngine) {
+                    goodConfigVec.push_back(config);
+                }
+                cachedCnt++;
+                continue;
+            }
+            
+            config.protocol = Protocol::none;
             config.command = path;
             config.workingFolder = getFolder(path);
             configVec.push_back(config);
         }
     }
     
-    std::cout << " executable file number: " << configVec.size() << ", concurrency: " << concurrency << std::endl << std::endl;
+    std::cout << " executable file number: " << configVec.size() + cachedCnt << ", unchanged since the last scan: " << cachedCnt << ", concurrency: " << concurrency << std::endl << std::endl;
     
     state = JsonMakerState::working;
     
@@ -27,9 +27,11 @@
 #define jsonmaker_h
 
 #include <stdio.h>
+#include <mutex>
 
 #include "tourmng.h"
 #include "jsonengine.h"
+#include "enginecache.h"
 
 namespace banksia {
     
@@ -70,12 +72,17 @@ namespace banksia {
         
         std::vector<JsonEngine*> workingEngineVec;
         std::vector<Config> goodConfigVec;
+        // probes complete on the reader threads of their engines
+        std::mutex resultMutex;
+        
+        // results of earlier scans, unchanged files are not probed again
+        EngineCache engineCache;
 
         CppTime::Timer timer;
         CppTime::timer_id mainTimerId;
         time_t startTime;
 
-        std::string jsonTourMngPath, jsonEngineConfigPath, motherEngineFolder;
+        std::string jsonTourMngPath, jsonEngineConfigPath, jsonEngineCachePath, motherEngineFolder;
     };
     
 } // namespace banksia
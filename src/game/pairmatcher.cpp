@@ -0,0 +1,154 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <deque>
+
+#include "pairmatcher.h"
+
+using namespace banksia;
+
+PairMatcher::PairMatcher(int _playerCnt)
+: playerCnt(_playerCnt), rowWords((_playerCnt + 63) >> 6)
+{
+    bits.resize(size_t(playerCnt) * rowWords, 0);
+}
+
+void PairMatcher::forbid(int a, int b)
+{
+    assert(a >= 0 && a < playerCnt && b >= 0 && b < playerCnt);
+    bits[size_t(a) * rowWords + (b >> 6)] |= u64(1) << (b & 63);
+    bits[size_t(b) * rowWords + (a >> 6)] |= u64(1) << (a & 63);
+}
+
+bool PairMatcher::match(std::vector<int>& mate) const
+{
+    mate.assign(playerCnt, -1);
+    
+    // players are sorted by scores, the nearest free one is the best opponent
+    for(int i = 0; i < playerCnt; i++) {
+        if (mate[i] >= 0) continue;
+        for(int j = i + 1; j < playerCnt; j++) {
+            if (mate[j] < 0 && !isForbidden(i, j)) {
+                mate[i] = j; mate[j] = i;
+                break;
+            }
+        }
+    }
+    
+    std::vector<int> parent(playerCnt), base(playerCnt);
+    auto ok = true;
+    for(int root = 0; root < playerCnt; root++) {
+        if (mate[root] >= 0) continue;
+        
+        // flip the matched and unmatched edges along the path, both ends get mates
+        auto v = findPath(root, mate, parent, base);
+        if (v < 0) {
+            ok = false;
+            continue;
+        }
+        while (v >= 0) {
+            auto pv = parent[v], ppv = mate[pv];
+            mate[v] = pv; mate[pv] = v;
+            v = ppv;
+        }
+    }
+    return ok;
+}
+
+int PairMatcher::lca(int a, int b, const std::vector<int>& mate, const std::vector<int>& parent, const std::vector<int>& base) const
+{
+    std::vector<char> used(playerCnt, 0);
+    for(;;) {
+        a = base[a];
+        used[a] = 1;
+        if (mate[a] < 0) break;
+        a = parent[mate[a]];
+    }
+    for(;;) {
+        b = base[b];
+        if (used[b]) return b;
+        b = parent[mate[b]];
+    }
+}
+
+void PairMatcher::markPath(int v, int b, int child, const std::vector<int>& mate, std::vector<int>& parent, const std::vector<int>& base, std::vector<char>& blossom) const
+{
+    while (base[v] != b) {
+        blossom[base[v]] = blossom[base[mate[v]]] = 1;
+        parent[v] = child;
+        child = mate[v];
+        v = parent[mate[v]];
+    }
+}
+
+// Breadth-first search of an augmenting path from root, odd cycles (blossoms) are contracted into their bases.
+// Returns the free end of the path, -1 if there is none
+int PairMatcher::findPath(int root, std::vector<int>& mate, std::vector<int>& parent, std::vector<int>& base) const
+{
+    std::vector<char> used(playerCnt, 0), blossom(playerCnt);
+    for(int i = 0; i < playerCnt; i++) {
+        parent[i] = -1;
+        base[i] = i;
+    }
+    
+    used[root] = 1;
+    std::deque<int> queue;
+    queue.push_back(root);
+    
+    while (!queue.empty()) {
+        auto v = queue.front();
+        queue.pop_front();
+        
+        for(int to = 0; to < playerCnt; to++) {
+            if (to == v || isForbidden(v, to) || base[v] == base[to] || mate[v] == to) {
+                continue;
+            }
+            
+            if (to == root || (mate[to] >= 0 && parent[mate[to]] >= 0)) {
+                auto curBase = lca(v, to, mate, parent, base);
+                std::fill(blossom.begin(), blossom.end(), 0);
+                markPath(v, curBase, to, mate, parent, base, blossom);
+                markPath(to, curBase, v, mate, parent, base, blossom);
+                for(int i = 0; i < playerCnt; i++) {
+                    if (blossom[base[i]]) {
+                        base[i] = curBase;
+                        if (!used[i]) {
+                            used[i] = 1;
+                            queue.push_back(i);
+                        }
+                    }
+                }
+            } else if (parent[to] < 0) {
+                parent[to] = v;
+                if (mate[to] < 0) {
+                    return to;
+                }
+                auto to2 = mate[to];
+                used[to2] = 1;
+                queue.push_back(to2);
+            }
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,63 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef pairmatcher_h
+#define pairmatcher_h
+
+#include <vector>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // Pairs the players of a round, given by indexes from the best one. Pairs played already are kept in
+    // a bit-matrix and avoided. Neighbours are paired greedily first, players left out get opponents by
+    // augmenting paths of Edmonds' blossom algorithm, O(n^2) for each of them
+    class PairMatcher
+    {
+    public:
+        explicit PairMatcher(int playerCnt);
+        
+        void forbid(int a, int b);
+        bool isForbidden(int a, int b) const {
+            return (bits[size_t(a) * rowWords + (b >> 6)] >> (b & 63)) & 1;
+        }
+        
+        // mates of players, -1 for ones without opponents. Returns true if all are paired
+        bool match(std::vector<int>& mate) const;
+        
+    private:
+        int findPath(int root, std::vector<int>& mate, std::vector<int>& parent, std::vector<int>& base) const;
+        int lca(int a, int b, const std::vector<int>& mate, const std::vector<int>& parent, const std::vector<int>& base) const;
+        void markPath(int v, int b, int child, const std::vector<int>& mate, std::vector<int>& parent, const std::vector<int>& base, std::vector<char>& blossom) const;
+        
+    private:
+        int playerCnt, rowWords;
+        std::vector<u64> bits;
+    };
+    
+} // namespace banksia
+
+#endif /* pairmatcher_h */
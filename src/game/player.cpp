@@ -26,6 +26,7 @@
 #include <sstream>
 
 #include "player.h"
+#include "scheduler.h"
 
 using namespace banksia;
 
@@ -61,9 +62,10 @@ void Player::setState(PlayerState st)
 {
     state = st;
     tick_state = 0;
+    EventScheduler::post();
 }
 
-void Player::attach(ChessBoard* _board, const GameTimeController* _timeController,
+void Player::attach(ChessBoard* _board, GameTimeController* _timeController,
                     std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)> _moveReceiver,
                     std::function<void()> _resignFunc)
 {
@@ -92,11 +94,11 @@ bool Player::goPonder(const Move&)
 bool Player::go()
 {
     setState(PlayerState::playing);
-    score = depth = 0; nodes = 0;
+    info.reset();
     return true;
 }
 
-bool Player::oppositeMadeMove(const Move&, const std::string&)
+bool Player::oppositeMadeMove(const Move&)
 {
     return false;
 }
@@ -56,8 +56,9 @@ namespace banksia {
         virtual const char* className() const override { return "Player"; }
         
         std::string getName() const;
+        PlayerType getType() const { return type; }
         PlayerState getState() const { return state; }
-        void setState(PlayerState st);
+        virtual void setState(PlayerState st);
         int getTickState() const { return tick_state; }
         void setPonderMode(bool mode) { ponderMode = mode; }
 
@@ -69,7 +70,7 @@ namespace banksia {
         
         virtual void newGame() {}
 
-        virtual void attach(ChessBoard*, const GameTimeController*, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)>, std::function<void()>);
+        virtual void attach(ChessBoard*, GameTimeController*, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)>, std::function<void()>);
         virtual void deattach();
         virtual bool isAttached() const;
         virtual bool isSafeToDeattach() const = 0;
@@ -77,18 +78,10 @@ namespace banksia {
 
         virtual bool goPonder(const Move& pondermove);
         virtual bool go();
-        virtual bool oppositeMadeMove(const Move& move, const std::string& sanMoveString);
+        virtual bool oppositeMadeMove(const Move& move);
 
-        int getScore() const {
-            return score;
-        }
-        
-        int getDepth() const {
-            return depth;
-        }
-        
-        i64 getNodes() const {
-            return nodes;
+        const InfoRecord& getInfo() const {
+            return info;
         }
 
     protected:
@@ -99,8 +92,7 @@ namespace banksia {
         PlayerState state;
         int tick_state = 0;
         // for stats
-        int score, depth;
-        i64 nodes;
+        InfoRecord info;
         
         bool ponderMode = false;
         
@@ -108,7 +100,7 @@ namespace banksia {
         std::function<void()> resignFunc = nullptr;
         
         ChessBoard* board = nullptr;
-        const GameTimeController* timeController = nullptr;
+        GameTimeController* timeController = nullptr;
     };
 
 } // namespace banksia
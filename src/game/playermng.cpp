@@ -34,19 +34,30 @@ PlayerMng* PlayerMng::instance = nullptr;
 
 PlayerMng::PlayerMng()
 {
-    assert(!instance);
-    instance = this;
+    if (!instance) {
+        instance = this;
+    }
 }
 
 PlayerMng::~PlayerMng()
 {
+    if (instance == this) {
+        instance = nullptr;
+    }
 }
 
 void PlayerMng::tickWork()
 {
     std::vector<Player*> removingList;
     
-    for(auto && player : playerList) {
+    // engines may be added by tournaments of a batch meanwhile, only this tick removes them
+    std::vector<Player*> list;
+    {
+        std::lock_guard<std::mutex> dolock(thelock);
+        list = playerList;
+    }
+    
+    for(auto && player : list) {
         if (player->getState() == PlayerState::stopped) {
             if (!player->isAttached()) {
                 removingList.push_back(player);
@@ -57,10 +68,16 @@ void PlayerMng::tickWork()
     }
     
     for(auto && player : removingList) {
-        auto it = std::find(playerList.begin(), playerList.end(), player);
-        if (it != playerList.end()) {
-            playerList.erase(it);
+        if (player->getType() == PlayerType::engine) {
+            auto engine = static_cast<Engine*>(player);
+            std::lock_guard<std::mutex> dolock(thelock);
+            auto it = idleEngineMap.find(engine->config.name);
+            if (it != idleEngineMap.end()) {
+                auto& vec = it->second;
+                vec.erase(std::remove(vec.begin(), vec.end(), engine), vec.end());
+            }
         }
+        
         removePlayer(player);
     }
 }
@@ -108,6 +125,20 @@ bool PlayerMng::returnPlayer(Player* player)
 {
     if (player == nullptr) return false;
     
+    if (maxReuse > 0 && player->getType() == PlayerType::engine) {
+        auto engine = static_cast<Engine*>(player);
+        if (engine->reuseCnt < maxReuse) {
+            // its answer to the health check must be read
+            engine->setPooled(true);
+            if (engine->prepareForReuse()) {
+                std::lock_guard<std::mutex> dolock(thelock);
+                idleEngineMap[engine->config.name].push_back(engine);
+                return true;
+            }
+            engine->setPooled(false);
+        }
+    }
+    
     if (player->getState() < PlayerState::stopping) {
         player->quit();
         return true;
@@ -125,13 +156,17 @@ bool PlayerMng::removePlayer(Player* player)
 {
     if (player == nullptr) return false;
     
-    auto it = std::find(playerList.begin(), playerList.end(), player);
-    
-    if (it != playerList.end()) {
+    {
         std::lock_guard<std::mutex> dolock(thelock);
-        playerList.erase(it);
+        auto it = std::find(playerList.begin(), playerList.end(), player);
+        if (it != playerList.end()) {
+            playerList.erase(it);
+        }
+        
+        if (player->getType() == PlayerType::engine) {
+            coreAllocator.release(static_cast<Engine*>(player)->cpuSet);
+        }
     }
-    
     delete player;
     return true;
 }
@@ -142,12 +177,49 @@ Engine* PlayerMng::createEngine(const std::string& name)
     return config.isValid() ? createEngine(config) : nullptr;
 }
 
+void PlayerMng::setMaxReuse(int _maxReuse)
+{
+    maxReuse = std::max(0, _maxReuse);
+}
+
+// Engines still waiting for readyok are taken too, games wait for them to be ready
+Engine* PlayerMng::takeIdleEngine(const Config& config)
+{
+    std::lock_guard<std::mutex> dolock(thelock);
+    auto it = idleEngineMap.find(config.name);
+    if (it == idleEngineMap.end()) {
+        return nullptr;
+    }
+    
+    auto& vec = it->second;
+    while (!vec.empty()) {
+        auto engine = vec.back();
+        vec.pop_back();
+        
+        // dead ones are removed by tickWork
+        auto st = engine->getState();
+        if (st == PlayerState::starting || st == PlayerState::ready) {
+            engine->setPooled(false);
+            engine->reuseCnt++;
+            return engine;
+        }
+    }
+    return nullptr;
+}
+
 Engine* PlayerMng::createEngine(const Config& config)
 {
     if (!config.isValid()) {
         return nullptr;
     }
 
+    if (maxReuse > 0) {
+        auto engine = takeIdleEngine(config);
+        if (engine) {
+            return engine;
+        }
+    }
+    
     Engine* ePlayer = nullptr;
 
     switch (config.protocol) {
@@ -163,13 +235,67 @@ Engine* PlayerMng::createEngine(const Config& config)
             break;
     }
     
-    if (ePlayer)
+    if (ePlayer) {
+        if (cpuPinning) {
+            std::lock_guard<std::mutex> dolock(thelock);
+            ePlayer->cpuSet = coreAllocator.allocate(getThreadCount(config));
+            if (ePlayer->cpuSet.empty() && !cpuPinningWarned) {
+                cpuPinningWarned = true;
+                std::cerr << "Warning: not enough free CPUs to pin all engines, some run unpinned" << std::endl;
+            }
+        }
+        auto room = ConfigMng::instance->getMemoryLimitRoom();
+        if (room > 0) {
+            ePlayer->memoryLimit = getHashSize(config) + room;
+        }
         add(ePlayer);
+    }
     return ePlayer;
 }
 
+bool PlayerMng::setCpuPinning(bool enabled)
+{
+    cpuPinning = false;
+    if (enabled) {
+        if (!coreAllocator.init()) {
+            std::cerr << "Warning: CPU pinning is not supported on this system" << std::endl;
+            return false;
+        }
+        cpuPinning = true;
+        std::cout << "CPU pinning: " << coreAllocator.toString() << std::endl;
+    }
+    return true;
+}
+
+// the threads option as it will be sent, one if the engine has none
+int PlayerMng::getThreadCount(const Config& config)
+{
+    for(auto && name : { "threads", "cores" }) {
+        auto option = config.getOptionIgnoreCase(name);
+        if (option && option->type == OptionType::spin) {
+            auto o = ConfigMng::instance->checkOverrideOption(*option);
+            return std::max(1, o.value);
+        }
+    }
+    return 1;
+}
+
+// the hash option in MB as it will be sent, zero if the engine has none
+int PlayerMng::getHashSize(const Config& config)
+{
+    for(auto && name : { "hash", "memory" }) {
+        auto option = config.getOptionIgnoreCase(name);
+        if (option && option->type == OptionType::spin) {
+            auto o = ConfigMng::instance->checkOverrideOption(*option);
+            return std::max(0, o.value);
+        }
+    }
+    return 0;
+}
+
 void PlayerMng::shutdown()
 {
+    std::lock_guard<std::mutex> dolock(thelock);
     for(auto && player : playerList) {
         player->quit();
         player->kill();
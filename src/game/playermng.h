@@ -26,8 +26,11 @@
 #ifndef playermng_hpp
 #define playermng_hpp
 
+#include <unordered_map>
+
 #include "uciengine.h"
 #include "configmng.h"
+#include "../base/coreallocator.h"
 
 namespace banksia {
     
@@ -54,12 +57,29 @@ namespace banksia {
         
         void shutdown();
         
+        // keeps engines running between games, each process plays up to maxReuse more games.
+        // Zero turns it off, finished engines quit
+        void setMaxReuse(int maxReuse);
+        
+        // pins each new engine to its own CPUs, as many as its threads
+        bool setCpuPinning(bool enabled);
+        
     private:
         bool removePlayer(Player* player);
+        Engine* takeIdleEngine(const Config& config);
+        static int getThreadCount(const Config& config);
+        static int getHashSize(const Config& config);
         
     private:
         std::mutex thelock;
         std::vector<Player*> playerList;
+        
+        // idle engines by config names, they are in playerList too
+        std::unordered_map<std::string, std::vector<Engine*>> idleEngineMap;
+        int maxReuse = 0;
+        
+        CoreAllocator coreAllocator;
+        bool cpuPinning = false, cpuPinningWarned = false;
     };
     
 } // namespace banksia
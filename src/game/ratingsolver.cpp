@@ -0,0 +1,265 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cmath>
+#include <thread>
+#include <condition_variable>
+#include <sstream>
+
+#include "ratingsolver.h"
+
+using namespace banksia;
+
+bool RatingSolver::isValid() const
+{
+    return cnt >= 0 && matrix.size() == size_t(cnt * cnt);
+}
+
+std::string RatingSolver::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << "players: " << cnt;
+    return stringStream.str();
+}
+
+void RatingSolver::clear()
+{
+    std::lock_guard<std::mutex> dolock(solverMutex);
+    nameList.clear();
+    indexMap.clear();
+    matrix.clear();
+    gammas.clear();
+    ratings.clear();
+    cnt = 0;
+    dirty = false;
+}
+
+int RatingSolver::getIndex(const std::string& name)
+{
+    auto it = indexMap.find(name);
+    if (it != indexMap.end()) {
+        return it->second;
+    }
+    
+    // grow the matrix by one row and one column
+    auto n = cnt + 1;
+    std::vector<Cell> vec(size_t(n * n));
+    for(int i = 0; i < cnt; i++) {
+        for(int j = 0; j < cnt; j++) {
+            vec[size_t(i * n + j)] = matrix[size_t(i * cnt + j)];
+        }
+    }
+    matrix.swap(vec);
+    
+    nameList.push_back(name);
+    indexMap[name] = cnt;
+    gammas.push_back(1.0);
+    return cnt++;
+}
+
+void RatingSolver::addResult(const std::string& name0, const std::string& name1, double score)
+{
+    if (name0.empty() || name1.empty() || name0 == name1) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> dolock(solverMutex);
+    auto i = getIndex(name0), j = getIndex(name1);
+    
+    auto points2 = int(score * 2 + 0.5);
+    auto& c0 = matrix[size_t(i * cnt + j)];
+    c0.games++;
+    c0.points2 += points2;
+    auto& c1 = matrix[size_t(j * cnt + i)];
+    c1.games++;
+    c1.points2 += 2 - points2;
+    dirty = true;
+}
+
+bool RatingSolver::getPairResult(const std::string& name0, const std::string& name1, double& points, int& games) const
+{
+    std::lock_guard<std::mutex> dolock(solverMutex);
+    auto it0 = indexMap.find(name0), it1 = indexMap.find(name1);
+    if (it0 == indexMap.end() || it1 == indexMap.end()) {
+        return false;
+    }
+    
+    auto& c = matrix[size_t(it0->second * cnt + it1->second)];
+    points = c.points2 / 2.0;
+    games = c.games;
+    return games > 0;
+}
+
+std::unordered_map<std::string, PlayerRating> RatingSolver::getRatings()
+{
+    std::lock_guard<std::mutex> dolock(solverMutex);
+    if (dirty) {
+        solve();
+        dirty = false;
+    }
+    
+    std::unordered_map<std::string, PlayerRating> map;
+    for(size_t i = 0; i < ratings.size(); i++) {
+        map[nameList.at(i)] = ratings.at(i);
+    }
+    return map;
+}
+
+// The minorization-maximization (Zermelo) iteration: gamma_i = W_i / sum_j n_ij / (gamma_i + gamma_j).
+// Each iteration reads the gammas of the previous one only, thus rows are split among threads,
+// which meet at a barrier after every iteration and all take the same stop decision
+void RatingSolver::solve()
+{
+    auto n = cnt;
+    if (n == 0) {
+        ratings.clear();
+        return;
+    }
+    
+    std::vector<double> wins(size_t(n), priorGames / 2);
+    for(int i = 0; i < n; i++) {
+        for(int j = 0; j < n; j++) {
+            wins[size_t(i)] += matrix[size_t(i * n + j)].points2 / 2.0;
+        }
+    }
+    
+    auto threadCnt = std::max(1, std::min(getNumberOfCores(), n / minPlayersPerThread));
+    
+    std::vector<double> buf[2] = { gammas, gammas };
+    // per thread: max, min and sum of the changes of log gammas, sum of new log gammas
+    std::vector<double> partials[2] = { std::vector<double>(size_t(threadCnt * 4)), std::vector<double>(size_t(threadCnt * 4)) };
+    auto lastBuf = 0;
+    auto lastScale = 1.0;
+    
+    std::mutex barrierMutex;
+    std::condition_variable barrierCV;
+    int barrierCnt = 0, barrierGeneration = 0;
+    
+    auto barrier = [&]() {
+        std::unique_lock<std::mutex> lock(barrierMutex);
+        auto generation = barrierGeneration;
+        if (++barrierCnt == threadCnt) {
+            barrierCnt = 0;
+            barrierGeneration++;
+            barrierCV.notify_all();
+        } else {
+            barrierCV.wait(lock, [&]() { return generation != barrierGeneration; });
+        }
+    };
+    
+    // The gammas of an iteration are scaled to the geometric mean of one when read, otherwise the
+    // whole scale drifts slowly, held by the priors only. The virtual opponent of the priors is thus
+    // an average player. Changes are measured after removing their mean since that part is the
+    // scale. All threads compute the same scale and stop decision
+    auto work = [&](int t, int from, int to) {
+        auto scale = 1.0;
+        for(int k = 0; ; k++) {
+            auto& cur = buf[k & 1];
+            auto& next = buf[(k + 1) & 1];
+            
+            auto maxDelta = -1e9, minDelta = 1e9, deltaSum = 0.0, logSum = 0.0;
+            for(int i = from; i < to; i++) {
+                auto gi = cur[size_t(i)] * scale;
+                auto denom = priorGames / (gi + 1.0);
+                auto row = matrix.data() + size_t(i * n);
+                for(int j = 0; j < n; j++) {
+                    if (row[j].games) {
+                        denom += row[j].games / (gi + cur[size_t(j)] * scale);
+                    }
+                }
+                auto g = wins[size_t(i)] / denom;
+                auto logG = std::log(g), d = logG - std::log(gi);
+                maxDelta = std::max(maxDelta, d);
+                minDelta = std::min(minDelta, d);
+                deltaSum += d;
+                logSum += logG;
+                next[size_t(i)] = g;
+            }
+            auto p = partials[k & 1].data() + t * 4;
+            p[0] = maxDelta; p[1] = minDelta; p[2] = deltaSum; p[3] = logSum;
+            
+            barrier();
+            
+            maxDelta = -1e9; minDelta = 1e9; deltaSum = 0; logSum = 0;
+            for(int i = 0; i < threadCnt; i++) {
+                p = partials[k & 1].data() + i * 4;
+                maxDelta = std::max(maxDelta, p[0]);
+                minDelta = std::min(minDelta, p[1]);
+                deltaSum += p[2];
+                logSum += p[3];
+            }
+            auto mean = deltaSum / n;
+            auto m = std::max(maxDelta - mean, mean - minDelta);
+            scale = std::exp(-logSum / n);
+            
+            if (m < tolerance || k + 1 >= maxIterations) {
+                if (t == 0) {
+                    lastBuf = (k + 1) & 1;
+                    lastScale = scale;
+                }
+                return;
+            }
+        }
+    };
+    
+    std::vector<std::thread> threadList;
+    for(int t = 1; t < threadCnt; t++) {
+        threadList.push_back(std::thread(work, t, n * t / threadCnt, n * (t + 1) / threadCnt));
+    }
+    work(0, 0, n / threadCnt);
+    for(auto && th : threadList) {
+        th.join();
+    }
+    
+    gammas = buf[lastBuf];
+    for(auto && g : gammas) {
+        g *= lastScale;
+    }
+    
+    // Elo, error bars from the Fisher information of each player (others taken as known)
+    const auto c = std::log(10.0) / 400;
+    ratings.resize(size_t(n));
+    auto sum = 0.0;
+    for(int i = 0; i < n; i++) {
+        auto gi = gammas[size_t(i)];
+        auto p = gi / (gi + 1.0);
+        auto info = priorGames * p * (1 - p);
+        for(int j = 0; j < n; j++) {
+            auto games = matrix[size_t(i * n + j)].games;
+            if (games) {
+                p = gi / (gi + gammas[size_t(j)]);
+                info += games * p * (1 - p);
+            }
+        }
+        
+        auto& r = ratings[size_t(i)];
+        r.rating = 400 * std::log10(gi);
+        r.error = 1.96 / (c * std::sqrt(info));
+        sum += r.rating;
+    }
+    
+    for(auto && r : ratings) {
+        r.rating -= sum / n;
+    }
+}
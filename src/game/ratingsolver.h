@@ -0,0 +1,97 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef ratingsolver_h
+#define ratingsolver_h
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    class PlayerRating
+    {
+    public:
+        double rating = 0, error = 0; // Elo, average zero; 95% error bar
+    };
+    
+    // Joint maximum-likelihood ratings of all players (Bradley-Terry model with logistic Elo, a draw
+    // is half a win), like BayesElo/Ordo. Results are kept in a pairwise matrix updated game by
+    // game, the solving is done only when asked and when there are new results, from the last
+    // ratings, with iterations split among threads for large fields
+    class RatingSolver : public Obj
+    {
+    private:
+        class Cell
+        {
+        public:
+            int games = 0, points2 = 0; // points of the row player, doubled
+        };
+        
+    public:
+        virtual const char* className() const override { return "RatingSolver"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        void clear();
+        // score: of the first player, 0, 0.5 or 1
+        void addResult(const std::string& name0, const std::string& name1, double score);
+        
+        // solves if needed, empty names are unknown players
+        std::unordered_map<std::string, PlayerRating> getRatings();
+        
+        // points and games of name0 against name1, false if they have not played
+        bool getPairResult(const std::string& name0, const std::string& name1, double& points, int& games) const;
+        
+    private:
+        int getIndex(const std::string& name);
+        void solve();
+        
+    private:
+        // virtual draws of each player against an average one, they keep perfect scores finite
+        const double priorGames = 2;
+        const double tolerance = 1e-6;
+        const int maxIterations = 10000;
+        // below this, one thread does all
+        const int minPlayersPerThread = 64;
+        
+        mutable std::mutex solverMutex;
+        
+        std::vector<std::string> nameList;
+        std::unordered_map<std::string, int> indexMap;
+        std::vector<Cell> matrix; // cnt x cnt, row major
+        int cnt = 0;
+        
+        std::vector<double> gammas; // 10 ^ (rating / 400)
+        std::vector<PlayerRating> ratings;
+        bool dirty = false;
+    };
+    
+} // namespace banksia
+
+#endif /* ratingsolver_h */
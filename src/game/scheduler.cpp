@@ -0,0 +1,124 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+
+#include "scheduler.h"
+
+using namespace banksia;
+
+EventScheduler* EventScheduler::instance = nullptr;
+
+EventScheduler::EventScheduler()
+{
+}
+
+EventScheduler::~EventScheduler()
+{
+    shutdown();
+    if (instance == this) {
+        instance = nullptr;
+    }
+}
+
+void EventScheduler::post()
+{
+    if (instance) {
+        instance->notify();
+    }
+}
+
+void EventScheduler::notify()
+{
+    {
+        std::lock_guard<std::mutex> dolock(queueMutex);
+        if (!running) {
+            return;
+        }
+        eventCnt++;
+    }
+    queueCondition.notify_one();
+}
+
+void EventScheduler::start(std::function<int()> _handler)
+{
+    assert(pThread == nullptr);
+    handler = _handler;
+    running = true;
+    
+    // only a started one takes events, tournaments of a batch leave theirs unused
+    instance = this;
+    pThread = new std::thread([=]() { run(); });
+}
+
+void EventScheduler::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> dolock(queueMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+        if (instance == this) {
+            instance = nullptr;
+        }
+    }
+    queueCondition.notify_one();
+    
+    if (pThread) {
+        // the handler may finish the tournament by itself
+        if (pThread->get_id() == std::this_thread::get_id()) {
+            pThread->detach();
+        } else if (pThread->joinable()) {
+            pThread->join();
+        }
+        delete pThread;
+        pThread = nullptr;
+    }
+}
+
+void EventScheduler::run()
+{
+    auto waitMs = max_wait_ms;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait_for(lock, std::chrono::milliseconds(waitMs), [&]() {
+                return eventCnt > 0 || !running;
+            });
+            
+            if (!running) {
+                break;
+            }
+            eventCnt = 0;
+        }
+        
+        // new events or a deadline reached
+        waitMs = std::max(1, std::min(max_wait_ms, (handler)()));
+    }
+}
+
@@ -0,0 +1,73 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace banksia {
+    
+    // Wakes the tournament up as soon as something happens (engine state changed,
+    // bestmove received, process exited, game state changed) instead of waiting
+    // for the next periodic tick. Events are coalesced, the handler re-examines
+    // all games and returns the time (ms) until the nearest deadline
+    class EventScheduler
+    {
+    public:
+        EventScheduler();
+        ~EventScheduler();
+        
+        // the started one
+        static EventScheduler* instance;
+        
+        // safe to call from any thread, never blocks on the handler
+        static void post();
+        
+        void start(std::function<int()> handler);
+        void shutdown();
+        
+    private:
+        void notify();
+        void run();
+        
+        const int max_wait_ms = 1000;
+        
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        int eventCnt = 0;
+        bool running = false;
+        
+        std::function<int()> handler = nullptr;
+        std::thread* pThread = nullptr;
+    };
+    
+} // namespace banksia
+
+#endif /* scheduler_h */
+
@@ -0,0 +1,151 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+#include "sprt.h"
+
+using namespace banksia;
+
+bool Sprt::isValid() const
+{
+    return elo0 < elo1 && alpha > 0 && alpha < 0.5 && beta > 0 && beta < 0.5;
+}
+
+std::string Sprt::toString() const
+{
+    static const char* stateNames[] = { "running", "H0 accepted", "H1 accepted" };
+    
+    std::ostringstream stringStream;
+    stringStream.precision(2);
+    stringStream << std::fixed
+    << "SPRT: elo0: " << elo0 << ", elo1: " << elo1 << ", alpha: " << alpha << ", beta: " << beta
+    << ", LLR: " << llr() << " (" << lowerBound() << ", " << upperBound() << ")"
+    << ", pairs: " << getPairCnt()
+    << ", pentanomial: " << penta[0] << " " << penta[1] << " " << penta[2] << " " << penta[3] << " " << penta[4]
+    << ", " << stateNames[static_cast<int>(state)];
+    return stringStream.str();
+}
+
+bool Sprt::load(const Json::Value& obj)
+{
+    mode = obj.isMember("mode") && obj["mode"].asBool();
+    if (obj.isMember("elo0")) {
+        elo0 = obj["elo0"].asDouble();
+    }
+    if (obj.isMember("elo1")) {
+        elo1 = obj["elo1"].asDouble();
+    }
+    if (obj.isMember("alpha")) {
+        alpha = obj["alpha"].asDouble();
+    }
+    if (obj.isMember("beta")) {
+        beta = obj["beta"].asDouble();
+    }
+    return isValid();
+}
+
+Json::Value Sprt::saveToJson() const
+{
+    Json::Value obj;
+    obj["mode"] = mode;
+    obj["elo0"] = elo0;
+    obj["elo1"] = elo1;
+    obj["alpha"] = alpha;
+    obj["beta"] = beta;
+    return obj;
+}
+
+void Sprt::clear()
+{
+    for(auto && n : penta) {
+        n = 0;
+    }
+    state = SprtState::running;
+}
+
+int Sprt::getPairCnt() const
+{
+    return penta[0] + penta[1] + penta[2] + penta[3] + penta[4];
+}
+
+void Sprt::addPair(double score)
+{
+    auto k = std::max(0, std::min(4, int(score * 2 + 0.5)));
+    penta[k]++;
+    
+    // once decided, the state is kept for the games still in play
+    if (state == SprtState::running) {
+        auto r = llr();
+        if (r >= upperBound()) {
+            state = SprtState::h1;
+        } else if (r <= lowerBound()) {
+            state = SprtState::h0;
+        }
+    }
+}
+
+double Sprt::lowerBound() const
+{
+    return std::log(beta / (1 - alpha));
+}
+
+double Sprt::upperBound() const
+{
+    return std::log((1 - beta) / alpha);
+}
+
+// The GSPRT approximation of the log-likelihood ratio: pair scores are normalised to 0..1,
+// empty entries get half a count, otherwise a few one-sided pairs have almost no variance and decide at once
+double Sprt::llr() const
+{
+    auto n = getPairCnt();
+    if (n == 0) {
+        return 0;
+    }
+    
+    double cnt[5], total = 0;
+    for(int i = 0; i < 5; i++) {
+        cnt[i] = std::max(0.5, double(penta[i]));
+        total += cnt[i];
+    }
+    
+    double mu = 0;
+    for(int i = 0; i < 5; i++) {
+        mu += cnt[i] / total * i * 0.25;
+    }
+    double var = 0;
+    for(int i = 0; i < 5; i++) {
+        auto d = i * 0.25 - mu;
+        var += cnt[i] / total * d * d;
+    }
+    if (var <= 0) {
+        return 0;
+    }
+    
+    auto s0 = 1 / (1 + std::pow(10.0, -elo0 / 400)), s1 = 1 / (1 + std::pow(10.0, -elo1 / 400));
+    return total * (s1 - s0) * (2 * mu - s0 - s1) / (2 * var);
+}
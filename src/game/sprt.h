@@ -0,0 +1,75 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef sprt_h
+#define sprt_h
+
+#include <string>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    enum class SprtState {
+        running, h0, h1
+    };
+    
+    // Sequential probability ratio test of the logistic Elo of a player (the tested one) against its opponents.
+    // Games are taken by pairs (same opening, swapped sides) and counted in a pentanomial model
+    // of the pair scores 0, 1/2, 1, 3/2, 2, see https://www.chessprogramming.org/Sequential_Probability_Ratio_Test
+    class Sprt : public Jsonable
+    {
+    public:
+        virtual const char* className() const override { return "Sprt"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        virtual bool load(const Json::Value& obj) override;
+        virtual Json::Value saveToJson() const override;
+        
+        void clear();
+        
+        // score of the tested player in a pair of games, from 0 to 2
+        void addPair(double score);
+        
+        double llr() const;
+        double lowerBound() const;
+        double upperBound() const;
+        
+        SprtState getState() const { return state; }
+        int getPairCnt() const;
+        
+    public:
+        bool mode = false;
+        double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+        
+    private:
+        int penta[5] = { 0, 0, 0, 0, 0 };
+        SprtState state = SprtState::running;
+    };
+    
+} // namespace banksia
+
+#endif /* sprt_h */
@@ -0,0 +1,234 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include "syzygyprober.h"
+#include "scheduler.h"
+
+using namespace banksia;
+
+SyzygyProber* SyzygyProber::instance = nullptr;
+
+SyzygyProber::SyzygyProber()
+: cache(new std::atomic<u64>[size_t(1) << cache_bits])
+{
+    for(size_t i = 0; i < (size_t(1) << cache_bits); i++) {
+        cache[i] = 0;
+    }
+}
+
+SyzygyProber::~SyzygyProber()
+{
+    shutdown();
+    if (instance == this) {
+        instance = nullptr;
+    }
+}
+
+void SyzygyProber::start(int threadCnt)
+{
+    assert(threadList.empty());
+    running = true;
+    if (!instance) {
+        instance = this;
+    }
+    for(int i = 0; i < std::max(1, threadCnt); i++) {
+        threadList.push_back(std::thread([=]() { run(); }));
+    }
+}
+
+void SyzygyProber::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> dolock(queueMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+        queue.clear();
+        if (instance == this) {
+            instance = nullptr;
+        }
+    }
+    queueCondition.notify_all();
+    
+    for(auto && t : threadList) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threadList.clear();
+}
+
+bool SyzygyProber::probe(std::shared_ptr<SyzygyProbe> probe)
+{
+    assert(probe && !probe->done);
+    if (findCache(*probe)) {
+        probe->done = true;
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> dolock(queueMutex);
+        if (running) {
+            queue.push_back(probe);
+            queueCondition.notify_one();
+            return false;
+        }
+    }
+    
+    // no thread to work, probe here
+    probe->result = ChessBoard::probeSyzygy(probe->pos, probe->tberror);
+    saveCache(*probe);
+    probe->done = true;
+    return true;
+}
+
+void SyzygyProber::run()
+{
+    while (true) {
+        std::shared_ptr<SyzygyProbe> probe;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [&]() {
+                return !queue.empty() || !running;
+            });
+            
+            if (!running) {
+                break;
+            }
+            probe = queue.front();
+            queue.pop_front();
+        }
+        
+        // the same position may have been probed while this one waited
+        if (!findCache(*probe, false)) {
+            probe->result = ChessBoard::probeSyzygy(probe->pos, probe->tberror);
+            saveCache(*probe);
+        }
+        probe->done = true;
+        EventScheduler::post();
+    }
+}
+
+bool SyzygyProber::findCache(SyzygyProbe& probe, bool counting)
+{
+    auto key = cacheKey(probe);
+    auto entry = cache[(key >> 8) & ((size_t(1) << cache_bits) - 1)].load(std::memory_order_relaxed);
+    if (!(entry & 0x80) || (entry ^ key) >> 8) {
+        if (counting) {
+            missCnt.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    
+    if (counting) {
+        hitCnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    probe.tberror = (entry & 0x40) != 0;
+    probe.result.result = static_cast<ResultType>(entry & 0x3f);
+    probe.result.reason = probe.result.result == ResultType::noresult ? ReasonType::noreason : ReasonType::adjudication;
+    return true;
+}
+
+void SyzygyProber::saveCache(const SyzygyProbe& probe)
+{
+    auto key = cacheKey(probe);
+    u64 value = 0x80 | (probe.tberror ? 0x40 : 0) | static_cast<u64>(probe.result.result);
+    cache[(key >> 8) & ((size_t(1) << cache_bits) - 1)].store((key & ~0xffULL) | value, std::memory_order_relaxed);
+}
+
+std::string SyzygyProber::toString() const
+{
+    auto hits = hitCnt.load(), misses = missCnt.load();
+    std::ostringstream stringStream;
+    stringStream << "Tablebase cache hits: " << hits << ", misses: " << misses
+    << ", hit rate: " << (hits * 100 / std::max<u64>(1, hits + misses)) << "%";
+    return stringStream.str();
+}
+
+void SyzygyProber::warmup(const std::string& paths, int maxPieces)
+{
+#ifdef _WIN32
+    const char sepChar = ';';
+#else
+    const char sepChar = ':';
+#endif
+    
+    // WDL files first, they are the ones adjudication probes most
+    std::vector<std::string> fileList;
+    for(auto && suffix : { ".rtbw", ".rtbz" }) {
+        for(auto && dir : splitString(paths, sepChar)) {
+            for(auto && path : listdir(dir)) {
+                auto p = path.find_last_of("/\\");
+                auto name = p == std::string::npos ? path : path.substr(p + 1);
+                auto dot = name.find('.');
+                if (dot == std::string::npos || name.substr(dot) != suffix) {
+                    continue;
+                }
+                auto pieceCnt = 0;
+                for(size_t i = 0; i < dot; i++) {
+                    pieceCnt += name[i] != 'v';
+                }
+                if (pieceCnt <= maxPieces) {
+                    fileList.push_back(path);
+                }
+            }
+        }
+    }
+    
+    auto startTime = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextIdx { 0 };
+    std::atomic<i64> totalSize { 0 };
+    
+    // several readers keep a network share busy
+    auto work = [&]() {
+        std::vector<char> buf(1024 * 1024);
+        for(auto k = nextIdx++; k < fileList.size(); k = nextIdx++) {
+            std::ifstream file(fileList[k], std::ios::binary);
+            while (file.read(buf.data(), buf.size()) || file.gcount() > 0) {
+                totalSize += file.gcount();
+            }
+        }
+    };
+    
+    std::vector<std::thread> threadList;
+    for(int i = 0; i < 4; i++) {
+        threadList.push_back(std::thread(work));
+    }
+    for(auto && t : threadList) {
+        t.join();
+    }
+    
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Syzygy warmup: " << fileList.size() << " files, "
+    << totalSize / (1024 * 1024) << " MB, "
+    << std::fixed << std::setprecision(2) << elapsed << "s" << std::endl;
+}
@@ -0,0 +1,104 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef syzygyprober_h
+#define syzygyprober_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "../chess/chess.h"
+
+namespace banksia {
+    
+    // A probe request, shared by the game which asks and the thread which answers
+    class SyzygyProbe
+    {
+    public:
+        SyzygyPos pos;
+        u64 key = 0;
+        size_t ply = 0; // number of moves made when the position was taken
+        
+        Result result;
+        bool tberror = false;
+        std::atomic<bool> done { false };
+    };
+    
+    // Probes the tablebases on its own threads so a slow probe (cold files, network
+    // shares) never holds a game. Games pick up the result on their next update.
+    // Results are kept in a lock-free cache shared by all games
+    class SyzygyProber
+    {
+    public:
+        SyzygyProber();
+        ~SyzygyProber();
+        
+        // the first started one, shared by all tournaments of a batch
+        static SyzygyProber* instance;
+        
+        void start(int threadCnt = 1);
+        void shutdown();
+        bool isRunning() const { return running; }
+        
+        // returns true if the probe has been answered from the cache right away
+        bool probe(std::shared_ptr<SyzygyProbe> probe);
+        
+        std::string toString() const;
+        
+        // reads the tablebase files of up to maxPieces pieces so the operating system
+        // keeps them in its cache before any game needs them
+        static void warmup(const std::string& paths, int maxPieces);
+        
+    private:
+        void run();
+        
+        // castling and en passant are in the hash key already, root probes depend on rule50 too
+        static u64 cacheKey(const SyzygyProbe& probe) { return probe.key ^ (probe.pos.rule50 * 0x9e3779b97f4a7c15ULL); }
+        bool findCache(SyzygyProbe& probe, bool counting = true);
+        void saveCache(const SyzygyProbe& probe);
+        
+        static const int cache_bits = 16;
+        
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<std::shared_ptr<SyzygyProbe>> queue;
+        bool running = false;
+        std::vector<std::thread> threadList;
+        
+        // an entry is the key with the low byte replaced by the value: bit 7 for used,
+        // bit 6 for probing errors and the result type. Racing writers may overwrite
+        // each other, a reader then misses or finds another full entry, never a torn one
+        std::unique_ptr<std::atomic<u64>[]> cache;
+        std::atomic<u64> hitCnt { 0 }, missCnt { 0 };
+    };
+    
+} // namespace banksia
+
+#endif /* syzygyprober_h */
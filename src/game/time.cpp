@@ -23,6 +23,7 @@
  */
 
 #include "time.h"
+#include "../base/metrics.h"
 
 using namespace banksia;
 
@@ -49,6 +50,11 @@ void TimeController::setup(TimeControlMode _mode, int val, double t0, double t1,
             increment = t1;
             margin = t2;
             break;
+        case TimeControlMode::nodes:
+            nodes = val;
+            time = t0 > 0 ? t0 : default_nodes_time_cap;
+            margin = 0;
+            break;
         default:
             break;
     }
@@ -59,7 +65,7 @@ TimeController::~TimeController()
 }
 
 static const char* timeControllerNams[] = {
-    "infinite", "depth", "movetime", "standard", nullptr
+    "infinite", "depth", "movetime", "standard", "nodes", nullptr
 };
 
 TimeControlMode TimeController::string2TimeControlMode(const std::string& name)
@@ -90,6 +96,9 @@ std::string TimeController::toString() const
         case TimeControlMode::standard:
             stringStream << moves << "/" << time << ":" << increment;
             break;
+        case TimeControlMode::nodes:
+            stringStream << timeControllerNams[t] << ":" << nodes;
+            break;
             
         default:
             break;
@@ -109,6 +118,8 @@ bool TimeController::isValid() const
                 return time > 0;
             case TimeControlMode::standard:
                 return moves >= 0 && time > 0 && increment >= 0 && margin >= 0;
+            case TimeControlMode::nodes:
+                return nodes > 0 && time > 0;
                 
             default:
                 break;
@@ -155,7 +166,8 @@ bool TimeController::load(const Json::Value& obj)
             return depth > 0;
             
         case TimeControlMode::movetime:
-            return parseTime(obj);
+            latencyCompensation = obj.isMember("latency compensation") ? obj["latency compensation"].asDouble() : 0;
+            return parseTime(obj) && latencyCompensation >= 0;
             
         case TimeControlMode::standard:
             if (!obj.isMember("time")
@@ -169,7 +181,17 @@ bool TimeController::load(const Json::Value& obj)
             moves = obj["moves"].asInt();
             increment = obj["increment"].asDouble();
             margin = obj.isMember("margin") ? obj["margin"].asDouble() : 0;
-            return increment >= 0 && margin >= 0 && moves >= 0;
+            latencyCompensation = obj.isMember("latency compensation") ? obj["latency compensation"].asDouble() : 0;
+            return increment >= 0 && margin >= 0 && moves >= 0 && latencyCompensation >= 0;
+            
+        case TimeControlMode::nodes:
+            if (!obj.isMember("nodes")) return false;
+            nodes = obj["nodes"].asInt64();
+            if (!obj.isMember("time") || !parseTime(obj)) {
+                time = default_nodes_time_cap;
+            }
+            margin = 0;
+            return nodes > 0;
             
         default:
             return false;
@@ -191,12 +213,18 @@ Json::Value TimeController::saveToJson() const
             break;
         case TimeControlMode::movetime:
             obj["time"] = time;
+            obj["latency compensation"] = latencyCompensation;
             break;
         case TimeControlMode::standard:
             obj["moves"] = moves;
             obj["time"] = time;
             obj["increment"] = increment;
             obj["margin"] = margin;
+            obj["latency compensation"] = latencyCompensation;
+            break;
+        case TimeControlMode::nodes:
+            obj["nodes"] = Json::Int64(nodes);
+            obj["time"] = time;
             break;
             
         default:
@@ -214,6 +242,8 @@ void TimeController::cloneFrom(const TimeController& other)
     time = other.time;
     increment = other.increment;
     margin = other.margin;
+    nodes = other.nodes;
+    latencyCompensation = other.latencyCompensation;
 }
 
 ////////////////////////
@@ -227,16 +257,44 @@ GameTimeController::~GameTimeController()
 
 void GameTimeController::startMoveTimeClock()
 {
-    moveStartClock = std::chrono::system_clock::now();
+    thinkStartClock = moveStartClock = std::chrono::steady_clock::now();
+    lastMoveOverhead = 0;
+}
+
+void GameTimeController::startEngineClock(const std::chrono::steady_clock::time_point& writeClock)
+{
+    // writing the go command may be delayed (e.g. a Winboard engine is being synced)
+    if (writeClock > thinkStartClock) {
+        moveStartClock = writeClock;
+    }
+    
+    if (bestmoveRead) {
+        bestmoveRead = false;
+        Metrics::add(MetricHist::bestmoveToGo, bestmoveClock, writeClock);
+    }
 }
 
 // unit: second
+double GameTimeController::engineTime(const std::chrono::steady_clock::time_point& clock) const
+{
+    auto ms = std::chrono::duration <double, std::milli> (clock - moveStartClock).count();
+    return std::max(0.0, ms / 1000 - latencyCompensation); // convert into second
+}
+
 double GameTimeController::moveTimeConsumed() const
 {
-    auto diff = std::chrono::system_clock::now() - moveStartClock;
-    auto ms = std::chrono::duration <double, std::milli> (diff).count();
-	assert(ms >= 0);
-    return double(ms) / 1000; // convert into second
+    return engineTime(std::chrono::steady_clock::now());
+}
+
+double GameTimeController::moveTimeConsumed(const std::chrono::steady_clock::time_point& readClock)
+{
+    // before the go command reached the pipe and after the bestmove was read
+    auto now = std::chrono::steady_clock::now();
+    auto ms = std::chrono::duration <double, std::milli> ((moveStartClock - thinkStartClock) + (now - std::min(now, readClock))).count();
+    lastMoveOverhead = ms / 1000;
+    bestmoveClock = readClock;
+    bestmoveRead = true;
+    return engineTime(std::min(now, readClock));
 }
 
 double GameTimeController::getTimeLeft(int sd) const
@@ -245,34 +303,49 @@ double GameTimeController::getTimeLeft(int sd) const
     return timeLeft[sd];
 }
 
-bool GameTimeController::isTimeOver(Side side)
+bool GameTimeController::isTimeOver(Side side, double consumed)
 {
-    if (mode != TimeControlMode::movetime && mode != TimeControlMode::standard) {
+    if (mode != TimeControlMode::movetime && mode != TimeControlMode::standard && mode != TimeControlMode::nodes) {
         return false;
     }
     
     auto sd = static_cast<int>(side);
     
-    lastQueryConsumed = moveTimeConsumed();
+    lastQueryConsumed = consumed < 0 ? moveTimeConsumed() : consumed;
     if (lastQueryConsumed >= timeLeft[sd] + margin) {
         return true;
     }
     return false;
 }
 
+// unit: second, negative if there is no time limit
+double GameTimeController::timeBeforeTimeOver(Side side) const
+{
+    if (mode != TimeControlMode::movetime && mode != TimeControlMode::standard && mode != TimeControlMode::nodes) {
+        return -1;
+    }
+    
+    auto sd = static_cast<int>(side);
+    return std::max(0.0, timeLeft[sd] + margin - moveTimeConsumed());
+}
+
 
 void GameTimeController::setupClocksBeforeThinking(int halfMoveCnt)
 {
-    if (mode == TimeControlMode::movetime || halfMoveCnt == 0) {
+    // each node limited move has the whole cap
+    if (mode == TimeControlMode::movetime || mode == TimeControlMode::nodes || halfMoveCnt == 0) {
         timeLeft[0] = timeLeft[1] = time;
     }
+    if (halfMoveCnt == 0) {
+        bestmoveRead = false;
+    }
     
     startMoveTimeClock();
 }
 
 void GameTimeController::udateClockAfterMove(double moveElapse, Side side, int halfMoveCnt)
 {
-    assert(moveElapse > 0 && halfMoveCnt > 0);
+    assert(moveElapse >= 0 && halfMoveCnt > 0);
     
     if (mode != TimeControlMode::standard) {
         return;
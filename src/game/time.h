@@ -30,13 +30,14 @@
 #include <functional>
 #include <map>
 #include <mutex>
+#include <chrono>
 
 #include "../base/comm.h"
 
 namespace banksia {
     
     enum class TimeControlMode {
-        infinite, depth, movetime, standard, none
+        infinite, depth, movetime, standard, nodes, none
     };
     
     class TimeController : public Jsonable
@@ -63,6 +64,13 @@ namespace banksia {
         TimeControlMode mode;
         int depth, moves;
         double time, increment, margin;
+        
+        // per move for mode nodes, time is then a wall clock cap of each move
+        int64_t nodes = 0;
+        static const int default_nodes_time_cap = 60; // second
+        
+        // second, taken from each measured move for the pipe latency the manager can't see
+        double latencyCompensation = 0;
 
     private:
         bool parseTime(const Json::Value& obj);
@@ -79,20 +87,35 @@ namespace banksia {
         void setupClocksBeforeThinking(int halfMoveCnt);
         void udateClockAfterMove(double moveElapse, Side side, int halfMoveCnt);
         
-        bool isTimeOver(Side side);
+        // the clock of the side to move runs from the time its go command has been written
+        void startEngineClock(const std::chrono::steady_clock::time_point& writeClock);
+        
+        // a negative consumed is measured now
+        bool isTimeOver(Side side, double consumed = -1);
+        double timeBeforeTimeOver(Side side) const;
         virtual bool isValid() const override;
         double moveTimeConsumed() const;
+        // until the bestmove has been received, also measures lastMoveOverhead
+        double moveTimeConsumed(const std::chrono::steady_clock::time_point& readClock);
 
         double getTimeLeft(int sd) const;
 
         double lastQueryConsumed = 0;
         
+        // second, time of the last move spent by the manager, not charged to the engine
+        double lastMoveOverhead = 0;
+        
     private:
         double timeLeft[2];
         
         void startMoveTimeClock();
+        double engineTime(const std::chrono::steady_clock::time_point& clock) const;
+        
+        std::chrono::steady_clock::time_point thinkStartClock, moveStartClock;
         
-        std::chrono::system_clock::time_point moveStartClock;
+        // for the manager's part between a bestmove and the next go
+        std::chrono::steady_clock::time_point bestmoveClock;
+        bool bestmoveRead = false;
     };
     
 } // namespace banksia
@@ -0,0 +1,249 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <limits>
+
+#include "tourbatch.h"
+
+using namespace banksia;
+
+void ConcurrencyBudget::setLimit(int _limit)
+{
+    std::lock_guard<std::mutex> dolock(budgetMutex);
+    limit = std::max(1, _limit);
+}
+
+int ConcurrencyBudget::add(int priority)
+{
+    std::lock_guard<std::mutex> dolock(budgetMutex);
+    Member member;
+    member.priority = priority;
+    memberList.push_back(member);
+    return int(memberList.size()) - 1;
+}
+
+void ConcurrencyBudget::update(int id, int used, bool waiting)
+{
+    std::lock_guard<std::mutex> dolock(budgetMutex);
+    if (id < 0 || id >= int(memberList.size())) {
+        return;
+    }
+    memberList[id].used = used;
+    memberList[id].waiting = waiting;
+}
+
+bool ConcurrencyBudget::acquire(int id)
+{
+    std::lock_guard<std::mutex> dolock(budgetMutex);
+    if (id < 0 || id >= int(memberList.size())) {
+        return false;
+    }
+    
+    auto& member = memberList[id];
+    auto total = 0;
+    auto higherWaiting = false;
+    for(auto && m : memberList) {
+        total += m.used;
+        higherWaiting = higherWaiting || (m.waiting && m.priority > member.priority);
+    }
+    
+    if (total >= limit || higherWaiting) {
+        member.waiting = true;
+        return false;
+    }
+    
+    member.used++;
+    member.waiting = false;
+    return true;
+}
+
+/////////////////////////////////////////
+TourBatch::TourBatch()
+: finishedCnt(0)
+{
+}
+
+TourBatch::~TourBatch()
+{
+    for(auto && tourMng : tourList) {
+        delete tourMng;
+    }
+    tourList.clear();
+}
+
+std::vector<std::string> TourBatch::findTourFiles(const std::string& folder)
+{
+    std::vector<std::string> pathList;
+    for(auto && path : listdir(folder)) {
+        if (path.size() < 5 || path.substr(path.size() - 5) != ".json") {
+            continue;
+        }
+        
+        // engine configurations and resume files are json files too
+        Json::Value d;
+        if (JsonSavable::loadFromJsonFile(path, d, false) && d.isObject()
+            && d.isMember("base") && d.isMember("time control")) {
+            pathList.push_back(path);
+        }
+    }
+    
+    std::sort(pathList.begin(), pathList.end());
+    return pathList;
+}
+
+bool TourBatch::start(const std::vector<std::string>& pathList, int concurrency, bool yesReply, bool noReply)
+{
+    if (pathList.empty()) {
+        std::cerr << "Error: there is no tour file for the batch" << std::endl;
+        return false;
+    }
+    
+    // the tournaments check cores for it
+    if (concurrency > 0) {
+        budget.setLimit(concurrency);
+    }
+    
+    auto maxConcurrency = 1;
+    for(auto && path : pathList) {
+        std::cout << "\nBatch, tournament " << (tourList.size() + 1) << "/" << pathList.size() << ": " << path << std::endl;
+        
+        auto tourMng = new TourMng;
+        tourMng->setBatch(this);
+        tourList.push_back(tourMng);
+        
+        // its games wait for the timer and the events of the batch
+        if (!tourMng->start(path, yesReply, noReply)) {
+            std::cerr << "Error: can't start the tournament " << path << std::endl;
+            return false;
+        }
+        maxConcurrency = std::max(maxConcurrency, tourMng->gameConcurrency);
+    }
+    
+    budget.setLimit(concurrency > 0 ? concurrency : maxConcurrency);
+    
+    // the override options are shared, engines of prepared games run with their hashes too
+    auto engineCnt = budget.getLimit();
+    for(auto && tourMng : tourList) {
+        engineCnt += tourMng->lookahead;
+    }
+    if (!tourList.front()->planEngineMemory(engineCnt * 2)) {
+        return false;
+    }
+    
+    std::stable_sort(tourList.begin(), tourList.end(), [](const TourMng* a, const TourMng* b) {
+        return a->getPriority() > b->getPriority();
+    });
+    
+    std::cout << "Batch started, tournaments: " << tourList.size() << ", concurrency: " << budget.getLimit() << std::endl;
+    
+    startTime = time(nullptr);
+    mainTimerId = timer.add(std::chrono::milliseconds(500), [=](CppTime::timer_id) { tick(); }, std::chrono::milliseconds(500));
+    mainTimerOn = true;
+    scheduler.start([=]() { return processEvents(); });
+    EventScheduler::post();
+    return true;
+}
+
+bool TourBatch::takeSharedSetting(const std::string& name, const Json::Value& value, const std::string& tourPath)
+{
+    auto it = sharedSettingMap.find(name);
+    if (it == sharedSettingMap.end()) {
+        sharedSettingMap[name] = value;
+        return true;
+    }
+    
+    if (it->second != value) {
+        std::cerr << "Warning: \"" << name << "\" of " << tourPath << " is ignored, tournaments of a batch use the one of the first tournament" << std::endl;
+    }
+    return false;
+}
+
+void TourBatch::tickWork()
+{
+    playerMng.tick();
+    
+    for(auto && tourMng : tourList) {
+        tourMng->tick();
+    }
+}
+
+int TourBatch::processEvents()
+{
+    auto waitTime = std::numeric_limits<int>::max();
+    for(auto && tourMng : tourList) {
+        waitTime = std::min(waitTime, tourMng->processEvents());
+    }
+    return waitTime;
+}
+
+void TourBatch::tourFinished(TourMng* tourMng)
+{
+    // the slots of the finished one are free for the others
+    budget.update(tourMng->budgetId, 0, false);
+    EventScheduler::post();
+    
+    if (++finishedCnt < int(tourList.size())) {
+        return;
+    }
+    
+    auto elapsed_secs = static_cast<int>(time(nullptr) - startTime);
+    std::cout << "Batch finished! Tournaments: " << tourList.size() << ", elapsed: " << formatPeriod(elapsed_secs) << std::endl;
+    
+    // WARNING: exit the app here after completed all tournaments
+    shutdown();
+    exit(0);
+}
+
+std::string TourBatch::createTournamentStats()
+{
+    std::ostringstream stringStream;
+    for(auto && tourMng : tourList) {
+        stringStream << "Tournament: " << tourMng->getJsonPath()
+        << (tourMng->state == TourState::done ? ", finished" : "")
+        << ", priority: " << tourMng->getPriority() << std::endl;
+        stringStream << tourMng->createTournamentStats() << std::endl;
+    }
+    return stringStream.str();
+}
+
+void TourBatch::shutdown()
+{
+    if (mainTimerOn) {
+        mainTimerOn = false;
+        timer.remove(mainTimerId);
+    }
+    scheduler.shutdown();
+    
+    // finished ones are shut down already
+    for(auto && tourMng : tourList) {
+        if (tourMng->state != TourState::done) {
+            tourMng->shutdown();
+        }
+    }
+    syzygyProber.shutdown();
+    playerMng.shutdown();
+}
@@ -0,0 +1,115 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef tourbatch_h
+#define tourbatch_h
+
+#include <atomic>
+
+#include "tourmng.h"
+
+namespace banksia {
+    
+    // Game slots shared by the tournaments of a batch. One may start a game only while
+    // all play fewer games than the limit and none of a higher priority waits for a slot
+    class ConcurrencyBudget
+    {
+    public:
+        void setLimit(int limit);
+        int getLimit() const { return limit; }
+        
+        // returns the id of the new member
+        int add(int priority);
+        
+        // playing games of the member, waiting when it has matches to start
+        void update(int id, int used, bool waiting);
+        bool acquire(int id);
+        
+    private:
+        struct Member {
+            int priority = 0, used = 0;
+            bool waiting = false;
+        };
+        
+        std::mutex budgetMutex;
+        std::vector<Member> memberList;
+        int limit = 1;
+    };
+    
+    // Several tournaments played by one process. They share engines, game slots, the
+    // timer and the event loop; books and tablebases are loaded once for all of them
+    class TourBatch : public Obj, public Tickable
+    {
+    public:
+        TourBatch();
+        virtual ~TourBatch();
+        
+        virtual const char* className() const override { return "TourBatch"; }
+        
+        // tour files of a folder and its subfolders, the json files with "base" and "time control"
+        static std::vector<std::string> findTourFiles(const std::string& folder);
+        
+        // the concurrency of the batch is the largest one of the tournaments if it is not given
+        bool start(const std::vector<std::string>& pathList, int concurrency, bool yesReply, bool noReply);
+        
+        PlayerMng* getPlayerMng() { return &playerMng; }
+        SyzygyProber& getSyzygyProber() { return syzygyProber; }
+        // the path the tablebases were initialized with, they are loaded once for all tournaments
+        std::string& getTbInitPath() { return tbInitPath; }
+        ConcurrencyBudget& getBudget() { return budget; }
+        
+        // the first tournament sets the values all share, differing ones of the others are ignored
+        bool takeSharedSetting(const std::string& name, const Json::Value& value, const std::string& tourPath);
+        
+        // the app exits when the last one finishes
+        void tourFinished(TourMng* tourMng);
+        
+        std::string createTournamentStats();
+        void shutdown();
+        
+    private:
+        void tickWork() override;
+        int processEvents();
+        
+        CppTime::Timer timer;
+        CppTime::timer_id mainTimerId;
+        bool mainTimerOn = false;
+        EventScheduler scheduler;
+        
+        PlayerMng playerMng;
+        SyzygyProber syzygyProber;
+        std::string tbInitPath;
+        ConcurrencyBudget budget;
+        
+        // by priorities, the highest first
+        std::vector<TourMng*> tourList;
+        std::map<std::string, Json::Value> sharedSettingMap;
+        
+        std::atomic<int> finishedCnt;
+        time_t startTime;
+    };
+    
+} // namespace banksia
+
+#endif /* tourbatch_h */
@@ -28,10 +28,14 @@
 #include <cmath>
 #include <algorithm>
 #include <random>
+#include <limits>
 #include <ctime>
 #include <cmath>
 
 #include "tourmng.h"
+#include "tourbatch.h"
+#include "../base/memoryplanner.h"
+#include "../base/metrics.h"
 
 #include "../3rdparty/json/json.h"
 #include "../3rdparty/fathom/tbprobe.h"
@@ -52,25 +56,27 @@ std::string MatchRecord::toString() const
     return stringStream.str();
 }
 
-bool MatchRecord::load(const Json::Value& obj)
+bool MatchRecord::load(const Json::Value& obj, OpeningTable& openingTable)
 {
     auto array = obj["players"];
     playernames[0] = array[0].asString();
     playernames[1] = array[1].asString();
     
+    std::string startFen;
     if (obj.isMember("startFen")) {
         startFen = obj["startFen"].asString();
     }
     
-    startMoves.clear();
+    std::vector<Move> startMoves;
     if (obj.isMember("startMoves")) {
         auto array = obj["startMoves"];
         for (int i = 0; i < int(array.size()); i++){
             auto k = array[i].asInt();
-            Move m(k & 0xff, k >> 8 & 0xff, static_cast<PieceType>(k >> 16 & 0xff));
+            Move m(k >> 8 & 0xff, k & 0xff, static_cast<PieceType>(k >> 16 & 0xff));
             startMoves.push_back(m);
         }
     }
+    openingIdx = openingTable.add(startFen, startMoves);
     
     auto s = obj["result"].asString();
     result.result = string2ResultType(s);
@@ -85,7 +91,7 @@ bool MatchRecord::load(const Json::Value& obj)
     return true;
 }
 
-Json::Value MatchRecord::saveToJson() const
+Json::Value MatchRecord::saveToJson(const OpeningTable& openingTable) const
 {
     Json::Value obj;
     
@@ -94,6 +100,10 @@ Json::Value MatchRecord::saveToJson() const
     players.append(playernames[1]);
     obj["players"] = players;
     
+    std::string startFen;
+    std::vector<Move> startMoves;
+    openingTable.get(openingIdx, startFen, startMoves);
+    
     if (!startFen.empty()) {
         obj["startFen"] = startFen;
     }
@@ -157,12 +167,31 @@ double TourPlayer::getScore() const
 }
 
 //////////////////////////////
+#ifdef _WIN32
+const std::string matchPath = "playing.json";
+const std::string journalPath = "playing.journal";
+#else
+const std::string matchPath = "./playing.json";
+const std::string journalPath = "./playing.journal";
+#endif
+
 TourMng::TourMng()
+    : matchRecordPath(matchPath), journalRecordPath(journalPath)
 {
 }
 
 TourMng::~TourMng()
 {
+    for(auto && game : gamePool) {
+        delete game;
+    }
+    gamePool.clear();
+}
+
+void TourMng::setBatch(TourBatch* _batch)
+{
+    batch = _batch;
+    playerMng = batch ? batch->getPlayerMng() : &ownPlayerMng;
 }
 
 static const char* tourTypeNames[] = {
@@ -176,13 +205,80 @@ bool TourMng::start(const std::string& mainJsonPath, bool yesReply, bool noReply
         return false;
     }
     
+    if (batch) {
+        // each tournament of a batch keeps its resume files next to its tour file
+        auto base = mainJsonPath;
+        if (base.size() > 5 && base.substr(base.size() - 5) == ".json") {
+            base = base.substr(0, base.size() - 5);
+        }
+        matchRecordPath = base + "-playing.json";
+        journalRecordPath = base + "-playing.journal";
+        budgetId = batch->getBudget().add(batchPriority);
+        
+        if (remoteMode != RemoteMode::off) {
+            std::cerr << "Warning: " << mainJsonPath << " is in a batch, its distributed mode is turned off" << std::endl;
+            remoteMode = RemoteMode::off;
+        }
+    }
+    
+    if (!workerAddress.empty()) {
+        remoteMode = RemoteMode::worker;
+        if (!TcpSocket::parseAddress(workerAddress, remoteHost, remotePort)) {
+            std::cerr << "Error: bad address of the coordinator " << workerAddress << ", it should be HOST:PORT" << std::endl;
+            return false;
+        }
+    }
+    
+    // only a coordinator may play no games itself
+    if (remoteMode != RemoteMode::coordinator) {
+        gameConcurrency = std::max(1, gameConcurrency);
+    }
+    
+    // a worker plays what it is given, the coordinator keeps the records
+    if (remoteMode == RemoteMode::worker) {
+        resumable = false;
+        inclusivePlayerMode = false;
+        sprt.mode = false;
+    }
+    
+    if (sprt.mode) {
+        if (participantList.size() == 2) {
+            sprtPlayer = participantList.front();
+        } else if (inclusivePlayerMode && inclusivePlayers.size() == 1) {
+            sprtPlayer = *inclusivePlayers.begin();
+        } else {
+            std::cerr << "Warning: SPRT is for a match of two players or a gauntlet of one inclusive player, it is turned off" << std::endl;
+            sprt.mode = false;
+        }
+        
+        if (sprt.mode && gameperpair < 2) {
+            std::cerr << "Warning: SPRT counts games by pairs, \"games per pair\" should be 2 or more, it is turned off" << std::endl;
+            sprt.mode = false;
+        }
+    }
+    
+    // match records may be saved before the tournament starts, their elapsed counts from here
+    startTime = time(nullptr);
+    logWriter.setFrameSize(static_cast<size_t>(logFrameSize) * 1024);
+    logWriter.start(logFlushInterval);
+    if (profileMode) {
+        profileSampler.start(profileInterval);
+    }
+    if (archiveMode && !archivePath.empty() && !archive.open(archivePath, archiveRichMode)) {
+        return false;
+    }
     showTournamentInfo();
     
-    if ((noReply || !loadMatchRecords(yesReply))
+    if (remoteMode != RemoteMode::worker
+        && (noReply || !loadMatchRecords(yesReply))
         && !createMatchList()) {
         return false;
     }
     
+    if (remoteMode != RemoteMode::off && !startRemote()) {
+        return false;
+    }
+    
     // The app will be terminated when all matches completed
     startTournament();
     return true;
@@ -238,7 +334,53 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         
         s = "concurrency";
         if (v.isMember(s)) {
-            gameConcurrency = std::max(1, v[s].asInt());
+            gameConcurrency = std::max(0, v[s].asInt());
+        }
+        
+        s = "lookahead";
+        if (v.isMember(s)) {
+            lookahead = std::max(0, v[s].asInt());
+        }
+        
+        s = "priority";
+        if (v.isMember(s)) {
+            batchPriority = v[s].asInt();
+        }
+    }
+    
+    if (d.isMember("adaptive concurrency")) {
+        if (!adaptiveConcurrency.load(d["adaptive concurrency"]) && adaptiveConcurrency.mode) {
+            std::cerr << "Error: \"adaptive concurrency\" needs 1 <= min <= max, load and interval over zero" << std::endl;
+            return false;
+        }
+        // a coordinator of concurrency 0 plays no games, there is nothing to adapt
+        if (adaptiveConcurrency.mode && gameConcurrency == 0) {
+            std::cerr << "Warning: \"adaptive concurrency\" is turned off since concurrency is 0" << std::endl;
+            adaptiveConcurrency.mode = false;
+        }
+        if (adaptiveConcurrency.mode) {
+            adaptiveConcurrency.start(gameConcurrency);
+            gameConcurrency = adaptiveConcurrency.maxCnt;
+        }
+    }
+    
+    if (d.isMember("sprt") && !sprt.load(d["sprt"]) && sprt.mode) {
+        std::cerr << "Error: SPRT needs elo0 < elo1, alpha and beta between 0 and 0.5" << std::endl;
+        return false;
+    }
+    
+    if (d.isMember("distributed")) {
+        auto v = d["distributed"];
+        auto s = v["mode"].asString();
+        remoteMode = s == "coordinator" ? RemoteMode::coordinator : s == "worker" ? RemoteMode::worker : RemoteMode::off;
+        if (v.isMember("host")) {
+            remoteHost = v["host"].asString();
+        }
+        if (v.isMember("port")) {
+            remotePort = v["port"].asInt();
+        }
+        if (v.isMember("lease")) {
+            leaseTime = std::max(10, v["lease"].asInt());
         }
     }
     
@@ -250,15 +392,26 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         auto v = d[s];
         enginConfigUpdate = v["update"].isBool() && v["update"].asBool();
         enginConfigJsonPath = v["path"].asString();
+        
+        // engines of a batch are in one pool
+        auto maxReuse = v.isMember("max reuse") ? v["max reuse"].asInt() : 0;
+        if (!batch || batch->takeSharedSetting("max reuse", maxReuse, getJsonPath())) {
+            playerMng->setMaxReuse(maxReuse);
+        }
+        auto cpuPinning = v.isMember("cpu pinning") && v["cpu pinning"].asBool();
+        if (!batch || batch->takeSharedSetting("cpu pinning", cpuPinning, getJsonPath())) {
+            playerMng->setCpuPinning(cpuPinning);
+        }
     }
     
-    if (enginConfigJsonPath.empty() || !ConfigMng::instance->loadFromJsonFile(enginConfigJsonPath) || ConfigMng::instance->empty()) {
+    if (enginConfigJsonPath.empty() || !ConfigMng::instance->loadFile(enginConfigJsonPath) || ConfigMng::instance->empty()) {
         std::cerr << "Error: missing parametter \"" << s << "\" or the file is not existed" << std::endl;
         return false;
     }
     
     s = "override options";
-    if (d.isMember(s)) {
+    auto overrideOwner = d.isMember(s) && (!batch || batch->takeSharedSetting(s, d[s], getJsonPath()));
+    if (overrideOwner) {
         ConfigMng::instance->loadOverrideOptions(d[s]);
     }
     
@@ -322,7 +475,7 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
     
     if (participantList.empty()) {
         std::cerr << "Warning: missing parametter \"players\". Will use all players in configure instead." << std::endl;
-        participantList = ConfigMng::instance->nameList();
+        participantList = ConfigMng::instance->nameList(enginConfigJsonPath);
     }
     
     if (participantList.size() < 2) {
@@ -347,7 +500,11 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
     s = "endgames";
     if (d.isMember(s)) {
         auto obj = d[s];
-        configMng.setSyzygyPath(obj["syzygypath"].asString());
+        auto path = obj["syzygypath"].asString();
+        if (!batch || batch->takeSharedSetting("syzygypath", path, getJsonPath())) {
+            configMng.setSyzygyPath(path);
+        }
+        syzygyWarmup = obj.isMember("syzygy warmup") && obj["syzygy warmup"].asBool();
     }
     
     s = "game adjudication";
@@ -357,11 +514,24 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         gameConfig.adjudicationEgtbMode = obj.isMember("tablebase") && obj["tablebase"].asBool();
         gameConfig.adjudicationMaxGameLength = obj.isMember("draw if game length over") ? obj["draw if game length over"].asInt() : 0;
         gameConfig.adjudicationMaxPieces = obj.isMember("tablebase max pieces") ? obj["tablebase max pieces"].asInt() : 10;
+        
+        if (obj.isMember("resign if score over")) gameConfig.adjudicationResignScore = std::max(1, obj["resign if score over"].asInt());
+        gameConfig.adjudicationResignMoves = obj.isMember("resign score moves") ? std::max(0, obj["resign score moves"].asInt()) : 0;
+        if (obj.isMember("draw if score within")) gameConfig.adjudicationDrawScore = std::max(0, obj["draw if score within"].asInt());
+        gameConfig.adjudicationDrawMoves = obj.isMember("draw score moves") ? std::max(0, obj["draw score moves"].asInt()) : 0;
+        if (obj.isMember("draw score from ply")) gameConfig.adjudicationDrawStartPly = std::max(0, obj["draw score from ply"].asInt());
     }
     
     s = "logs";
     if (d.isMember(s)) {
         auto a = d[s];
+        if (a.isMember("flush interval")) {
+            logFlushInterval = a["flush interval"].asInt();
+        }
+        if (a.isMember("frame size")) {
+            logFrameSize = std::max(1, a["frame size"].asInt());
+        }
+        
         s = "pgn";
         if (a.isMember(s)) {
             auto v = a[s];
@@ -370,6 +540,29 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
             logPgnAllInOneMode = !v.isMember("one file") || v["one file"].asBool();
             logPgnGameTitleSurfix = v.isMember("game title surfix") && v["game title surfix"].asBool();
             logPgnRichMode = v.isMember("rich info") && v["rich info"].asBool();
+            logPgnCompressMode = v.isMember("compress") && v["compress"].asBool();
+            if (logPgnCompressMode && !GzipFile::isSupported()) {
+                std::cerr << "Warning: this build has no zlib, PGN compression is turned off" << std::endl;
+                logPgnCompressMode = false;
+            }
+        }
+        
+        s = "archive";
+        if (a.isMember(s)) {
+            auto v = a[s];
+            archiveMode = v["mode"].asBool();
+            archivePath = v["path"].asString();
+            archiveRichMode = !v.isMember("rich info") || v["rich info"].asBool();
+        }
+        
+        s = "metrics";
+        if (a.isMember(s)) {
+            auto v = a[s];
+            metricsMode = v["mode"].asBool();
+            metricsPath = v["path"].asString();
+            if (v.isMember("interval")) {
+                metricsInterval = std::max(1, v["interval"].asInt());
+            }
         }
         
         s = "engine";
@@ -382,6 +575,11 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
             logEngineGameTitleSurfix = v.isMember("game title surfix") && v["game title surfix"].asBool();
             logEngineShowTime = v.isMember("show time") && v["show time"].asBool();
             logEnginePath = v["path"].asString();
+            logEngineCompressMode = v.isMember("compress") && v["compress"].asBool();
+            if (logEngineCompressMode && !GzipFile::isSupported()) {
+                std::cerr << "Warning: this build has no zlib, engine log compression is turned off" << std::endl;
+                logEngineCompressMode = false;
+            }
         }
         
         s = "result";
@@ -397,7 +595,19 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
     if (gameConfig.adjudicationMode) {
         auto path = configMng.getSyzygyPath();
         if (!path.empty()) {
-            Tablebase::SyzygyTablebase::tb_init(path);
+            // tournaments of a batch share the tablebases and their prober
+            auto& initPath = batch ? batch->getTbInitPath() : tbInitPath;
+            if (path != initPath) {
+                initPath = path;
+                Tablebase::SyzygyTablebase::tb_init(path);
+            }
+            if (Tablebase::SyzygyTablebase::TB_LARGEST && !SyzygyProber::instance) {
+                (batch ? batch->getSyzygyProber() : syzygyProber).start(2);
+                
+                if (syzygyWarmup && gameConfig.adjudicationEgtbMode) {
+                    SyzygyProber::warmup(path, std::min(gameConfig.adjudicationMaxPieces, Tablebase::SyzygyTablebase::TB_LARGEST));
+                }
+            }
         }
     }
     
@@ -410,19 +620,52 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
     
     // Check cores and memory
     {
-        // engine concurrency
-        auto n = gameConcurrency * 2;
+        // engine concurrency, prepared games have their engines running too. Games of a
+        // batch share its budget, its limit is known here when it is given
+        auto concurrency = batch && batch->getBudget().getLimit() > 1 ? std::max(gameConcurrency, batch->getBudget().getLimit()) : gameConcurrency;
+        auto n = (concurrency + lookahead) * 2;
         
         auto threads = n * std::max(1, configMng.getEngineThreads());
-        auto memory = n * configMng.getEngineMemory();
         auto cores = getNumberOfCores();
-        if (threads >= cores) {
+        // node limited games don't depend on the load, hosts can be oversubscribed
+        if (threads >= cores && timeController.mode != TimeControlMode::nodes) {
             std::cout << "Warning: concurrent engines (" << n << ") may use from " << threads << " threads, more than the number of computer cores (" << cores << ")" << std::endl;
         }
-        auto sysMem = getMemorySize() / (1024 * 1024);
-        if (memory >= sysMem * 3 / 4) {
-            std::cout << "Warning: concurrent engines (" << n << ") may use from " << memory << " MB memory" << std::endl;
+        
+        // a batch plans once all its tournaments are loaded, for its whole concurrency
+        if (!batch && !planEngineMemory(n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tablebases are counted once since their page caches are shared, they are evictable
+// though, only hashes alone over the host memory refuse to start
+bool TourMng::planEngineMemory(int engineCnt)
+{
+    auto host = MemoryPlanner::hostMemory();
+    auto tablebases = MemoryPlanner::syzygySize(configMng.getSyzygyPath());
+    auto available = host - configMng.getMemoryReserve() - tablebases - i64(engineCnt) * MemoryPlanner::engine_base_memory;
+    
+    if (configMng.isMemoryPlanMode()) {
+        auto hash = MemoryPlanner::plan(available, engineCnt, configMng.getEngineMemory());
+        if (hash <= 0) {
+            std::cerr << "Error: not enough memory for " << engineCnt << " concurrent engines, host: " << host << " MB, reserve: " << configMng.getMemoryReserve() << " MB, tablebases: " << tablebases << " MB" << std::endl;
+            return false;
         }
+        configMng.setEngineMemory(hash);
+        std::cout << "Memory plan: " << engineCnt << " concurrent engines, hash " << hash << " MB each, host: " << host << " MB, tablebases: " << tablebases << " MB" << std::endl;
+        return true;
+    }
+    
+    auto memory = i64(engineCnt) * configMng.getEngineMemory();
+    if (memory > host) {
+        std::cerr << "Error: concurrent engines (" << engineCnt << ") may use " << memory << " MB hash, more than the host memory (" << host << " MB), reduce memory or concurrency, or turn memory plan on" << std::endl;
+        return false;
+    }
+    if (memory > available) {
+        std::cout << "Warning: concurrent engines (" << engineCnt << ") may use from " << memory << " MB hash, the host may swap (" << host << " MB, tablebases " << tablebases << " MB)" << std::endl;
     }
     return true;
 }
@@ -430,12 +673,74 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
 
 void TourMng::tickWork()
 {
-    playerMng.tick();
+    std::lock_guard<std::mutex> dolock(scheduleMutex);
     
-    std::vector<Game*> stoppedGameList;
+    // the batch ticks its shared engines
+    if (!batch) {
+        playerMng->tick();
+    }
     
     for(auto && game : gameList) {
         game->tick();
+    }
+    // their engines may crash while waiting
+    for(auto && game : preparedList) {
+        game->tick();
+    }
+    
+    if (adaptiveConcurrency.update(int(gameList.size()))) {
+        matchLog("* Adaptive " + adaptiveConcurrency.toString(), banksiaVerbose);
+    }
+    
+    if (remoteMode == RemoteMode::coordinator) {
+        checkLeases();
+    } else if (remoteMode == RemoteMode::worker) {
+        // ticks are 0.5s
+        if (remoteWaitTick > 0) {
+            remoteWaitTick--;
+        }
+        if (++remoteAliveTick >= 20) {
+            remoteAliveTick = 0;
+            Json::Value obj;
+            obj["cmd"] = "alive";
+            worker.send(obj);
+        }
+    }
+    
+    updateGames();
+}
+
+int TourMng::processEvents()
+{
+    std::lock_guard<std::mutex> dolock(scheduleMutex);
+    
+    for(auto && game : gameList) {
+        game->update();
+    }
+    for(auto && game : preparedList) {
+        game->update();
+    }
+    
+    updateGames();
+    
+    // wake up again when the nearest clock could run out
+    auto waitTime = -1.0;
+    for(auto && game : gameList) {
+        auto t = game->timeBeforeTimeOver();
+        if (t >= 0 && (waitTime < 0 || t < waitTime)) {
+            waitTime = t;
+        }
+    }
+    return waitTime < 0 ? std::numeric_limits<int>::max() : static_cast<int>(waitTime * 1000) + 1;
+}
+
+void TourMng::updateGames()
+{
+    handleRemoteMessages();
+    
+    std::vector<Game*> stoppedGameList;
+    
+    for(auto && game : gameList) {
         auto st = game->getState();
         switch (st) {
             case GameState::stopped:
@@ -444,18 +749,10 @@ void TourMng::tickWork()
                 break;
                 
             case GameState::ended:
-            {
-                for(int sd = 0; sd < 2; sd++) {
-                    auto side = static_cast<Side>(sd);
-                    auto player = game->getPlayer(side);
-                    if (player) {
-                        player->quit();
-                    }
-                }
-                
+                // players quit or stay for next games when returned
                 stoppedGameList.push_back(game);
                 break;
-            }
+
             default:
                 break;
         }
@@ -467,7 +764,7 @@ void TourMng::tickWork()
             auto player = game->getPlayer(side);
             if (player) {
                 auto player2 = game->deattachPlayer(side); assert(player == player2);
-                playerMng.returnPlayer(player2);
+                playerMng->returnPlayer(player2);
             }
         }
         
@@ -477,12 +774,25 @@ void TourMng::tickWork()
         } else {
             gameList.erase(it);
         }
-        delete game;
+        recycleGame(game);
     }
     
     if (state == TourState::playing) {
+        replaceCrashedPreparedGames();
         playMatches();
     }
+    
+    if (batch) {
+        auto waiting = state == TourState::playing && int(gameList.size()) < getConcurrency()
+                        && (!preparedList.empty() || !pendingQueue.empty());
+        batch->getBudget().update(budgetId, int(gameList.size()), waiting);
+    }
+}
+
+// a batch shares game slots among its tournaments
+bool TourMng::acquireGameSlot()
+{
+    return !batch || batch->getBudget().acquire(budgetId);
 }
 
 static std::string bool2OnOffString(bool b)
@@ -543,13 +853,26 @@ void TourMng::showTournamentInfo()
     }
     info +=
     + ", matches: " + std::to_string(calcMatchNumber())
-    + ", concurrency: " + std::to_string(gameConcurrency)
+    + ", concurrency: " + std::to_string(getConcurrency())
+    + (adaptiveConcurrency.mode ? " (adaptive " + std::to_string(adaptiveConcurrency.minCnt) + ".." + std::to_string(adaptiveConcurrency.maxCnt) + ")" : "")
+    + (lookahead > 0 ? ", lookahead: " + std::to_string(lookahead) : "")
     + ", ponder: " + bool2OnOffString(gameConfig.ponderMode)
     + ", book: " + bool2OnOffString(!bookMng.isEmpty());
     
+    if (sprt.mode) {
+        std::ostringstream stringStream;
+        stringStream.precision(2);
+        stringStream << std::fixed << "\nSPRT: " << sprtPlayer << ", elo0: " << sprt.elo0 << ", elo1: " << sprt.elo1
+        << ", alpha: " << sprt.alpha << ", beta: " << sprt.beta
+        << ", LLR bounds: (" << sprt.lowerBound() << ", " << sprt.upperBound() << ")";
+        info += stringStream.str();
+    }
+    
     matchLog(info, true);
     
     showPathInfo("pgn", pgnPath, pgnPathMode);
+    showPathInfo("archive", archivePath, archiveMode);
+    showPathInfo("metrics", metricsPath, metricsMode);
     showPathInfo("result", logResultPath, logResultMode);
     showPathInfo("engines", logEnginePath, logEngineMode);
     std::cout << std::endl;
@@ -559,10 +882,23 @@ void TourMng::startTournament()
 {
     startTime = time(nullptr);
     
-    // tickWork will start the matches
+    // events and tickWork will start the matches
     state = TourState::playing;
     
-    mainTimerId = timer.add(std::chrono::milliseconds(500), [=](CppTime::timer_id) { tick(); }, std::chrono::milliseconds(500));
+    // the timer is kept for pings, idle checks and other slow counters, a batch ticks all its tournaments
+    if (!batch) {
+        mainTimerId = timer.add(std::chrono::milliseconds(500), [=](CppTime::timer_id) { tick(); }, std::chrono::milliseconds(500));
+    }
+    
+    if (metricsMode && !metricsPath.empty() && !metricsTimerOn) {
+        metricsTimerOn = true;
+        auto period = std::chrono::seconds(metricsInterval);
+        metricsTimerId = timer.add(period, [=](CppTime::timer_id) { saveMetrics(); }, period);
+    }
+    if (!batch) {
+        scheduler.start([=]() { return processEvents(); });
+    }
+    EventScheduler::post();
 }
 
 void TourMng::finishTournament()
@@ -580,35 +916,64 @@ void TourMng::finishTournament()
     
     removeMatchRecordFile();
     
-    // WARNING: exit the app here after completed the tournament
     shutdown();
+    if (finishedCallback) {
+        finishedCallback();
+    }
+    if (batch) {
+        batch->tourFinished(this);
+        return;
+    }
+    
+    // WARNING: exit the app here after completed the tournament
     exit(0);
 }
 
 void TourMng::playMatches()
 {
+    if (remoteMode == RemoteMode::worker) {
+        while (int(gameList.size()) < getConcurrency() && (!preparedList.empty() || !pendingQueue.empty()) && acquireGameSlot()) {
+            if (!startPreparedGame()) {
+                createQueuedMatch(false);
+            }
+        }
+        while (int(preparedList.size()) < lookahead && !pendingQueue.empty()) {
+            createQueuedMatch(true);
+        }
+        
+        requestRemoteMatches();
+        
+        if (remoteClosed && gameList.empty() && preparedList.empty() && pendingQueue.empty()) {
+            finishTournament();
+        }
+        return;
+    }
+    
     if (matchRecordList.empty()) {
         return finishTournament();
     }
     
-    if (gameList.size() >= gameConcurrency) {
-        return;
+    // SPRT decided, matches not started yet are dropped
+    auto sprtDone = sprt.getState() != SprtState::running;
+    if (sprtDone) {
+        pendingQueue.clear();
+        dropPreparedGames();
     }
     
-    for(auto && m : matchRecordList) {
-        if (m.state != MatchState::none) {
-            continue;
-        }
-        
-        createMatch(m);
-        assert(m.state != MatchState::none);
-        
-        if (gameList.size() >= gameConcurrency) {
-            break;
+    auto concurrency = getConcurrency();
+    while (int(gameList.size()) < concurrency && (!preparedList.empty() || !pendingQueue.empty()) && acquireGameSlot()) {
+        if (!startPreparedGame()) {
+            createQueuedMatch(false);
         }
     }
     
-    if (gameList.empty() && !createNextRoundMatches()) {
+    // a coordinator of concurrency 0 plays nothing and prepares nothing
+    while (concurrency > 0 && int(preparedList.size()) < lookahead && !pendingQueue.empty()) {
+        createQueuedMatch(true);
+    }
+    
+    // remote games count as playing ones
+    if (gameList.empty() && preparedList.empty() && leaseMap.empty() && pendingQueue.empty() && (sprtDone || !createNextRoundMatches())) {
         return finishTournament();
     }
 }
@@ -637,8 +1002,183 @@ void TourMng::addMatchRecord_simple(MatchRecord& record)
         }
     }
     record.gameIdx = int(matchRecordList.size());
-    bookMng.getRandomBook(record.pairId, record.startFen, record.startMoves);
     matchRecordList.push_back(record);
+    indexMatchRecord(matchRecordList.back());
+}
+
+void TourMng::indexMatchRecord(const MatchRecord& record)
+{
+    if (record.state == MatchState::none) {
+        pendingQueue.push_back(record.gameIdx);
+    }
+    pairIndex[record.pairId].push_back(record.gameIdx);
+    lastRound = std::max(lastRound, record.round);
+    addToStandings(record);
+}
+
+void TourMng::rebuildMatchIndexes()
+{
+    pendingQueue.clear();
+    pairIndex.clear();
+    standingMap.clear();
+    ratingSolver.clear();
+    sprt.clear();
+    lastRound = 0;
+    
+    for(auto && r : matchRecordList) {
+        indexMatchRecord(r);
+    }
+}
+
+// Counts a result for both players, each record has to be counted once, when it gets its result
+void TourMng::addToStandings(const MatchRecord& m)
+{
+    if (m.result.result == ResultType::noresult) { // hm ?
+        return;
+    }
+    
+    for(int sd = 0; sd < 2; sd++) {
+        auto& name = m.playernames[sd];
+        if (name.empty()) { // bye players (in knockout) won without opponents
+            continue;
+        }
+        
+        auto& r = standingMap[name];
+        r.name = name;
+        
+        if (m.playernames[1 - sd].empty()) { // bye player
+            r.byeCnt++;
+        }
+        
+        auto lossCnt = r.lossCnt;
+        r.gameCnt++;
+        switch (m.result.result) {
+            case ResultType::win:
+                if (sd == W) r.winCnt++; else r.lossCnt++;
+                break;
+            case ResultType::draw:
+                r.drawCnt++;
+                break;
+            case ResultType::loss:
+                if (sd == B) r.winCnt++; else r.lossCnt++;
+                break;
+            default:
+                assert(false);
+                break;
+        }
+        
+        if (lossCnt < r.lossCnt) {
+            if (m.result.reason == ReasonType::illegalmove || m.result.reason == ReasonType::crash || m.result.reason == ReasonType::timeout) {
+                r.abnormalCnt++;
+            }
+        }
+    }
+    
+    auto score = m.result.result == ResultType::win ? 1.0 : m.result.result == ResultType::draw ? 0.5 : 0.0;
+    ratingSolver.addResult(m.playernames[W], m.playernames[B], score);
+    
+    updateSprt(m);
+}
+
+// Matches of a pair are taken two by two, the SPRT gets a sample when both of them are completed
+void TourMng::updateSprt(const MatchRecord& m)
+{
+    if (!sprt.mode) {
+        return;
+    }
+    
+    auto it = pairIndex.find(m.pairId);
+    if (it == pairIndex.end()) {
+        return;
+    }
+    auto& list = it->second;
+    auto k = std::find(list.begin(), list.end(), m.gameIdx) - list.begin();
+    k &= ~1;
+    if (k + 1 >= int(list.size())) {
+        return;
+    }
+    
+    auto score = 0.0;
+    for(auto i = k; i <= k + 1; i++) {
+        auto& r = matchRecordList[list[i]];
+        if (r.state != MatchState::completed || r.result.result == ResultType::noresult) {
+            return;
+        }
+        auto sd = r.playernames[W] == sprtPlayer ? W : B;
+        if (r.playernames[sd] != sprtPlayer) {
+            return;
+        }
+        if (r.result.result == ResultType::draw) {
+            score += 0.5;
+        } else if ((r.result.result == ResultType::win) == (sd == W)) {
+            score += 1.0;
+        }
+    }
+    
+    auto running = sprt.getState() == SprtState::running;
+    sprt.addPair(score);
+    
+    if (running && sprt.getState() != SprtState::running) {
+        auto str = "* " + sprt.toString() + ", stopped after " + std::to_string(sprt.getPairCnt() * 2) + " games";
+        matchLog(str, true);
+    }
+}
+
+// Openings of new matches are drawn together, once all the matches of a round are known.
+// With samepair, matches of a pair share one opening, including ones added to break ties
+void TourMng::assignOpenings()
+{
+    auto samePair = bookMng.getBookSelectType() == BookSelectType::samepair;
+    
+    // only waiting matches may lack openings
+    std::unordered_map<int, int> pairSlotMap;
+    std::vector<MatchRecord*> pendingList;
+    std::vector<int> slotList;
+    auto slotCnt = 0;
+    for(auto && gIdx : pendingQueue) {
+        auto& r = matchRecordList[gIdx];
+        if (r.openingIdx >= 0) {
+            continue;
+        }
+        if (samePair) {
+            auto found = false;
+            for(auto && k : pairIndex[r.pairId]) {
+                if (matchRecordList[k].openingIdx >= 0) {
+                    r.openingIdx = matchRecordList[k].openingIdx;
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                continue;
+            }
+            auto p = pairSlotMap.emplace(r.pairId, slotCnt);
+            if (p.second) {
+                slotCnt++;
+            }
+            slotList.push_back(p.first->second);
+        } else {
+            slotList.push_back(slotCnt++);
+        }
+        pendingList.push_back(&r);
+    }
+    
+    if (pendingList.empty()) {
+        return;
+    }
+    
+    auto rejectedCnt = bookMng.getRejectedCnt();
+    auto idxList = bookMng.sampleOpenings(size_t(slotCnt));
+    for(size_t i = 0; i < pendingList.size(); i++) {
+        pendingList[i]->openingIdx = idxList[size_t(slotList[i])];
+    }
+    
+    if (!bookMng.isEmpty()) {
+        auto str = "* Openings drawn: " + std::to_string(slotCnt)
+        + ", duplicates rejected: " + std::to_string(bookMng.getRejectedCnt() - rejectedCnt)
+        + ", distinct openings: " + std::to_string(bookMng.getOpeningTable().size());
+        matchLog(str, banksiaVerbose);
+    }
 }
 
 bool TourMng::createNextRoundMatches()
@@ -663,63 +1203,57 @@ bool TourMng::createNextRoundMatches()
 // It is not a tie if one has more win or more white games
 void TourMng::checkToExtendMatches(int gIdx)
 {
-    if (type != TourType::knockout || gIdx < 0) {
+    if (type != TourType::knockout || gIdx < 0 || gIdx >= int(matchRecordList.size())) {
         return;
     }
     
-    for(auto && r : matchRecordList) {
-        if (r.gameIdx == gIdx) {
-            TourPlayerPair playerPair;
-            playerPair.pair[0].name = r.playernames[0];
-            playerPair.pair[1].name = r.playernames[1];
-            auto pairId = r.pairId;
-            
-            for(auto && rcd : matchRecordList) {
-                if (rcd.pairId != pairId) {
-                    continue;
-                }
-                
-                // some matches are not completed -> no extend
-                if (rcd.state != MatchState::completed) {
-                    return;
-                }
-                if (rcd.result.result != ResultType::win && rcd.result.result  != ResultType::loss) {
-                    continue;
-                }
-                auto winnerName = rcd.playernames[(rcd.result.result  == ResultType::win ? W : B)];
-                playerPair.pair[playerPair.pair[W].name == winnerName ? W : B].winCnt++;
-                
-                auto whiteIdx = playerPair.pair[W].name == rcd.playernames[W] ? W : B;
-                playerPair.pair[whiteIdx].whiteCnt++;
-            }
-            
-            // It is a tie if two players have same wins and same times to play white
-            if (playerPair.pair[0].winCnt == playerPair.pair[1].winCnt && playerPair.pair[0].whiteCnt == playerPair.pair[1].whiteCnt) {
-                MatchRecord record = r;
-                record.result.result  = ResultType::noresult;
-                record.state = MatchState::none;
-                addMatchRecord_simple(record);
-                
-                auto str = "* Tied! Add one more game for " + record.playernames[W] + " vs " + record.playernames[B];
-                matchLog(str, banksiaVerbose);
-            }
-            break;
+    auto& r = matchRecordList[gIdx];
+    assert(r.gameIdx == gIdx);
+    TourPlayerPair playerPair;
+    playerPair.pair[0].name = r.playernames[0];
+    playerPair.pair[1].name = r.playernames[1];
+    
+    for(auto && k : pairIndex[r.pairId]) {
+        auto& rcd = matchRecordList[k];
+        
+        // some matches are not completed -> no extend
+        if (rcd.state != MatchState::completed) {
+            return;
+        }
+        if (rcd.result.result != ResultType::win && rcd.result.result  != ResultType::loss) {
+            continue;
         }
+        auto winnerName = rcd.playernames[(rcd.result.result  == ResultType::win ? W : B)];
+        playerPair.pair[playerPair.pair[W].name == winnerName ? W : B].winCnt++;
+        
+        auto whiteIdx = playerPair.pair[W].name == rcd.playernames[W] ? W : B;
+        playerPair.pair[whiteIdx].whiteCnt++;
+    }
+    
+    // It is a tie if two players have same wins and same times to play white
+    if (playerPair.pair[0].winCnt == playerPair.pair[1].winCnt && playerPair.pair[0].whiteCnt == playerPair.pair[1].whiteCnt) {
+        MatchRecord record = r;
+        record.result.result  = ResultType::noresult;
+        record.state = MatchState::none;
+        record.openingIdx = -1;
+        addMatchRecord_simple(record);
+        assignOpenings();
+        
+        auto str = "* Tied! Add one more game for " + record.playernames[W] + " vs " + record.playernames[B];
+        matchLog(str, banksiaVerbose);
     }
 }
 
 int TourMng::getLastRound() const
 {
-    int lastRound = 0;
-    for(auto && r : matchRecordList) {
-        lastRound = std::max(lastRound, r.round);
-    }
     return lastRound;
 }
 
 void TourMng::reset()
 {
     matchRecordList.clear();
+    rebuildMatchIndexes();
+    bookMng.clearOpenings();
     previousElapsed = 0;
 }
 
@@ -789,14 +1323,19 @@ bool TourMng::createMatchList(std::vector<std::string> nameList, TourType tourTy
         return false;
     }
     
+    assignOpenings();
     saveMatchRecords();
     return true;
 }
 
-void TourMng::createMatch(MatchRecord& record)
+void TourMng::createMatch(MatchRecord& record, bool standby)
 {
+    std::string startFen;
+    std::vector<Move> startMoves;
+    bookMng.getOpeningTable().get(record.openingIdx, startFen, startMoves);
+    
     if (!record.isValid() ||
-        !createMatch(record.gameIdx, record.playernames[W], record.playernames[B], record.startFen, record.startMoves)) {
+        !createMatch(record.gameIdx, record.playernames[W], record.playernames[B], startFen, startMoves, standby)) {
         std::cerr << "Error: match record invalid or missing players " << record.toString() << std::endl;
         record.state = MatchState::error;
         return;
@@ -806,45 +1345,166 @@ void TourMng::createMatch(MatchRecord& record)
 }
 
 bool TourMng::createMatch(int gameIdx, const std::string& whiteName, const std::string& blackName,
-                          const std::string& startFen, const std::vector<Move>& startMoves)
+                          const std::string& startFen, const std::vector<Move>& startMoves, bool standby)
 {
     Engine* engines[2];
-    engines[W] = playerMng.createEngine(whiteName);
-    engines[B] = playerMng.createEngine(blackName);
+    engines[W] = playerMng->createEngine(whiteName);
+    engines[B] = playerMng->createEngine(blackName);
     
     if (engines[0] && engines[1]) {
-        auto game = new Game(engines[W], engines[B], timeController, gameConfig);
+        auto game = createGame(engines[W], engines[B]);
         game->setStartup(gameIdx, startFen, startMoves);
         
+        // paths are fixed for the whole game, no need to build them per line
+        std::string logPaths[2];
+        if (logEngineMode && !logEnginePath.empty()) {
+            logPaths[B] = engineLogPath(game, Side::black);
+            logPaths[W] = engineLogPath(game, Side::white);
+        }
+        game->setMessageLogger([=](const std::string& name, const std::string& line, LogType logType) {
+            auto white = game->getPlayer(Side::white);
+            auto fromSide = white && white->getName() == name ? Side::white : Side::black;
+            engineLog(game, name, line, logType, fromSide, &logPaths[static_cast<int>(fromSide)]);
+        });
+        game->setStandby(standby);
+        game->kickStart();
+        
+        if (standby) {
+            preparedList.push_back(game);
+            return true;
+        }
+        
         if (addGame(game)) {
-            game->setMessageLogger([=](const std::string& name, const std::string& line, LogType logType) {
-                auto white = game->getPlayer(Side::white);
-                auto fromSide = white && white->getName() == name ? Side::white : Side::black;
-                engineLog(game, name, line, logType, fromSide);
-            });
-            game->kickStart();
-            
-            std::string infoString = std::to_string(gameIdx + 1) + ". " + game->getGameTitleString();
-            
-            if (banksiaVerbose) {
-                printText(infoString);
-            }
-            
-            if (!logEngineBySides) {
-                engineLog(game, getAppName(), "\n" + infoString + "\n", LogType::system);
-            }
-            
+            announceGame(game);
             return true;
         }
         delete game;
     }
     
     for(int sd = 0; sd < 2; sd++) {
-        playerMng.returnPlayer(engines[sd]);
+        playerMng->returnPlayer(engines[sd]);
     }
     return false;
 }
 
+Game* TourMng::createGame(Player* white, Player* black)
+{
+    if (gamePool.empty()) {
+        return new Game(white, black, timeController, gameConfig);
+    }
+    
+    auto game = gamePool.back();
+    gamePool.pop_back();
+    game->reset(gameConfig);
+    game->set(white, black, timeController);
+    return game;
+}
+
+// at most the games of the concurrency and the lookahead are alive, the pool is not larger
+void TourMng::recycleGame(Game* game)
+{
+    gamePool.push_back(game);
+}
+
+void TourMng::announceGame(Game* game)
+{
+    Metrics::count(MetricCount::gamesStarted);
+    
+    std::string infoString = std::to_string(game->getIdx() + 1) + ". " + game->getGameTitleString();
+    
+    if (banksiaVerbose) {
+        printText(infoString);
+    }
+    
+    if (!logEngineBySides) {
+        engineLog(game, getAppName(), "\n" + infoString + "\n", LogType::system);
+    }
+}
+
+void TourMng::createQueuedMatch(bool standby)
+{
+    assert(!pendingQueue.empty());
+    auto& m = matchRecordList[pendingQueue.front()];
+    pendingQueue.pop_front();
+    assert(m.state == MatchState::none);
+    
+    createMatch(m, standby);
+    assert(m.state != MatchState::none);
+    
+    // missing engines, the coordinator gives the match to others
+    if (remoteMode == RemoteMode::worker && m.state == MatchState::error) {
+        auto it = remoteMatchMap.find(m.gameIdx);
+        if (it != remoteMatchMap.end()) {
+            Json::Value obj;
+            obj["cmd"] = "failed";
+            obj["lease id"] = it->second.leaseId;
+            obj["game idx"] = it->second.gameIdx;
+            worker.send(obj);
+            remoteMatchMap.erase(it);
+        }
+        remoteClosed = true;
+    }
+}
+
+// The oldest prepared game takes the free slot, its engines may be ready already
+bool TourMng::startPreparedGame()
+{
+    if (preparedList.empty()) {
+        return false;
+    }
+    
+    auto game = preparedList.front();
+    preparedList.pop_front();
+    game->setStandby(false);
+    addGame(game);
+    announceGame(game);
+    game->update();
+    return true;
+}
+
+void TourMng::dropPreparedGames()
+{
+    for(auto && game : preparedList) {
+        dropPreparedGame(game, false);
+    }
+    preparedList.clear();
+}
+
+void TourMng::dropPreparedGame(Game* game, bool requeue)
+{
+    auto gIdx = game->getIdx();
+    if (gIdx >= 0 && gIdx < int(matchRecordList.size())) {
+        matchRecordList[gIdx].state = MatchState::none;
+        if (requeue) {
+            pendingQueue.push_front(gIdx);
+        }
+    }
+    for(int sd = 0; sd < 2; sd++) {
+        auto player = game->deattachPlayer(static_cast<Side>(sd));
+        if (player) {
+            playerMng->returnPlayer(player);
+        }
+    }
+    recycleGame(game);
+}
+
+// A prepared game stops only when an engine crashed before the game started, the match is
+// prepared again with new engines. A second crash is played out thus a broken engine loses
+void TourMng::replaceCrashedPreparedGames()
+{
+    for(auto it = preparedList.begin(); it != preparedList.end(); ) {
+        auto game = *it;
+        if (game->getState() != GameState::stopped || !replacedPreparedSet.insert(game->getIdx()).second) {
+            ++it;
+            continue;
+        }
+        
+        matchLog("* Prepared game " + std::to_string(game->getIdx() + 1) + " lost an engine, it is prepared again", banksiaVerbose);
+        it = preparedList.erase(it);
+        dropPreparedGame(game, true);
+    }
+}
+
 std::vector<TourPlayer> TourMng::getKnockoutWinnerList()
 {
     std::vector<TourPlayer> winList;
@@ -921,51 +1581,6 @@ bool TourMng::pairingMatchList(const std::vector<std::string>& nameList)
     return pairingMatchList(vec, 0);
 }
 
-bool TourMng::pairingMatchListRecusive(std::vector<TourPlayer>& playerVec, int round, const std::set<std::string>& pairedSet)
-{
-    auto n = playerVec.size(); assert((n & 1) == 0); // must be even
-    
-    auto r = true;
-    for(int i = 0; i < n; ++i) {
-        auto& player0 = playerVec.at(i);
-        if (player0.flag & 1) continue;
-        r = false;
-        auto name0 = player0.name;
-        player0.flag |= 1;
-        
-        for(int j = i + 1; j < n; ++j) {
-            auto& player1 = playerVec.at(j);
-            if (player1.flag & 1) continue;
-            auto name1 = player1.name;
-            
-            if (pairedSet.find(name0 + "*" + name1) != pairedSet.end()) {
-                continue;
-            }
-            
-            player1.flag |= 1;
-            
-            if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
-                player1.flag &= ~1;
-                continue;
-            }
-            
-            // random swap to avoid name0 player plays all white side
-            auto swap = rand() & 1;
-            
-            if (type == TourType::swiss) {
-                swap = player0.whiteCnt > player1.whiteCnt;
-            }
-            MatchRecord record(name0, name1, swapPairSides && swap);
-            record.round = round;
-            addMatchRecord(record);
-            return true;
-        }
-        player0.flag &= ~1;
-        
-    }
-    return r;
-}
-
 bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
 {
     if (playerVec.size() < 2) {
@@ -1027,21 +1642,49 @@ bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
                   return lhs.getScore() > rhs.getScore();
               });
     
-    std::set<std::string> pairedSet;
-    for(auto && m : matchRecordList) {
-        if (m.playernames[0].empty() || m.playernames[1].empty()) continue;
-        pairedSet.insert(m.playernames[0] + "*" + m.playernames[1]);
+    // players get their places as ids, pairs of all rounds so far are forbidden
+    auto n = int(playerVec.size());
+    std::unordered_map<std::string, int> idMap;
+    for(int i = 0; i < n; i++) {
+        idMap[playerVec[i].name] = i;
+    }
+    
+    PairMatcher matcher(n);
+    for(auto && r : matchRecordList) {
+        auto it0 = idMap.find(r.playernames[0]), it1 = idMap.find(r.playernames[1]);
+        if (it0 != idMap.end() && it1 != idMap.end()) {
+            matcher.forbid(it0->second, it1->second);
+        }
     }
     
-    if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
+    std::vector<int> mate;
+    if (!matcher.match(mate)) {
         std::cout << "Warning: All players have played together already." << std::endl;
-        pairedSet.clear();
-        if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
+        if (!PairMatcher(n).match(mate)) {
             std::cerr << "Error: cannot pair players." << std::endl;
             return false;
         }
     }
     
+    for(int i = 0; i < n; i++) {
+        auto j = mate[i];
+        if (j < i) {
+            continue;
+        }
+        auto& player0 = playerVec[i];
+        auto& player1 = playerVec[j];
+        
+        // random swap to avoid name0 player plays all white side
+        auto swap = rand() & 1;
+        
+        if (type == TourType::swiss) {
+            swap = player0.whiteCnt > player1.whiteCnt;
+        }
+        MatchRecord record(player0.name, player1.name, swapPairSides && swap);
+        record.round = round;
+        addMatchRecord(record);
+    }
+    
     std::string str = "\n" + std::string(tourTypeNames[static_cast<int>(type)]) + " round: " + std::to_string(round + 1);
     if (type == TourType::swiss) {
         str += "/" + std::to_string(swissRounds);
@@ -1049,6 +1692,7 @@ bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
     str += ", pairs: " + std::to_string(playerVec.size() / 2) + ", matches: " + std::to_string(uncompletedMatches());
     
     matchLog(str, true);
+    assignOpenings();
     return true;
 }
 
@@ -1056,12 +1700,19 @@ std::string TourMng::createLogPath(std::string opath, bool onefile, bool usesurf
 {
     if (onefile || game == nullptr) return opath;
     
-    std::string s = (usesurfix ? ", " : "-") + std::to_string(game->getIdx() + 1);
+    if (usesurfix && (!game->getPlayer(Side::white) || !game->getPlayer(Side::black))) {
+        return "";
+    }
+    return createLogPath(opath, onefile, usesurfix, game->getIdx(), usesurfix ? game->getGameTitleString(includeGameResult) : "", forSide);
+}
+
+std::string TourMng::createLogPath(std::string opath, bool onefile, bool usesurfix, int gameIdx, const std::string& gameTitle, Side forSide)
+{
+    if (onefile) return opath;
+    
+    std::string s = (usesurfix ? ", " : "-") + std::to_string(gameIdx + 1);
     if (usesurfix) {
-        if (!game->getPlayer(Side::white) || !game->getPlayer(Side::black)) {
-            return "";
-        }
-        s += ") " + game->getGameTitleString(includeGameResult);
+        s += ") " + gameTitle;
     }
     
     if (forSide != Side::none) {
@@ -1106,8 +1757,7 @@ void TourMng::matchLog(const std::string& infoString, bool verbose)
     }
     
     if (logResultMode && !logResultPath.empty()) {
-        std::lock_guard<std::mutex> dolock(matchMutex);
-        append2TextFile(logResultPath, infoString);
+        logWriter.write(logResultPath, infoString);
     }
 }
 
@@ -1116,7 +1766,16 @@ void TourMng::showEgineInOutToScreen(bool enabled)
     logScreenEngineInOutMode = enabled;
 }
 
-void TourMng::engineLog(const Game* game, const std::string& name, const std::string& line, LogType logType, Side bySide)
+std::string TourMng::engineLogPath(const Game* game, Side bySide)
+{
+    auto path = createLogPath(logEnginePath, logEngineAllInOneMode, logEngineGameTitleSurfix, false, game, logEngineBySides ? bySide : Side::none);
+    if (logEngineCompressMode && !path.empty() && !GzipFile::isGzipPath(path)) {
+        path += ".gz";
+    }
+    return path;
+}
+
+void TourMng::engineLog(const Game* game, const std::string& name, const std::string& line, LogType logType, Side bySide, const std::string* logPath)
 {
     if (line.empty() || !logEngineMode || logEnginePath.empty()) return;
     
@@ -1144,15 +1803,9 @@ void TourMng::engineLog(const Game* game, const std::string& name, const std::st
         printText(str);
     }
     
-    auto forSide = Side::none;
-    if (logEngineBySides) {
-        forSide = bySide;
-    }
-    auto path = createLogPath(logEnginePath, logEngineAllInOneMode, logEngineGameTitleSurfix, false, game, forSide);
-    
+    auto path = logPath ? *logPath : engineLogPath(game, bySide);
     if (!path.empty()) {
-        std::lock_guard<std::mutex> dolock(logMutex);
-        append2TextFile(path, str);
+        logWriter.write(path, str);
     }
 }
 
@@ -1163,35 +1816,69 @@ void TourMng::append2TextFile(const std::string& path, const std::string& str)
     ofs.close();
 }
 
+// compressed games go through the log writer, which keeps the file open and writes whole frames
+void TourMng::appendPgn(const std::string& path, const std::string& pgnString)
+{
+    if (path.empty()) return;
+    
+    auto p = path;
+    if (logPgnCompressMode && !GzipFile::isGzipPath(p)) {
+        p += ".gz";
+    }
+    if (GzipFile::isGzipPath(p)) {
+        logWriter.write(p, pgnString);
+    } else {
+        append2TextFile(p, pgnString);
+    }
+}
+
+
+void TourMng::saveMetrics()
+{
+    if (!Metrics::saveToJsonFile(metricsPath)) {
+        std::cerr << "Error: can't write metrics file " << metricsPath << std::endl;
+    }
+}
 
 void TourMng::shutdown()
 {
-    timer.remove(mainTimerId);
-    playerMng.shutdown();
+    if (!batch) {
+        timer.remove(mainTimerId);
+    }
+    if (metricsTimerOn) {
+        timer.remove(metricsTimerId);
+    }
+    coordinator.shutdown();
+    worker.shutdown();
+    scheduler.shutdown();
+    syzygyProber.shutdown();
+    // the batch shuts its shared engines down
+    if (!batch) {
+        playerMng->shutdown();
+    }
+    profileSampler.shutdown();
+    logWriter.shutdown();
+    archive.close();
+    
+    if (metricsTimerOn) {
+        metricsTimerOn = false;
+        saveMetrics();
+    }
 }
 
 int TourMng::uncompletedMatches()
 {
-    auto cnt = 0;
-    for(auto && r : matchRecordList) {
-        if (r.state == MatchState::none) {
-            cnt++;
-        }
-    }
-    return cnt;
+    return int(pendingQueue.size());
 }
 
 
-#ifdef _WIN32
-const std::string matchPath = "playing.json";
-#else
-const std::string matchPath = "./playing.json";
-#endif
-
 
 void TourMng::removeMatchRecordFile()
 {
-    std::remove(matchPath.c_str());
+    journal.close();
+    std::remove(matchRecordPath.c_str());
+    std::remove(journalRecordPath.c_str());
+    snapshotSaved = false;
 }
 
 void TourMng::saveMatchRecords()
@@ -1207,18 +1894,65 @@ void TourMng::saveMatchRecords()
     
     Json::Value a;
     for(auto && r : matchRecordList) {
-        a.append(r.saveToJson());
+        a.append(r.saveToJson(bookMng.getOpeningTable()));
     }
     d["recordList"] = a;
     d["elapsed"] = static_cast<int>(time(nullptr) - startTime);
     
-    JsonSavable::saveToJsonFile(matchPath, d);
+    JsonSavable::saveToJsonFile(matchRecordPath, d);
+    
+    // the snapshot has all changes, start a new journal
+    journal.close();
+    std::remove(journalRecordPath.c_str());
+    journaledRecordCnt = matchRecordList.size();
+    snapshotSaved = true;
+}
+
+// Appends the changed record and the ones created since the last write, one compact
+// line each. The snapshot is rewritten only when the journal grows as long as the
+// record list, that keeps the cost per game constant
+void TourMng::journalMatchRecords(int gIdx)
+{
+    if (!resumable) {
+        return;
+    }
+    
+    if (!snapshotSaved
+        || journal.getEntryCnt() >= std::max<size_t>(256, matchRecordList.size())
+        || (!journal.isOpen() && !journal.open(journalRecordPath))) {
+        saveMatchRecords();
+        return;
+    }
+    
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    
+    auto elapsed = static_cast<int>(time(nullptr) - startTime);
+    std::vector<size_t> idxList;
+    auto firstNew = std::min(journaledRecordCnt, matchRecordList.size());
+    if (gIdx >= 0 && size_t(gIdx) < firstNew) {
+        idxList.push_back(size_t(gIdx));
+    }
+    for(auto i = firstNew; i < matchRecordList.size(); i++) {
+        idxList.push_back(i);
+    }
+    
+    for(auto && i : idxList) {
+        Json::Value obj;
+        obj["record"] = matchRecordList[i].saveToJson(bookMng.getOpeningTable());
+        obj["elapsed"] = elapsed;
+        if (!journal.append(Json::writeString(builder, obj))) {
+            saveMatchRecords();
+            return;
+        }
+    }
+    journaledRecordCnt = matchRecordList.size();
 }
 
 bool TourMng::loadMatchRecords(bool autoYesReply)
 {
     Json::Value d;
-    if (!resumable || !loadFromJsonFile(matchPath, d, false)) {
+    if (!resumable || !loadFromJsonFile(matchRecordPath, d, false)) {
         return false;
     }
     
@@ -1228,11 +1962,39 @@ bool TourMng::loadMatchRecords(bool autoYesReply)
     for(int i = 0; i < int(array.size()); i++) {
         auto v = array[i];
         MatchRecord record;
-        if (record.load(v)) {
+        if (record.load(v, bookMng.getOpeningTable())) {
             recordList.push_back(record);
-            if (record.state == MatchState::none) {
-                uncompletedCnt++;
-            }
+        }
+    }
+    
+    // replay the changes made after the snapshot, a broken last line (crash) is ignored
+    auto elapsed = d["elapsed"].asInt();
+    Json::CharReaderBuilder readerBuilder;
+    std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+    for(auto && line : readTextFileToArray(journalRecordPath)) {
+        Json::Value obj;
+        std::string errorString;
+        if (line.empty() || !reader->parse(line.c_str(), line.c_str() + line.size(), &obj, &errorString)
+            || !obj.isMember("record")) {
+            continue;
+        }
+        MatchRecord record;
+        if (!record.load(obj["record"], bookMng.getOpeningTable())) {
+            continue;
+        }
+        if (record.gameIdx >= 0 && record.gameIdx < int(recordList.size())) {
+            recordList[record.gameIdx] = record;
+        } else if (record.gameIdx == int(recordList.size())) {
+            recordList.push_back(record);
+        } else {
+            continue;
+        }
+        elapsed = obj["elapsed"].asInt();
+    }
+    
+    for(auto && record : recordList) {
+        if (record.state == MatchState::none) {
+            uncompletedCnt++;
         }
     }
     
@@ -1264,6 +2026,7 @@ bool TourMng::loadMatchRecords(bool autoYesReply)
     std::cout << "Tournament resumed!" << std::endl;
     
     matchRecordList = recordList;
+    rebuildMatchIndexes();
     
     auto first = matchRecordList.front();
     
@@ -1287,11 +2050,9 @@ bool TourMng::loadMatchRecords(bool autoYesReply)
     }
 
     assert(timeController.isValid());
-    previousElapsed += d["elapsed"].asInt();
+    previousElapsed += elapsed;
     
     removeMatchRecordFile();
-    
-    startTournament();
     return true;
 }
 
@@ -1305,43 +2066,22 @@ void TourMng::matchCompleted(Game* game)
         assert(record->state == MatchState::playing);
         record->state = MatchState::completed;
         record->result = game->board.result;
+        addToStandings(*record);
+        adaptiveConcurrency.addGame(record->result.reason == ReasonType::timeout);
         
-        EngineStats engineStats[2];
-        for(auto && hist : game->board.histList) {
-            // not for uncomputing moves
-            if (hist.nodes == 0) {
-                continue;
-            }
-            auto sd = static_cast<int>(hist.move.piece.side);
-            engineStats[sd].nodes += hist.nodes;
-            engineStats[sd].depths += hist.depth;
-            engineStats[sd].elapsed += hist.elapsed;
-            engineStats[sd].moves++;
-        }
-        
-        for(int sd = 0; sd < 2; sd++) {
-            engineStats[sd].games++;
-            auto side = static_cast<Side>(sd);
-            auto name = game->getPlayer(side)->getName();
-            auto it = engineStatsMap.find(name);
-            if (it != engineStatsMap.end()) {
-                engineStats[sd].add(it->second);
-            }
-            engineStatsMap[name] = engineStats[sd];
-            //            std::cout << "adding, sd: " << sd << ", name: " << name << ", #n: " << game->board.histList.size()
-            //            << ", games: " << engineStats[sd].games
-            //            << ", nodes: " << engineStats[sd].nodes
-            //            << ", depths: " << engineStats[sd].depths
-            //            << ", moves: " << engineStats[sd].moves
-            //            << ", elapsed: " << engineStats[sd].elapsed
-            //            << std::endl;
-        }
+        std::string names[2] = { game->getPlayer(Side::black)->getName(), game->getPlayer(Side::white)->getName() };
+        addEngineStats(game->board, names);
         
         if (pgnPathMode && !pgnPath.empty()) {
             auto pgnString = game->toPgn(eventName, siteName, record->round, record->gameIdx, logPgnRichMode);
             auto path = createLogPath(pgnPath, logPgnAllInOneMode, logPgnGameTitleSurfix, true, game);
-            if (!path.empty()) {
-                append2TextFile(path, pgnString);
+            appendPgn(path, pgnString);
+        }
+        
+        if (archive.isOpen()) {
+            auto header = game->createPgnHeader(eventName, siteName, record->round, record->gameIdx);
+            if (!archive.append(*game, header)) {
+                std::cerr << "Error: can't write to archive file " << archivePath << std::endl;
             }
         }
     }
@@ -1355,24 +2095,16 @@ void TourMng::matchCompleted(Game* game)
         << ", " << game->board.result.toString();
         
         if (profileMode) {
+            // pooled engines are sampled across games, take only this game's part
+            Profile profiles[] = { wplayer->takeProfile(), bplayer->takeProfile() };
+            EngineProfile* players[] = { wplayer, bplayer };
             auto w = int(std::max(wplayer->getName().length(), bplayer->getName().length()));
-            stringStream
-            << "\n\t" << std::setw(w) << wplayer->getName() << std::setw(0) << ": " << wplayer->profile.toString(false)
-            << "\n\t" << std::setw(w) << bplayer->getName() << std::setw(0) << ": " << bplayer->profile.toString(false);
-            
-            Profile profile = wplayer->profile;
-            auto it = profileMap.find(wplayer->getName());
-            if (it != profileMap.end()) {
-                profile.addFrom(it->second);
-            }
-            profileMap[wplayer->getName()] = profile;
-            
-            profile = bplayer->profile;
-            it = profileMap.find(bplayer->getName());
-            if (it != profileMap.end()) {
-                profile.addFrom(it->second);
+            for(int i = 0; i < 2; i++) {
+                stringStream
+                << "\n\t" << std::setw(w) << players[i]->getName() << std::setw(0) << ": " << profiles[i].toString(false);
+                
+                profileMap[players[i]->getName()].addFrom(profiles[i]);
             }
-            profileMap[bplayer->getName()] = profile;
         }
         
         auto infoString = stringStream.str();
@@ -1383,71 +2115,96 @@ void TourMng::matchCompleted(Game* game)
         }
     }
     
+    if (remoteMode == RemoteMode::worker) {
+        if (gIdx >= 0 && gIdx < matchRecordList.size()) {
+            sendRemoteResult(game, matchRecordList[gIdx]);
+        }
+        return;
+    }
+    
     checkToExtendMatches(gIdx);
     
-    saveMatchRecords();
+    journalMatchRecords(gIdx);
 }
 
-std::vector<TourPlayer> TourMng::collectStats() const
+void TourMng::addEngineStats(const ChessBoard& board, const std::string names[2])
 {
-    std::map<std::string, TourPlayer> resultMap;
-    
-    for(auto && m : matchRecordList) {
-        if (m.result.result == ResultType::noresult) { // hm ?
+    EngineStats engineStats[2];
+    for(size_t i = 0; i < board.noteList.size() && i < board.histList.size(); i++) {
+        auto& note = board.noteList[i];
+        // not for uncomputing moves
+        if (note.info.nodes == 0) {
             continue;
         }
-        
-        for(int sd = 0; sd < 2; sd++) {
-            auto name = m.playernames[sd];
-            if (name.empty()) { // bye players (in knockout) won without opponents
-                continue;
-            }
-            
-            TourPlayer r;
-            auto it = resultMap.find(name);
-            if (it == resultMap.end()) {
-                r.name = name;
-            } else {
-                r = it->second; assert(r.name == name);
-            }
-            
-            if (m.playernames[1 - sd].empty()) { // bye player
-                r.byeCnt++;
-            }
-            
-            auto lossCnt = r.lossCnt;
-            r.gameCnt++;
-            switch (m.result.result) {
-                case ResultType::win:
-                    if (sd == W) r.winCnt++; else r.lossCnt++;
-                    break;
-                case ResultType::draw:
-                    r.drawCnt++;
-                    break;
-                case ResultType::loss:
-                    if (sd == B) r.winCnt++; else r.lossCnt++;
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-            
-            if (lossCnt < r.lossCnt) {
-                if (m.result.reason == ReasonType::illegalmove || m.result.reason == ReasonType::crash || m.result.reason == ReasonType::timeout) {
-                    r.abnormalCnt++;
-                }
-            }
-            resultMap[name] = r;
-        }
+        auto sd = static_cast<int>(board.histList[i].move.piece().side);
+        engineStats[sd].nodes += note.info.nodes;
+        engineStats[sd].depths += note.info.depth;
+        engineStats[sd].elapsed += note.elapsed;
+        engineStats[sd].overhead += note.overhead;
+        engineStats[sd].moves++;
     }
     
+    for(int sd = 0; sd < 2; sd++) {
+        engineStats[sd].games++;
+        engineStatsMap[names[sd]].add(engineStats[sd]);
+    }
+}
+
+std::vector<TourPlayer> TourMng::collectStats() const
+{
     std::vector<TourPlayer> resultList;
-    for (auto && s : resultMap) {
+    for (auto && s : standingMap) {
         resultList.push_back(s.second);
     }
     return resultList;
 }
 
+// points of each player against each other (in the order of resultList), for not too many players
+std::string TourMng::createCrosstable(const std::vector<TourPlayer>& resultList) const
+{
+    auto n = int(resultList.size());
+    if (n < 3 || n > crosstableMaxPlayers) {
+        return "";
+    }
+    
+    auto maxNameLen = 0;
+    for (auto && r : resultList) {
+        maxNameLen = std::max(maxNameLen, int(r.name.length()));
+    }
+    
+    const int w = 6;
+    std::stringstream stringStream;
+    stringStream.precision(1);
+    stringStream << std::fixed;
+    
+    stringStream << "\nCrosstable (points of row players against column ones):\n"
+    << "  #  " << std::left << std::setw(maxNameLen + 2) << "name";
+    for(int j = 0; j < n; j++) {
+        stringStream << std::right << std::setw(w) << (j + 1);
+    }
+    stringStream << std::endl;
+    
+    for(int i = 0; i < n; i++) {
+        stringStream
+        << std::right << std::setw(3) << (i + 1) << ". "
+        << std::left << std::setw(maxNameLen + 2) << resultList.at(i).name;
+        
+        for(int j = 0; j < n; j++) {
+            double points;
+            int games;
+            if (i == j) {
+                stringStream << std::right << std::setw(w) << "x";
+            } else if (ratingSolver.getPairResult(resultList.at(i).name, resultList.at(j).name, points, games)) {
+                stringStream << std::right << std::setw(w) << points;
+            } else {
+                stringStream << std::right << std::setw(w) << ".";
+            }
+        }
+        stringStream << std::endl;
+    }
+    return stringStream.str();
+}
+
 std::string TourMng::createTournamentStats()
 {
     
@@ -1469,7 +2226,9 @@ std::string TourMng::createTournamentStats()
     stringStream.precision(1);
     stringStream << std::fixed;
     
-    auto separateLineSz = maxNameLen + 62;
+    auto ratingMap = ratingSolver.getRatings();
+    
+    auto separateLineSz = maxNameLen + 78;
     for(int i = 0; i < separateLineSz; i++) {
         stringStream << "-";
     }
@@ -1477,7 +2236,7 @@ std::string TourMng::createTournamentStats()
     
     stringStream << "  #  "
     << std::left << std::setw(maxNameLen + 2) << "name"
-    << "games   wins%  draws% losses%   score    los%  elo+/-"
+    << "games   wins%  draws% losses%   score    los%  elo+/-  rating     +/-"
     << std::endl;
     
     const int w = 8, pw = 7;
@@ -1503,6 +2262,17 @@ std::string TourMng::createTournamentStats()
         << std::right << std::setw(w) << elo.los * 100
         << std::right << std::setw(w) << elo.elo_difference;
         
+        auto it = ratingMap.find(r.name);
+        if (it != ratingMap.end()) {
+            stringStream
+            << std::right << std::setw(w) << it->second.rating
+            << std::right << std::setw(w) << it->second.error;
+        } else {
+            stringStream
+            << std::right << std::setw(w) << "-"
+            << std::right << std::setw(w) << "-";
+        }
+        
         stringStream << std::left << std::setw(0) << std::endl;
     }
     
@@ -1510,8 +2280,11 @@ std::string TourMng::createTournamentStats()
         stringStream << "-";
     }
     
+    stringStream << std::endl << "rating: joint maximum likelihood Elo of all players (average 0), +/-: 95% error margin" << std::endl;
+    stringStream << createCrosstable(resultList);
+    
     /////////////
-    stringStream << std::endl << "\nTech (average nodes, depths, time/m per move, others per game):\n";
+    stringStream << std::endl << "\nTech (average nodes, depths, time/m, overhead per move, others per game):\n";
     
     EngineStats allStats;
     for(auto && s : engineStatsMap) {
@@ -1526,6 +2299,7 @@ std::string TourMng::createTournamentStats()
     << std::right << std::setw(w) << "time/m"
     << std::right << std::setw(w) << "moves"
     << std::right << std::setw(w) << "time"
+    << std::right << std::setw(w) << "ovh(ms)"
     ;
     
     if (abnormalCnt) {
@@ -1540,6 +2314,8 @@ std::string TourMng::createTournamentStats()
         << std::right << std::setw(pw) << "max"
         << std::right << std::setw(pw + 1) << "threads"
         << std::right << std::setw(pw - 1) << "max"
+        << std::right << std::setw(pw) << "csw/s"
+        << std::right << std::setw(pw) << "ncsw/s"
         ;
     }
     
@@ -1562,6 +2338,7 @@ std::string TourMng::createTournamentStats()
         
         << std::right << std::setw(w) << double(stats.moves) / games
         << std::right << std::setw(w) << stats.elapsed / games
+        << std::right << std::setw(w) << stats.overhead * 1000 / moves
         ;
         
         if (abnormalCnt) {
@@ -1590,9 +2367,10 @@ std::string TourMng::createTournamentStats()
     << std::left << std::setw(maxNameLen + 2) << "all ---"
     << std::right << std::setw(w) << nodeStr
     << std::right << std::setw(w) << double(allStats.depths) / moves
+    << std::right << std::setw(w) << allStats.elapsed / double(std::max<i64>(1, allStats.moves))
     << std::right << std::setw(w) << double(allStats.moves) / games
     << std::right << std::setw(w) << allStats.elapsed / games
-    << std::right << std::setw(w) << allStats.elapsed / double(std::max<i64>(1, allStats.moves));
+    << std::right << std::setw(w) << allStats.overhead * 1000 / moves;
     
     if (abnormalCnt) {
         stringStream << std::right << std::setw(w) << abnormalCnt;
@@ -1613,7 +2391,302 @@ std::string TourMng::createTournamentStats()
         stringStream << "Failed games (timeout, crashed, illegal moves): " << abnormalCnt << " of " << matchRecordList.size();
     }
     
+    if (syzygyProber.isRunning()) {
+        stringStream << (abnormalCnt ? "\n" : "") << syzygyProber.toString();
+    }
+    
+    if (sprt.mode) {
+        auto playedCnt = 0;
+        for(auto && r : matchRecordList) {
+            if (r.state == MatchState::completed) {
+                playedCnt++;
+            }
+        }
+        stringStream << (abnormalCnt || syzygyProber.isRunning() ? "\n" : "") << sprt.toString()
+        << ", tested: " << sprtPlayer << ", games played: " << playedCnt << " of " << matchRecordList.size();
+    }
+    
     return stringStream.str();
 }
 
 
+
+////////////////////////////////////////////////////////////////////////
+// Distributed mode
+
+bool TourMng::startRemote()
+{
+    if (remoteMode == RemoteMode::coordinator) {
+        if (!coordinator.start(remotePort)) {
+            std::cerr << "Error: can't listen on port " << remotePort << " for workers" << std::endl;
+            return false;
+        }
+        std::cout << "Coordinator: waiting for workers on port " << remotePort << ", lease: " << leaseTime << "s" << std::endl;
+        return true;
+    }
+    
+    if (!worker.start(remoteHost, remotePort)) {
+        std::cerr << "Error: can't connect to the coordinator " << remoteHost << ":" << remotePort << std::endl;
+        return false;
+    }
+    
+    Json::Value obj;
+    obj["cmd"] = "hello";
+    obj["version"] = getVersion();
+    obj["concurrency"] = gameConcurrency;
+    worker.send(obj);
+    
+    std::cout << "Worker: connected to the coordinator " << remoteHost << ":" << remotePort << std::endl;
+    return true;
+}
+
+void TourMng::handleRemoteMessages()
+{
+    if (remoteMode == RemoteMode::coordinator) {
+        for(auto && msg : coordinator.takeMessages()) {
+            auto cmd = msg.getCmd();
+            
+            // any message tells the worker is alive
+            auto expireClock = std::chrono::steady_clock::now() + std::chrono::seconds(leaseTime);
+            for(auto && p : leaseMap) {
+                if (p.second.connId == msg.connId) {
+                    p.second.expireClock = expireClock;
+                }
+            }
+            
+            if (cmd == "request") {
+                leaseMatch(msg.connId);
+            } else if (cmd == "result") {
+                remoteMatchCompleted(msg.connId, msg.obj);
+            } else if (cmd == "failed") {
+                auto gIdx = msg.obj["game idx"].asInt();
+                auto it = leaseMap.find(gIdx);
+                if (it != leaseMap.end() && it->second.leaseId == msg.obj["lease id"].asInt()) {
+                    std::cerr << "Warning: worker " << coordinator.getPeerName(msg.connId) << " can't play game " << (gIdx + 1) << ", rescheduled" << std::endl;
+                    releaseLease(gIdx);
+                }
+            } else if (cmd == "hello") {
+                std::cout << "Worker connected: " << coordinator.getPeerName(msg.connId)
+                << ", version: " << msg.obj["version"].asString()
+                << ", concurrency: " << msg.obj["concurrency"].asInt() << std::endl;
+                
+                Json::Value obj;
+                obj["cmd"] = "hello";
+                obj["version"] = getVersion();
+                obj["lease"] = leaseTime;
+                coordinator.send(msg.connId, obj);
+            } else if (cmd == "closed") {
+                std::vector<int> gIdxList;
+                for(auto && p : leaseMap) {
+                    if (p.second.connId == msg.connId) {
+                        gIdxList.push_back(p.first);
+                    }
+                }
+                std::cout << "Worker left: " << coordinator.getPeerName(msg.connId) << ", games rescheduled: " << gIdxList.size() << std::endl;
+                for(auto && gIdx : gIdxList) {
+                    releaseLease(gIdx);
+                }
+                coordinator.removeConnection(msg.connId);
+            }
+        }
+        return;
+    }
+    
+    if (remoteMode == RemoteMode::worker) {
+        for(auto && msg : worker.takeMessages()) {
+            auto cmd = msg.getCmd();
+            if (cmd == "match") {
+                remoteRequestCnt = std::max(0, remoteRequestCnt - 1);
+                addRemoteMatch(msg.obj);
+            } else if (cmd == "wait") {
+                remoteRequestCnt = std::max(0, remoteRequestCnt - 1);
+                remoteWaitTick = 6;
+            } else if (cmd == "hello") {
+                if (msg.obj["version"].asString() != getVersion()) {
+                    std::cout << "Warning: the coordinator runs version " << msg.obj["version"].asString() << std::endl;
+                }
+            } else if (cmd == "closed" && !remoteClosed) {
+                remoteClosed = true;
+                std::cout << "Worker: the coordinator closed the connection" << std::endl;
+            }
+        }
+    }
+}
+
+void TourMng::leaseMatch(int connId)
+{
+    Json::Value obj;
+    
+    // nothing now, the worker asks again later
+    if (state != TourState::playing || pendingQueue.empty() || sprt.getState() != SprtState::running) {
+        obj["cmd"] = "wait";
+        coordinator.send(connId, obj);
+        return;
+    }
+    
+    auto gIdx = pendingQueue.front();
+    pendingQueue.pop_front();
+    auto& record = matchRecordList[gIdx];
+    assert(record.state == MatchState::none);
+    record.state = MatchState::playing;
+    
+    RemoteLease lease;
+    lease.connId = connId;
+    lease.leaseId = nextLeaseId++;
+    lease.expireClock = std::chrono::steady_clock::now() + std::chrono::seconds(leaseTime);
+    leaseMap[gIdx] = lease;
+    
+    obj["cmd"] = "match";
+    obj["lease id"] = lease.leaseId;
+    obj["record"] = record.saveToJson(bookMng.getOpeningTable());
+    obj["time control"] = timeController.saveToJson();
+    obj["event"] = eventName;
+    obj["site"] = siteName;
+    
+    if (!coordinator.send(connId, obj)) {
+        releaseLease(gIdx);
+        return;
+    }
+    
+    Metrics::count(MetricCount::gamesStarted);
+    if (banksiaVerbose) {
+        printText(std::to_string(gIdx + 1) + ". " + record.playernames[W] + " vs " + record.playernames[B] + " (" + coordinator.getPeerName(connId) + ")");
+    }
+}
+
+void TourMng::releaseLease(int gIdx)
+{
+    leaseMap.erase(gIdx);
+    if (gIdx >= 0 && gIdx < int(matchRecordList.size()) && matchRecordList[gIdx].state == MatchState::playing) {
+        matchRecordList[gIdx].state = MatchState::none;
+        pendingQueue.push_front(gIdx);
+    }
+    EventScheduler::post();
+}
+
+void TourMng::checkLeases()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> gIdxList;
+    for(auto && p : leaseMap) {
+        if (p.second.expireClock < now) {
+            gIdxList.push_back(p.first);
+        }
+    }
+    
+    for(auto && gIdx : gIdxList) {
+        std::cerr << "Warning: the lease of game " << (gIdx + 1) << " by " << coordinator.getPeerName(leaseMap[gIdx].connId) << " expired, rescheduled" << std::endl;
+        releaseLease(gIdx);
+    }
+}
+
+void TourMng::remoteMatchCompleted(int connId, const Json::Value& obj)
+{
+    auto gIdx = obj["game idx"].asInt();
+    auto it = leaseMap.find(gIdx);
+    if (it == leaseMap.end() || it->second.leaseId != obj["lease id"].asInt()) {
+        std::cerr << "Warning: ignored a result of game " << (gIdx + 1) << " from " << coordinator.getPeerName(connId) << ", its lease expired" << std::endl;
+        return;
+    }
+    
+    std::string body;
+    ChessBoard board;
+    PgnHeader header;
+    bool infoMode;
+    if (!RemoteLink::fromBase64(obj["game"].asString(), body)
+        || !GameArchive::decode(body.c_str(), body.size(), board, header, infoMode)) {
+        std::cerr << "Error: bad game record of game " << (gIdx + 1) << " from " << coordinator.getPeerName(connId) << ", rescheduled" << std::endl;
+        releaseLease(gIdx);
+        return;
+    }
+    leaseMap.erase(it);
+    
+    auto& record = matchRecordList[gIdx];
+    assert(record.state == MatchState::playing);
+    record.state = MatchState::completed;
+    record.result = board.result;
+    addToStandings(record);
+    addEngineStats(board, record.playernames);
+    
+    auto title = record.playernames[W] + " (" + board.result.toShortString() + ") " + record.playernames[B];
+    
+    if (pgnPathMode && !pgnPath.empty()) {
+        header.event = eventName;
+        header.site = siteName;
+        header.round = record.round;
+        header.gameIdx = record.gameIdx;
+        auto path = createLogPath(pgnPath, logPgnAllInOneMode, logPgnGameTitleSurfix, gIdx, title);
+        appendPgn(path, Game::toPgn(board, header, logPgnRichMode));
+    }
+    
+    if (archive.isOpen() && !archive.appendRecord(body)) {
+        std::cerr << "Error: can't write to archive file " << archivePath << std::endl;
+    }
+    
+    std::ostringstream stringStream;
+    stringStream << (gIdx + 1) << ") " << record.playernames[W] << " vs " << record.playernames[B]
+    << ", #" << board.histList.size()
+    << ", " << board.result.toString()
+    << " (" << coordinator.getPeerName(connId) << ")";
+    matchLog(stringStream.str(), banksiaVerbose);
+    
+    checkToExtendMatches(gIdx);
+    journalMatchRecords(gIdx);
+    EventScheduler::post();
+}
+
+void TourMng::requestRemoteMatches()
+{
+    if (remoteClosed || remoteWaitTick > 0) {
+        return;
+    }
+    
+    while (int(gameList.size() + preparedList.size() + pendingQueue.size()) + remoteRequestCnt < getConcurrency() + lookahead) {
+        Json::Value obj;
+        obj["cmd"] = "request";
+        if (!worker.send(obj)) {
+            remoteClosed = true;
+            break;
+        }
+        remoteRequestCnt++;
+    }
+}
+
+void TourMng::addRemoteMatch(const Json::Value& obj)
+{
+    MatchRecord record;
+    if (!record.load(obj["record"], bookMng.getOpeningTable()) || !timeController.load(obj["time control"])) {
+        std::cerr << "Error: bad match from the coordinator" << std::endl;
+        return;
+    }
+    eventName = obj["event"].asString();
+    siteName = obj["site"].asString();
+    
+    RemoteMatch remoteMatch;
+    remoteMatch.leaseId = obj["lease id"].asInt();
+    remoteMatch.gameIdx = record.gameIdx;
+    
+    // played under a local index, reported under the coordinator's one
+    remoteMatchMap[int(matchRecordList.size())] = remoteMatch;
+    addMatchRecord_simple(record);
+}
+
+void TourMng::sendRemoteResult(const Game* game, const MatchRecord& record)
+{
+    auto it = remoteMatchMap.find(record.gameIdx);
+    if (it == remoteMatchMap.end()) {
+        return;
+    }
+    
+    auto header = game->createPgnHeader(eventName, siteName, record.round, it->second.gameIdx);
+    
+    Json::Value obj;
+    obj["cmd"] = "result";
+    obj["lease id"] = it->second.leaseId;
+    obj["game idx"] = it->second.gameIdx;
+    obj["game"] = RemoteLink::toBase64(GameArchive::encode(*game, header, true));
+    if (!worker.send(obj)) {
+        std::cerr << "Error: can't send the result of game " << (record.gameIdx + 1) << " to the coordinator" << std::endl;
+    }
+    remoteMatchMap.erase(it);
+}
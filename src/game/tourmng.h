@@ -26,11 +26,24 @@
 #ifndef tourmng_hpp
 #define tourmng_hpp
 
+#include <deque>
+#include <unordered_map>
+#include <functional>
+
 #include "game.h"
+#include "gamearchive.h"
+#include "distributed.h"
+#include "sprt.h"
+#include "adaptiveconcurrency.h"
+#include "pairmatcher.h"
+#include "ratingsolver.h"
 #include "configmng.h"
 #include "uciengine.h"
 #include "playermng.h"
 #include "book.h"
+#include "scheduler.h"
+#include "../base/journalfile.h"
+#include "../base/logwriter.h"
 
 #include "../3rdparty/cpptime/cpptime.h"
 
@@ -42,10 +55,10 @@ namespace banksia {
     class EngineStats {
     public:
         i64 nodes = 0, depths = 0, moves = 0, games = 0;
-        double elapsed = 0.0;
+        double elapsed = 0.0, overhead = 0.0;
         
         void add(const EngineStats& o) {
-            nodes += o.nodes; depths += o.depths; moves += o.moves; games += o.games; elapsed += o.elapsed;
+            nodes += o.nodes; depths += o.depths; moves += o.moves; games += o.games; elapsed += o.elapsed; overhead += o.overhead;
         }
     };
     
@@ -53,7 +66,8 @@ namespace banksia {
         none, playing, completed, error
     };
     
-    class MatchRecord : public Jsonable
+    // openings are shared by many records, they are saved with the table of their tournament
+    class MatchRecord : public Obj
     {
     public:
         MatchRecord() {}
@@ -66,8 +80,8 @@ namespace banksia {
         virtual bool isValid() const override;
         virtual std::string toString() const override;
         
-        virtual bool load(const Json::Value& obj) override;
-        virtual Json::Value saveToJson() const override;
+        bool load(const Json::Value& obj, OpeningTable& openingTable);
+        Json::Value saveToJson(const OpeningTable& openingTable) const;
 
         void swapPlayers() {
             std::swap(playernames[0], playernames[1]);
@@ -78,8 +92,8 @@ namespace banksia {
         
         std::string playernames[2];
         
-        std::string startFen;
-        std::vector<Move> startMoves;
+        // index into the opening table of the tournament's BookMng, -1 if not assigned yet
+        int openingIdx = -1;
         
         Result result;
         int gameIdx = 0, round = 0, pairId;
@@ -117,8 +131,12 @@ namespace banksia {
         double elo_difference, los;
     };
     
+    class TourBatch;
+    
     class TourMng : public Obj, public Tickable, public JsonSavable
     {
+        friend class TourBatch;
+        
     public:
         
         TourMng();
@@ -128,8 +146,8 @@ namespace banksia {
         
         bool createMatchList();
         bool createMatchList(std::vector<std::string> nameList, TourType type);
-        void createMatch(MatchRecord&);
-        bool createMatch(int gameIdx, const std::string& whiteName, const std::string& blackName, const std::string& startFen, const std::vector<Move>& startMoves);
+        void createMatch(MatchRecord&, bool standby = false);
+        bool createMatch(int gameIdx, const std::string& whiteName, const std::string& blackName, const std::string& startFen, const std::vector<Move>& startMoves, bool standby = false);
         
         bool start(const std::string& mainJsonPath, bool yesReply, bool noReply);
         
@@ -139,18 +157,30 @@ namespace banksia {
         void setEngineLogMode(bool enabled);
         void setEngineLogPath(const std::string&);
         
+        // runs as a worker of the coordinator at address (host:port), instead of the mode of the tour file
+        void setWorkerAddress(const std::string& address) { workerAddress = address; }
+        
+        // plays as a tournament of the batch, with its engines, game slots, timer and events
+        void setBatch(TourBatch* batch);
+        
+        // called when all matches completed, just before the app exits
+        void setFinishedCallback(std::function<void()> callback) { finishedCallback = callback; }
+        int getPriority() const { return batchPriority; }
+        
         std::string createTournamentStats();
         
         void showEgineInOutToScreen(bool enabled);
         void shutdown();
 
 		static void append2TextFile(const std::string& path, const std::string& str);
+        void appendPgn(const std::string& path, const std::string& pgnString);
         
         bool loadMatchRecords(bool autoYesReply);
 
     protected:
         void startTournament();
         std::vector<TourPlayer> collectStats() const;
+        std::string createCrosstable(const std::vector<TourPlayer>& resultList) const;
         
         void reset();
         
@@ -158,10 +188,18 @@ namespace banksia {
         
         void addMatchRecord(MatchRecord& record);
         void addMatchRecord_simple(MatchRecord& record);
+        void assignOpenings();
+        
+        void indexMatchRecord(const MatchRecord& record);
+        void rebuildMatchIndexes();
+        void addToStandings(const MatchRecord& record);
+        void updateSprt(const MatchRecord& record);
 
         void finishTournament();
         
-        void engineLog(const Game* game, const std::string& name, const std::string& line, LogType logType, Side bySide = Side::none);
+        // logPath is worked out from the game when not given
+        void engineLog(const Game* game, const std::string& name, const std::string& line, LogType logType, Side bySide = Side::none, const std::string* logPath = nullptr);
+        std::string engineLogPath(const Game* game, Side bySide);
         
         bool createNextRoundMatches();
         int getLastRound() const;
@@ -171,7 +209,6 @@ namespace banksia {
         // for all
         bool pairingMatchList(const std::vector<std::string>& nameList);
         bool pairingMatchList(std::vector<TourPlayer> playerVec, int round);
-        bool pairingMatchListRecusive(std::vector<TourPlayer>& playerVec, int round, const std::set<std::string>& pairedSet);
 
         // Knockout
         std::vector<TourPlayer> getKnockoutWinnerList();
@@ -183,17 +220,48 @@ namespace banksia {
         //
         void matchCompleted(Game* game);
         bool addGame(Game* game);
+        void announceGame(Game* game);
+        
+        // ended games are recycled, their boards keep the memory of previous games
+        Game* createGame(Player* white, Player* black);
+        void recycleGame(Game* game);
+        bool acquireGameSlot();
+        
+        // lookahead, prepared games have their engines started before slots free
+        void createQueuedMatch(bool standby);
+        bool startPreparedGame();
+        void dropPreparedGames();
+        void dropPreparedGame(Game* game, bool requeue);
+        void replaceCrashedPreparedGames();
         
         void tickWork() override;
+        int processEvents();
+        void updateGames();
         
         void matchLog(const std::string& line, bool verbose);
         int uncompletedMatches();
+        void saveMetrics();
+        bool planEngineMemory(int engineCnt);
+        void addEngineStats(const ChessBoard& board, const std::string names[2]);
+        
+        // distributed mode
+        bool startRemote();
+        void handleRemoteMessages();
+        void leaseMatch(int connId);
+        void remoteMatchCompleted(int connId, const Json::Value& obj);
+        void releaseLease(int gameIdx);
+        void checkLeases();
+        void requestRemoteMatches();
+        void addRemoteMatch(const Json::Value& obj);
+        void sendRemoteResult(const Game* game, const MatchRecord& record);
         
     protected:
         std::string eventName = "Chess Tournament", siteName;
         
         CppTime::Timer timer;
         CppTime::timer_id mainTimerId;
+        EventScheduler scheduler;
+        std::mutex scheduleMutex;
         
         TourType type = TourType::none;
         TourState state = TourState::none;
@@ -203,24 +271,61 @@ namespace banksia {
 
         std::vector<std::string> participantList;
         std::vector<MatchRecord> matchRecordList;
+        
+        // indexes of matchRecordList, kept along with it so ticks and events need no scans:
+        // matches waiting to be played, matches of each pair, results by players
+        std::deque<int> pendingQueue;
+        std::unordered_map<int, std::vector<int>> pairIndex;
+        std::map<std::string, TourPlayer> standingMap;
+        int lastRound = 0;
+        
+        // pairwise results for the joint ratings and the crosstable
+        RatingSolver ratingSolver;
+        const int crosstableMaxPlayers = 32;
+        
         std::vector<Game*> gameList;
-        PlayerMng playerMng;
+        std::deque<Game*> preparedList;
+        // matches whose prepared games lost an engine, each is prepared again once only
+        std::set<int> replacedPreparedSet;
+        std::vector<Game*> gamePool;
+        PlayerMng ownPlayerMng;
+        PlayerMng* playerMng = &ownPlayerMng;
         BookMng bookMng;
+        
+        // changes since the last snapshot of match records
+        JournalFile journal;
+        std::string matchRecordPath, journalRecordPath;
+        size_t journaledRecordCnt = 0;
+        bool snapshotSaved = false;
+        SyzygyProber syzygyProber;
+        std::string tbInitPath;
 
         void saveMatchRecords();
+        void journalMatchRecords(int gIdx);
         void removeMatchRecordFile();
         
         void showTournamentInfo();
         int calcMatchNumber() const;
         
         static std::string createLogPath(std::string opath, bool onefile, bool usesurfix, bool includeGameResult, const Game* game, Side forSide = Side::none);
+        static std::string createLogPath(std::string opath, bool onefile, bool usesurfix, int gameIdx, const std::string& gameTitle, Side forSide = Side::none);
         
     private:
-        int gameConcurrency = 1, gameperpair = 1, swissRounds = 6;
+        int gameConcurrency = 1, gameperpair = 1, swissRounds = 6, lookahead = 0;
         bool resumable = true, swapPairSides = true;
+        
+        // batch mode, a higher priority tournament takes free game slots first
+        TourBatch* batch = nullptr;
+        int batchPriority = 0, budgetId = -1;
+        std::function<void()> finishedCallback = nullptr;
 
         static void showPathInfo(const std::string& name, const std::string& path, bool mode);
         
+        // gameConcurrency is the upper bound when adaptive, new games start only below the current limit
+        AdaptiveConcurrency adaptiveConcurrency;
+        int getConcurrency() const { return adaptiveConcurrency.mode ? adaptiveConcurrency.getLimit() : gameConcurrency; }
+        
+        ProfileSampler profileSampler;
         std::map<std::string, Profile> profileMap;
         std::map<std::string, EngineStats> engineStatsMap;
 
@@ -228,6 +333,7 @@ namespace banksia {
         
         // endgame
         std::string syzygyPath;
+        bool syzygyWarmup = false;
         
         GameConfig gameConfig;
 
@@ -236,15 +342,48 @@ namespace banksia {
         std::set<std::string> inclusivePlayers;
         Side inclusivePlayerSide = Side::none;
         
+        // early stopping, sprtPlayer is the tested one (of a match or the single inclusive player of a gauntlet)
+        Sprt sprt;
+        std::string sprtPlayer;
+        
         int previousElapsed = 0;
         time_t startTime;
         
         // for logging
-        std::mutex matchMutex, logMutex;
+        LogWriter logWriter;
+        int logFlushInterval = 500;
+        int logFrameSize = 1024; // KB of text per frame of compressed logs
 
         std::string pgnPath;
         bool pgnPathMode = true, logPgnAllInOneMode = false;
         bool logPgnRichMode = false, logPgnGameTitleSurfix = false;
+        bool logPgnCompressMode = false;
+        
+        GameArchive archive;
+        std::string archivePath;
+        bool archiveMode = false, archiveRichMode = true;
+        
+        // distributed mode, see distributed.h
+        RemoteMode remoteMode = RemoteMode::off;
+        std::string remoteHost = "127.0.0.1", workerAddress;
+        int remotePort = RemoteLink::default_port, leaseTime = 120; // second
+        
+        // coordinator, leases are kept by game indexes
+        Coordinator coordinator;
+        std::unordered_map<int, RemoteLease> leaseMap;
+        int nextLeaseId = 1;
+        
+        // worker, remote matches are kept by local game indexes
+        Worker worker;
+        std::unordered_map<int, RemoteMatch> remoteMatchMap;
+        int remoteRequestCnt = 0, remoteWaitTick = 0, remoteAliveTick = 0;
+        bool remoteClosed = false;
+        
+        // the manager's own counters, dumped every metricsInterval seconds
+        std::string metricsPath;
+        bool metricsMode = false, metricsTimerOn = false;
+        int metricsInterval = 60;
+        CppTime::timer_id metricsTimerId;
         
         std::string logResultPath;
         bool logResultMode = false;
@@ -252,7 +391,7 @@ namespace banksia {
         std::string logEnginePath;
         bool logEngineAllInOneMode = false, logEngineMode = false;
         bool logEngineShowTime = false, logEngineGameTitleSurfix = false;
-        bool logEngineBySides = false;
+        bool logEngineBySides = false, logEngineCompressMode = false;
 
         bool logScreenEngineInOutMode = false;
     };
@@ -25,6 +25,7 @@
 
 #include <regex>
 #include <map>
+#include <cstring>
 
 #include "uciengine.h"
 
@@ -53,17 +54,13 @@ std::string UciEngine::protocolString() const
 
 bool UciEngine::sendOptions()
 {
-    for(auto && option : config.optionList) {
-        if (!isWritable()) {
-            return false;
-        }
-
-        auto o = ConfigMng::instance->checkOverrideOption(option);
-        if (o.isDefaultValue()) {
-            continue;
-        }
-        
-        std::string str = "setoption name " + o.name + " value " + o.getValueAsString();
+    if (!isWritable()) {
+        return false;
+    }
+    
+    // all setoption lines in one write
+    auto& str = config.getUciOptionCommands();
+    if (!str.empty()) {
         write(str);
     }
     return true;
@@ -75,11 +72,36 @@ void UciEngine::newGame()
     ponderingMove = MoveFull::illegalMove;
     expectingBestmove = false;
     computingState = EngineComputingState::idle;
-    if (write("ucinewgame")) {
+    positionCache.clear();
+    anchorSet = false;
+    if (newGameSent) {
+        newGameSent = false;
+        setState(PlayerState::playing);
+    } else if (write("ucinewgame")) {
         setState(PlayerState::playing);
     }
 }
 
+// The engine clears its state now, while waiting for the next game, then must answer
+// isready to be handed over (health check)
+bool UciEngine::prepareForReuse()
+{
+    if (expectingBestmove || computingState != EngineComputingState::idle || !isWritable()) {
+        return false;
+    }
+    
+    // set before writing, readyok may come at once
+    ponderingMove = MoveFull::illegalMove;
+    newGameSent = true;
+    setState(PlayerState::starting);
+    
+    if (!write("ucinewgame") || !sendPing()) {
+        newGameSent = false;
+        return false;
+    }
+    return true;
+}
+
 void UciEngine::prepareToDeattach()
 {
     if (tick_deattach >= 0) return;
@@ -127,6 +149,7 @@ bool UciEngine::go()
         if (!board->histList.empty() && board->histList.back().move == ponderingMove) {
             computingState = EngineComputingState::thinking;
             write("ponderhit");
+            startEngineClock();
             return true;
         }
         return stop();
@@ -136,24 +159,75 @@ bool UciEngine::go()
     expectingBestmove = true;
     computingState = EngineComputingState::thinking;
     auto goString = getGoString(MoveFull::illegalMove);
-    return write(goString);
+    if (!write(goString)) {
+        return false;
+    }
+    startEngineClock();
+    return true;
 }
 
-std::string UciEngine::getPositionString(const Move& pondermove) const
+// Moves are appended to the command of the last go. For long games of engines set with fenPositionPly,
+// the position after the last capture or pawn move is sent instead, along with the moves after it,
+// which are all the engine needs to find repetitions
+std::string UciEngine::getPositionString(const Move& pondermove)
 {
     assert(board);
     
-    std::string str = "position " + (board->fromOriginPosition() ? "startpos" : ("fen " + board->getStartingFen()));
+    auto n = board->histList.size();
+    auto anchor = size_t(0);
+    if (config.fenPositionPly > 0 && n >= size_t(config.fenPositionPly)) {
+        for(anchor = n; anchor > 0; anchor--) {
+            auto& hist = board->histList[anchor - 1];
+            if (!hist.cap.isEmpty() || hist.move.piece().type == PieceType::pawn) {
+                break;
+            }
+        }
+    }
+    
+    std::string str;
+    auto moveCnt = n;
     
-    if (!board->histList.empty()) {
-        str += " moves";
-        for(auto && hist : board->histList) {
-            str += " " + hist.move.toCoordinateString();
+    if (anchor > 0) {
+        if (!anchorSet || anchorPly > anchor) {
+            auto fen = board->getStartingFen();
+            anchorBoard.newGame(fen);
+            anchorPly = 0;
+            anchorSet = true;
+            
+            // plies played before the starting position, from its fullmove counter and side
+            auto vec = splitString(fen, ' ');
+            auto fullMoveCnt = vec.size() > 5 ? std::max(1, std::atoi(vec[5].c_str())) : 1;
+            anchorStartPly = size_t(fullMoveCnt - 1) * 2 + (anchorBoard.side == Side::black ? 1 : 0);
+        }
+        for(; anchorPly < anchor; anchorPly++) {
+            anchorBoard.make(board->histList[anchorPly].move);
+        }
+        
+        str = "position fen " + anchorBoard.getFen(0, int((anchorStartPly + anchor) / 2) + 1);
+        if (anchor < n) {
+            str += " moves";
+            for(auto i = anchor; i < n; i++) {
+                str += " " + board->histList[i].move.toCoordinateString();
+            }
+        }
+        moveCnt = n - anchor;
+    } else {
+        if (positionCache.empty() || positionCachePly > n) {
+            positionCache = "position " + (board->fromOriginPosition() ? "startpos" : ("fen " + board->getStartingFen()));
+            positionCachePly = 0;
         }
+        if (positionCachePly == 0 && n > 0) {
+            positionCache += " moves";
+        }
+        for(; positionCachePly < n; positionCachePly++) {
+            positionCache += " ";
+            positionCache += board->histList[positionCachePly].move.toCoordinateString();
+        }
+        str = positionCache;
     }
     
     if (pondermove.isValid()) {
-        if (board->histList.empty()) {
+        if (moveCnt == 0) {
             str += " moves";
         }
         str += " " + pondermove.toCoordinateString();
@@ -184,6 +258,9 @@ std::string UciEngine::timeControlString() const
         case TimeControlMode::movetime:
             return "movetime " + std::to_string(timeController->time);
             
+        case TimeControlMode::nodes:
+            return "nodes " + std::to_string(nodeLimit());
+            
         case TimeControlMode::standard:
         {
             // timeController unit: second, here it needs ms
@@ -254,10 +331,10 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
             assert(computingState != EngineComputingState::idle);
             
             expectingBestmove = false;
-            auto oldComputingState = computingState;
+            auto oldComputingState = computingState.load();
             computingState = EngineComputingState::idle;
             
-            auto period = timeCtrl->moveTimeConsumed(); // moveTimeConsumed();
+            auto period = timeCtrl->moveTimeConsumed(lastReadClock);
             
             auto vec = splitString(line, ' ');
             if (vec.size() < 2) {
@@ -279,8 +356,16 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
             break;
         }
 
+        case UciEngineCmd::readyok:
+            if (newGameSent && getState() == PlayerState::starting) {
+                setState(PlayerState::ready);
+            }
+            break;
+            
         case UciEngineCmd::uciok:
         {
+            // again for threads the engine may have started meanwhile
+            applyCpuSet();
             setState(PlayerState::ready);
             expectingBestmove = false;
             sendOptions();
@@ -425,52 +510,138 @@ bool UciEngine::parseOption(const std::string& s)
     return false;
 }
 
-bool UciEngine::parseInfo(const std::string& line)
+static bool nextToken(const char*& p, const char*& token, size_t& len)
 {
-    assert(!line.empty());
-
-    std::string str;
-    auto p = line.find(" pv ");
-    if (p != std::string::npos) {
-        str = line.substr(5, p);
-    } else {
-        str = line.substr(5);
+    while (*p == ' ') p++;
+    if (*p == 0) {
+        return false;
     }
+    token = p;
+    while (*p && *p != ' ') p++;
+    len = size_t(p - token);
+    return true;
+}
 
-    auto vec = splitString(str, ' ');
+static bool isToken(const char* token, size_t len, const char* name)
+{
+    return strncmp(token, name, len) == 0 && name[len] == 0;
+}
 
-    for(int i = 0; i < vec.size() - 1; i++) {
-        auto name = vec.at(i);
-        if (name == "depth") {
-            ++i;
-            auto s = vec.at(i);
-            depth = std::atoi(s.c_str());
-            continue;
+static i64 tokenToI64(const char* token)
+{
+    return std::strtoll(token, nullptr, 10);
+}
+
+static bool parseCoordinateMove(const char* token, size_t len, u16& move)
+{
+    if (len < 4) {
+        return false;
+    }
+    auto from = coordinateStringToPos(token), dest = coordinateStringToPos(token + 2);
+    if (from < 0 || dest < 0) {
+        return false;
+    }
+    auto promotion = len > 4 ? BoardCore::charactorToPieceType(static_cast<char>(tolower(token[4]))) : PieceType::empty;
+    if (!BoardCore::isValidPromotion(promotion)) {
+        promotion = PieceType::empty;
+    }
+    move = InfoRecord::packMove(from, dest, promotion);
+    return true;
+}
+
+// single pass over the line, fields not in the line keep their values
+bool UciEngine::parseInfo(const std::string& line)
+{
+    assert(!line.empty());
+    
+    InfoRecord r;
+    r.multipv = 1;
+    auto haveScore = false, havePv = false, haveDepth = false;
+    
+    const char* p = line.c_str();
+    const char* token;
+    size_t len;
+    nextToken(p, token, len); // info
+    
+    while (nextToken(p, token, len)) {
+        if (isToken(token, len, "pv")) {
+            havePv = true;
+            u16 move;
+            while (r.pvLength < InfoRecord::maxPvLength && nextToken(p, token, len) && parseCoordinateMove(token, len, move)) {
+                r.pv[r.pvLength++] = move;
+            }
+            break;
         }
         
-        if (name == "nodes") {
-            ++i;
-            auto s = vec.at(i);
-            nodes = std::atoi(s.c_str());
-            continue;
+        // the rest of the line is free text or moves
+        if (isToken(token, len, "string") || isToken(token, len, "refutation") || isToken(token, len, "currline")) {
+            break;
         }
         
-        if (name == "score") {
-            ++i;
-            auto s = vec.at(i);
+        if (isToken(token, len, "score")) {
+            if (!nextToken(p, token, len)) break;
+            auto cp = isToken(token, len, "cp");
+            if (!cp && !isToken(token, len, "mate")) continue;
+            if (!nextToken(p, token, len)) break;
             
-            auto iscpscore = false;
-            if (s == "cp") {
-                iscpscore = true;
-                ++i;
-                s = vec.at(i);
+            auto v = static_cast<int>(tokenToI64(token));
+            haveScore = true;
+            if (cp) {
+                r.score = v; r.mate = 0;
+            } else {
+                r.mate = v;
+                r.score = v >= 0 ? InfoRecord::mateScore - v : -InfoRecord::mateScore - v;
             }
-            score = std::atoi(s.c_str());
-            if (!iscpscore) score *= 100;
             continue;
         }
-
+        
+        // lowerbound, upperbound
+        if (isToken(token, len, "lowerbound") || isToken(token, len, "upperbound")) {
+            continue;
+        }
+        
+        // all others have one value
+        auto name = token;
+        auto nameLen = len;
+        if (!nextToken(p, token, len)) break;
+        
+        if (isToken(name, nameLen, "depth")) {
+            r.depth = static_cast<int>(tokenToI64(token));
+            haveDepth = true;
+        } else if (isToken(name, nameLen, "seldepth")) {
+            r.seldepth = static_cast<int>(tokenToI64(token));
+        } else if (isToken(name, nameLen, "multipv")) {
+            r.multipv = static_cast<int>(tokenToI64(token));
+        } else if (isToken(name, nameLen, "nodes")) {
+            info.nodes = tokenToI64(token);
+        } else if (isToken(name, nameLen, "nps")) {
+            info.nps = tokenToI64(token);
+        } else if (isToken(name, nameLen, "tbhits")) {
+            info.tbhits = tokenToI64(token);
+        } else if (isToken(name, nameLen, "hashfull")) {
+            info.hashfull = static_cast<int>(tokenToI64(token));
+        } else if (isToken(name, nameLen, "time")) {
+            info.time = static_cast<int>(tokenToI64(token));
+        }
     }
-
-    return false;
+    
+    // secondary lines of MultiPV are not the engine's choice
+    if (r.multipv != 1) {
+        return true;
+    }
+    
+    if (haveDepth) {
+        info.depth = r.depth;
+        info.seldepth = r.seldepth;
+    }
+    if (haveScore) {
+        info.score = r.score;
+        info.mate = r.mate;
+    }
+    if (havePv) {
+        info.multipv = r.multipv;
+        info.pvLength = r.pvLength;
+        memcpy(info.pv, r.pv, sizeof(u16) * size_t(r.pvLength));
+    }
+    return true;
 }
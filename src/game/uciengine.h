@@ -60,12 +60,13 @@ namespace banksia {
         virtual bool stop() override;
         
         virtual void prepareToDeattach() override;
+        virtual bool prepareForReuse() override;
         
     protected:
         virtual const std::unordered_map<std::string, int>& getEngineCmdMap() const override;
         virtual void parseLine(int, const std::string&, const std::string&) override;
         
-        std::string getPositionString(const Move& ponderMove) const;
+        std::string getPositionString(const Move& ponderMove);
         std::string getGoString(const Move& pondermove);
         
         virtual bool sendOptions();
@@ -76,7 +77,17 @@ namespace banksia {
         bool parseInfo(const std::string& line);
         
         bool expectingBestmove = false;
+        bool newGameSent = false; // by prepareForReuse, ahead of the next game
         Move ponderingMove;
+        
+        // the "position" command of the last go, the new moves are appended to it
+        std::string positionCache;
+        size_t positionCachePly = 0;
+        
+        // for config.fenPositionPly, follows the game up to its last irreversible move
+        ChessBoard anchorBoard;
+        size_t anchorPly = 0, anchorStartPly = 0;
+        bool anchorSet = false;
         static const std::unordered_map<std::string, int> uciEngineCmd;
     };
     
@@ -65,53 +65,64 @@ bool WbEngine::sendOptions()
     return true;
 }
 
-bool WbEngine::candoSyncTaskNow(SyncTask task)
+bool WbEngine::syncTask(SyncTask task)
 {
-    if (feature_ping && expectingPongCnt) {
-        std::lock_guard<std::mutex> dolock(syncMutex);
-        if (expectingPongCnt) {
-            syncTasks.push_back(task);
-            return false;
-        }
-    }
-    return true;
-}
-
-bool WbEngine::doSyncTask()
-{
-    assert(feature_ping);
-    if (expectingPongCnt || syncTasks.empty()) {
-        return false;
-    }
-    
     std::lock_guard<std::mutex> dolock(syncMutex);
-    
-    if (expectingPongCnt || syncTasks.empty()) {
+    if (waitingPingNo || !syncTasks.empty()) {
+        syncTasks.push_back(task);
         return false;
     }
+    return runSyncTask(task);
+}
 
-
-    auto task = syncTasks.front();
-    syncTasks.erase(syncTasks.begin());
+bool WbEngine::runSyncTask(SyncTask task)
+{
     switch (task) {
         case SyncTask::newgame:
             newGame_straight();
-            break;
+            return true;
         case SyncTask::go:
-            go_straight();
-            break;
+            return go_straight();
         default:
             break;
     }
-    return true;
+    return false;
 }
 
-void WbEngine::newGame()
+// runs on the reader thread, queued tasks are sent straight away instead of waiting for a tick
+void WbEngine::pongReceived(const std::string& line)
 {
-    if (!candoSyncTaskNow(SyncTask::newgame)) {
+    pongCnt++;
+    
+    auto vec = splitString(line, ' ');
+    auto no = vec.size() >= 2 ? std::atoi(vec.at(1).c_str()) : 0;
+
+    std::lock_guard<std::mutex> dolock(syncMutex);
+    
+    // a late pong of an older ping, the engine hasn't read the last commands yet
+    if (no > 0 && no < waitingPingNo) {
         return;
     }
-    newGame_straight();
+    waitingPingNo = 0;
+    
+    if (newGameSyncing) {
+        newGameSyncing = false;
+        if (getState() == PlayerState::ready) {
+            setState(PlayerState::playing);
+        }
+    }
+    
+    // a newgame task sends a ping, the rest waits for its pong
+    while (!waitingPingNo && !syncTasks.empty()) {
+        auto task = syncTasks.front();
+        syncTasks.pop_front();
+        runSyncTask(task);
+    }
+}
+
+void WbEngine::newGame()
+{
+    syncTask(SyncTask::newgame);
 }
 
 void WbEngine::newGame_straight()
@@ -136,8 +147,8 @@ void WbEngine::newGame_straight()
         // TODO: check logic again. No ping here
         // force to avoid some engines such as Crafty auto computing
         write("force");
-        for (auto && hist : board->histList) {
-            std::string str = move2String(hist.move, hist.moveString);
+        for (size_t i = 0; i < board->histList.size(); i++) {
+            std::string str = move2String(board->histList[i].move, board->findNote(i).san);
             write(str);
         }
     }
@@ -145,10 +156,8 @@ void WbEngine::newGame_straight()
     write(timeControlString());
     
     if (feature_ping) {
-        // fake ping to avoid other cmd be run
-        expectingPongCnt++;
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        // the engine is playing when it answers, go waits for that
+        newGameSyncing = true;
         sendPing();
     } else {
         setState(PlayerState::playing);
@@ -176,11 +185,7 @@ bool WbEngine::goPonder(const Move& pondermove)
 
 bool WbEngine::go()
 {
-    if (!candoSyncTaskNow(SyncTask::go)) {
-        return false;
-    }
-    
-    return go_straight();
+    return syncTask(SyncTask::go);
 }
 
 bool WbEngine::go_straight()
@@ -188,7 +193,12 @@ bool WbEngine::go_straight()
     Engine::go();
     computingState = EngineComputingState::thinking;
     
-    return write(timeLeftString()) && write("go");
+    auto timeLeft = timeLeftString();
+    if ((!timeLeft.empty() && !write(timeLeft)) || !write("go")) {
+        return false;
+    }
+    startEngineClock();
+    return true;
 }
 
 std::string WbEngine::timeLeftString() const
@@ -227,6 +237,10 @@ std::string WbEngine::timeControlString() const
         case TimeControlMode::movetime:
             return "st " + std::to_string(timeController->time);
             
+        case TimeControlMode::nodes:
+            // nps makes the engine count nodes as its clock, thus 1 second of it is the limit
+            return "nps " + std::to_string(nodeLimit()) + "\nst 1";
+            
         case TimeControlMode::standard:
         {
             // timeController unit: second
@@ -262,8 +276,9 @@ std::string WbEngine::timeControlString() const
 bool WbEngine::sendPing()
 {
     assert(feature_ping);
-    expectingPongCnt++;
-    return write("ping " + std::to_string(++pingCnt));
+    auto no = ++pingCnt;
+    waitingPingNo = no;
+    return write("ping " + std::to_string(no));
 }
 
 bool WbEngine::sendPong(const std::string& str)
@@ -302,8 +317,6 @@ void WbEngine::tickPing()
     if (tick_ping >= tick_period_ping) {
         resetPing();
         sendPing();
-    } else {
-        doSyncTask();
     }
 }
 
@@ -328,11 +341,9 @@ bool WbEngine::sendMemoryAndCoreOptions()
     if (isFeatureOn("memory")) {
         Option option = ConfigMng::instance->getOverrideOption("memory");
         if (!option.isValid()) {
-            for(auto && o : config.optionList) {
-                if (o.name == "memory") {
-                    option = o;
-                    break;
-                }
+            auto o = config.getOption("memory");
+            if (o) {
+                option = *o;
             }
         }
         if (option.isValid()) {
@@ -342,11 +353,9 @@ bool WbEngine::sendMemoryAndCoreOptions()
     if (isFeatureOn("smp")) {
         Option option = ConfigMng::instance->getOverrideOption("cores");
         if (!option.isValid()) {
-            for(auto && o : config.optionList) {
-                if (o.name == "cores") {
-                    option = o;
-                    break;
-                }
+            auto o = config.getOption("cores");
+            if (o) {
+                option = *o;
             }
         }
         if (option.isValid()) {
@@ -369,18 +378,10 @@ bool WbEngine::parseFeature(const std::string& name, const std::string& content,
         if (vec.size() < 2) return true;
         auto optionName = vec.front();
         
-        for(auto && o : config.optionList) {
-            if (o.name != optionName) {
-                continue;
-            }
-            
-            if (!isWritable() || o.isDefaultValue() || o.name == "memory" || o.name == "cores") {
-                break;
-            }
-            
-            std::string str = "option " + o.name + "=" + o.getValueAsString();
+        auto o = config.getOption(optionName);
+        if (o && isWritable() && !o->isDefaultValue() && o->name != "memory" && o->name != "cores") {
+            std::string str = "option " + o->name + "=" + o->getValueAsString();
             write(str);
-            break;
         }
         
         return true;
@@ -434,7 +435,9 @@ void WbEngine::parseFeatures(const std::string& line)
 {
     // "feature " length = 8
     std::string featureName;
-    for(size_t i = 8, k = -1, quote = 0; i < line.size(); i++) {
+    // signed, k < 0 means no name nor content has started
+    int sz = int(line.size());
+    for(int i = 8, k = -1, quote = 0; i < sz; i++) {
         auto ch = line[i];
         if (ch == '=') {
             if (k < 0 || i <= k) break; // somethings wrong
@@ -457,10 +460,10 @@ void WbEngine::parseFeatures(const std::string& line)
                 continue;
             }
         }
-        if ((ch == ' ' || i + 1 == line.size()) && quote == 0) {
+        if ((ch == ' ' || i + 1 == sz) && quote == 0) {
             if (!featureName.empty() && k > 0) {
                 auto len = i - k;
-                if (i + 1 == line.size()) len++;
+                if (i + 1 == sz) len++;
                 auto content = line.substr(k, len);
                 parseFeature(featureName, content, false);
             }
@@ -488,11 +491,11 @@ std::string WbEngine::move2String(const Move& move, const std::string& sanMoveSt
     return str;
 }
 
-bool WbEngine::oppositeMadeMove(const Move& move, const std::string& sanMoveString)
+bool WbEngine::oppositeMadeMove(const Move& move)
 {
     write("force"); // we don't want this engine starts calculating after this move
     
-    std::string str = move2String(move, sanMoveString);
+    std::string str = move2String(move, feature_san ? board->getSan(board->histList.size() - 1) : "");
     return write(str);
 }
 
@@ -515,9 +518,9 @@ bool WbEngine::engineMove(const std::string& moveString, bool mustSend)
     }
     
     if (mustSend || move.isValid()) {
-        auto period = timeCtrl->moveTimeConsumed(); // moveTimeConsumed();
+        auto period = timeCtrl->moveTimeConsumed(lastReadClock);
         
-        auto oldComputingState = computingState;
+        auto oldComputingState = computingState.load();
         computingState = EngineComputingState::idle;
         
         (moveRecv)(move, moveString, Move::illegalMove, period, oldComputingState);
@@ -544,11 +547,12 @@ void WbEngine::parseLine(int cmdInt, const std::string& cmdString, const std::st
             // ply score time nodes pv
             auto vec = splitString(line, ' ');
             if (vec.size() >= 4) {
-                depth = std::atoi(vec[0].c_str());
-                score = std::atoi(vec[1].c_str());
-                nodes = std::atoi(vec[3].c_str());
+                info.depth = std::atoi(vec[0].c_str());
+                info.score = std::atoi(vec[1].c_str());
+                info.time = std::atoi(vec[2].c_str()) * 10; // centiseconds
+                info.nodes = std::atoll(vec[3].c_str());
                 
-                if (depth > 0 && nodes > 0) {
+                if (info.depth > 0 && info.nodes > 0) {
                     engineSentCorrectCmds();
                 }
             }
@@ -587,13 +591,7 @@ void WbEngine::parseLine(int cmdInt, const std::string& cmdString, const std::st
 
         case WbEngineCmd::pong:
         {
-            expectingPongCnt = 0;
-            pongCnt++;
-
-            if (getState() == PlayerState::ready) {
-                setState(PlayerState::playing);
-            }
-            doSyncTask();
+            pongReceived(line);
             break;
         }
             
@@ -27,6 +27,7 @@
 #define wbengine_h
 
 #include <stdio.h>
+#include <deque>
 
 #include "engine.h"
 #include "engineprofile.h"
@@ -64,7 +65,7 @@ namespace banksia {
         virtual bool stop() override;
         virtual void tickWork() override;
         
-        virtual bool oppositeMadeMove(const Move& move, const std::string& sanMoveString) override;
+        virtual bool oppositeMadeMove(const Move& move) override;
         
     private:
         bool go_straight();
@@ -92,7 +93,7 @@ namespace banksia {
         
         std::map<std::string, std::string> featureMap;
         
-        int pingCnt = 0, expectingPongCnt = 0, pongCnt = 0;
+        std::atomic<int> pingCnt {0}, pongCnt {0};
         static const std::unordered_map<std::string, int> wbEngineCmd;
         int tick_delay_2_ready = -1;
         
@@ -104,11 +105,18 @@ namespace banksia {
         };
         
     private:
-        bool candoSyncTaskNow(SyncTask task);
-        bool doSyncTask();
+        // newgame and go wait for the pong of the last ping, they are run by the
+        // reader thread as soon as that pong arrives
+        bool syncTask(SyncTask task);
+        bool runSyncTask(SyncTask task);
+        void pongReceived(const std::string& line);
         
         std::mutex syncMutex;
-        std::vector<SyncTask> syncTasks;
+        std::deque<SyncTask> syncTasks;
+        
+        // number of the ping whose pong releases the queued tasks, 0: none
+        std::atomic<int> waitingPingNo {0};
+        bool newGameSyncing = false;
     };
     
 } // namespace banksia
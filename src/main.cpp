@@ -23,9 +23,17 @@
  */
 
 #include <csignal>
+#include <cctype>
+#include <thread>
+#include <chrono>
+#include <memory>
 
 #include "game/jsonmaker.h"
 #include "game/tourmng.h"
+#include "game/tourbatch.h"
+#include "game/bench.h"
+#include "game/gamearchive.h"
+#include "base/metrics.h"
 
 #include "3rdparty/fathom/tbprobe.h"
 
@@ -45,6 +53,11 @@ int main(int argc, const char * argv[])
 #define SIGPIPE     13
     signal(SIGPIPE, SIG_IGN);
     
+    // a mock UCI engine for the load test, it must not print the banner
+    if (argc >= 2 && std::string(argv[1]) == "-mockengine") {
+        return banksia::Bench::mockEngine(argc > 2 ? std::atoi(argv[2]) : 8) ? 0 : -1;
+    }
+    
     std::cout << "Banksia, Chess Tournament Manager, by Nguyen Pham - version " << banksia::getVersion() << std::endl;
     
     if (argc < 2) {
@@ -54,6 +67,9 @@ int main(int argc, const char * argv[])
     
     std::map <std::string, std::string> argmap;
     
+    // a batch is given by several -t or by -batch
+    std::vector<std::string> tourPathList;
+    
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg.empty() || arg.at(0) != '-' || arg == "-h" || arg == "--help") {
@@ -63,7 +79,7 @@ int main(int argc, const char * argv[])
         std::string str = arg;
         auto ok = true;
         
-        if (arg == "-t" || arg == "-jsonpath" || arg == "-d" || arg == "-c" || arg == "-v") {
+        if (arg == "-t" || arg == "-jsonpath" || arg == "-d" || arg == "-c" || arg == "-v" || arg == "-bench" || arg == "-benchfile" || arg == "-convert" || arg == "-o" || arg == "-worker" || arg == "-batch" || arg == "-games" || arg == "-infolines") {
             if (i + 1 < argc) {
                 i++;
                 str = argv[i];
@@ -76,6 +92,26 @@ int main(int argc, const char * argv[])
             std::cerr << arg << " requires one argument." << std::endl;
             return -1;
         }
+        
+        // the sampling interval of profile is optional
+        if (arg == "-profile" && i + 1 < argc && std::isdigit(argv[i + 1][0])) {
+            i++;
+            str = argv[i];
+        }
+        
+        // perft takes a fen and a depth
+        if (arg == "-perft") {
+            if (i + 2 >= argc) {
+                std::cerr << arg << " requires two arguments." << std::endl;
+                return -1;
+            }
+            argmap["-perftdepth"] = argv[i + 2];
+            str = argv[i + 1];
+            i += 2;
+        }
+        if (arg == "-t") {
+            tourPathList.push_back(str);
+        }
         argmap[arg] = str;
     }
     
@@ -90,18 +126,66 @@ int main(int argc, const char * argv[])
         banksia::banksiaVerbose = argmap["-v"] == "on";
     }
     if (argmap.find("-profile") != argmap.end()) {
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
         banksia::profileMode = true;
-        std::cout << "Warning: profile mode is on." << std::endl;
+        auto interval = std::atoi(argmap["-profile"].c_str());
+        if (interval > 0) {
+            banksia::profileInterval = interval;
+        }
+        std::cout << "Warning: profile mode is on, sampling every " << banksia::profileInterval << " ms." << std::endl;
 #else
-        std::cout << "Sorry: profile has just been implemented for Windows only." << std::endl;
+        std::cout << "Sorry: profile has just been implemented for Windows, Linux and macOS only." << std::endl;
 #endif
     }
     
+    if (argmap.find("-perft") != argmap.end()) {
+        auto depth = std::atoi(argmap["-perftdepth"].c_str());
+        auto divide = argmap.find("-divide") != argmap.end();
+        return banksia::Bench::perft(argmap["-perft"], depth, divide) ? 0 : -1;
+    }
+    
+    if (argmap.find("-convert") != argmap.end()) {
+        auto path = argmap.find("-o") != argmap.end() ? argmap["-o"] : "";
+        return banksia::GameArchive::convert(argmap["-convert"], path) ? 0 : -1;
+    }
+    
+    if (argmap.find("-bench") != argmap.end() && argmap["-bench"] == "load") {
+        auto games = argmap.find("-games") != argmap.end() ? std::atoi(argmap["-games"].c_str()) : 2000;
+        auto concurrency = argmap.find("-c") != argmap.end() ? std::atoi(argmap["-c"].c_str()) : 32;
+        auto infoLines = argmap.find("-infolines") != argmap.end() ? std::atoi(argmap["-infolines"].c_str()) : 8;
+        return banksia::Bench::loadTest(argv[0], games, concurrency, infoLines) ? 0 : -1;
+    }
+    
+    if (argmap.find("-bench") != argmap.end()) {
+        auto path = argmap.find("-benchfile") != argmap.end() ? argmap["-benchfile"] : "";
+        return banksia::Bench::run(argmap["-bench"], path) ? 0 : -1;
+    }
+    
     banksia::JsonMaker maker;
-    banksia::TourMng tourMng;
+    // for a single tournament only, a batch creates its own ones
+    std::unique_ptr<banksia::TourMng> tourMng;
+    banksia::TourBatch tourBatch;
+    
+    if (argmap.find("-batch") != argmap.end()) {
+        auto list = banksia::TourBatch::findTourFiles(argmap["-batch"]);
+        tourPathList.insert(tourPathList.end(), list.begin(), list.end());
+        if (list.empty()) {
+            std::cerr << "Error: there is no tour file in " << argmap["-batch"] << std::endl;
+            return -1;
+        }
+    }
+    auto batchMode = tourPathList.size() > 1 || argmap.find("-batch") != argmap.end();
     
-    if (argmap.find("-u") != argmap.end()) {
+    if (batchMode) {
+        auto noReply = argmap.find("-no") != argmap.end();
+        auto yesReply = argmap.find("-yes") != argmap.end();
+        auto concurrency = argmap.find("-c") != argmap.end() ? std::atoi(argmap["-c"].c_str()) : 0;
+        
+        // The app will be auto terminated when all tournaments completed
+        if (!tourBatch.start(tourPathList, concurrency, yesReply, noReply)) {
+            return -1;
+        }
+    } else if (argmap.find("-u") != argmap.end()) {
         std::string mainEnginesPath;
         if (argmap.find("-d") != argmap.end()) {
             mainEnginesPath = argmap["-d"];
@@ -124,15 +208,24 @@ int main(int argc, const char * argv[])
         auto noReply = argmap.find("-no") != argmap.end();
         auto yesReply = argmap.find("-yes") != argmap.end();
         
+        tourMng.reset(new banksia::TourMng);
+        if (argmap.find("-worker") != argmap.end()) {
+            tourMng->setWorkerAddress(argmap["-worker"]);
+        }
+        
         // The app will be auto terminated when all matches completed
-        if (!tourMng.start(mainJsonPath, yesReply, noReply)) {
+        if (!tourMng->start(mainJsonPath, yesReply, noReply)) {
             return -1;
         }
     }
     
     while (true) {
         std::string line;
-        std::getline(std::cin, line);
+        // no console (closed or redirected input), the tournament runs by itself until it exits
+        if (!std::getline(std::cin, line)) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
         banksia::trim(line);
         
         if (line.empty()) {
@@ -152,7 +245,12 @@ int main(int argc, const char * argv[])
         }
         
         if (cmd == "status") {
-            std::cout << tourMng.createTournamentStats() << std::endl;
+            if (batchMode) {
+                std::cout << tourBatch.createTournamentStats() << std::endl;
+            } else if (tourMng) {
+                std::cout << tourMng->createTournamentStats() << std::endl;
+            }
+            std::cout << banksia::Metrics::toString() << std::endl;
             continue;
         }
         if (cmd == "v") {
@@ -170,7 +268,11 @@ int main(int argc, const char * argv[])
         show_help();
     }
     
-    tourMng.shutdown();
+    if (batchMode) {
+        tourBatch.shutdown();
+    } else if (tourMng) {
+        tourMng->shutdown();
+    }
     maker.shutdown();
     
     return 0;
@@ -188,6 +290,10 @@ void show_usage(std::string name)
     << "               banksia -yes -t c:\\t5.json, to resume the tournament that was stopped before,\n"
     << "               without waiting for typing y/n.\n"
     << "  -no          A flag to auto answer no when being ask (to resume a tournament).\n"
+    << "  -batch PATH  run all tour files of the folder PATH (several -t do the same) in one process. They\n"
+    << "               share engines and game slots, the higher \"priority\" (base of tour.json) gets free\n"
+    << "               slots first. -c gives the total concurrency, by default the largest one of the tours.\n"
+    << "               Example: banksia -batch c:\\tours -c 8\n"
     << "  -u           A flag to create/update engines and tournament json files. Example:\n"
     << "               banksia -u -d c:\\myengines, to create/update engines.json file and tour.json file, where\n"
     << "               engines are located in c:\\myengines. engines.json and tour.json files will be located on\n"
@@ -201,9 +307,27 @@ void show_usage(std::string name)
     << "               banksia -u -d c:\\myengines, will create engines.json and tour.json files at the folder where\n"
     << "               banksia.exe is located. banksia will search the engines located in c:\\myengines in this case.\n"
     << "  -v on|off    turn on/off verbose (default on)\n"
+    << "  -bench NAME  run a benchmark. NAME: uci (parsing engine output), perft (move generator on a set\n"
+    << "               of positions with known node counts), load (games between built-in mock engines\n"
+    << "               to measure the manager itself: games/s, moves/s, manager cpu per move, peak memory),\n"
+    << "               mailbox (moves arriving at the deadline must not lose on time)\n"
+    << "  -games N     games of -bench load (default 2000), played with concurrency -c (default 32)\n"
+    << "  -infolines N info lines sent by the mock engines before each bestmove (default 8)\n"
+    << "  -mockengine [N]  run as the mock UCI engine of -bench load, N info lines per move\n"
+    << "  -benchfile PATH  a recorded engine output for -bench uci, instead of a generated one\n"
+    << "  -perft FEN DEPTH  count nodes of the position FEN up to DEPTH. Example:\n"
+    << "               banksia -perft \"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\" 5\n"
+    << "  -divide      a flag to print node counts of each root move for -perft\n"
+    << "  -convert PATH  convert the game archive PATH (logs/archive of tour.json) to PGN, written to\n"
+    << "               the file given by -o or to PATH with the extension .pgn. Example:\n"
+    << "               banksia -convert games.bka -o games.pgn\n"
+    << "  -o PATH      the output file for -convert\n"
+    << "  -worker HOST:PORT  play matches given by the coordinator at HOST:PORT (see distributed of\n"
+    << "               tour.json), using engines and concurrency of the tour file given by -t. Example:\n"
+    << "               banksia -t c:\\worker\\tour.json -worker 192.168.1.10:7400\n"
     
-#ifdef _WIN32
-    << "  -profile     profile engines (cpu, mem, threads)\n"
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
+    << "  -profile [MS] profile engines (cpu, mem, threads), sampling every MS milliseconds (default 500)\n"
 #endif
     << "\n\n"
     << "FAQ:\n"
@@ -227,7 +351,7 @@ void show_help()
     std::cout
     << "Usage:\n"
     << "  help                    show this help message\n"
-    << "  status                  current result\n"
+    << "  status                  current result and the manager's metrics\n"
     << "  v [on|off]              verbose on/off. Show/Don't show individual match (default on)\n"
     << "  quit                    quit\n"
     << std::endl;